@@ -0,0 +1,55 @@
+#include "streaminganalyzer.h"
+#include <QtAlgorithms>
+#include <algorithm>
+
+void StreamingAnalyzer::reset(const QVector<DataPacket>* reference, int expected)
+{
+    m_reference = reference;
+    m_stats = StreamStats();
+    m_stats.expected = expected;
+    m_failure.clear();
+}
+
+void StreamingAnalyzer::add(const DataPacket& packet)
+{
+    const int counter = packet.counter;
+    ++m_stats.received;
+
+    if (counter > m_stats.highestCounter) {
+        const int gap = counter - m_stats.highestCounter - 1;
+        m_stats.missing += gap;
+        m_stats.maxMissingRun = std::max(m_stats.maxMissingRun, gap);
+        m_stats.highestCounter = counter;
+    } else {
+        // Заполнил пропуск ниже старшего счетчика
+        ++m_stats.outOfOrder;
+        m_stats.missing = std::max(0, m_stats.missing - 1);
+    }
+
+    if (m_reference && counter < m_reference->size()) {
+        const DataPacket& expected = m_reference->at(counter);
+        m_stats.bitErrors += qPopulationCount(quint8(packet.data[0] ^ expected.data[0])) +
+                             qPopulationCount(quint8(packet.data[1] ^ expected.data[1]));
+        m_stats.bitsCompared += 16;
+    }
+
+    if (m_failure.isEmpty()) {
+        checkLimits();
+    }
+}
+
+void StreamingAnalyzer::checkLimits()
+{
+    if (m_limits.maxMissingRun > 0 && m_stats.maxMissingRun > m_limits.maxMissingRun) {
+        m_failure = QString("пропущено подряд %1 пакетов (порог %2)")
+                        .arg(m_stats.maxMissingRun).arg(m_limits.maxMissingRun);
+        return;
+    }
+    if (m_limits.maxBer > 0.0 && m_stats.bitsCompared >= m_limits.minBits &&
+        m_stats.ber() > m_limits.maxBer) {
+        m_failure = QString("BER %1 выше порога %2 после %3 пакетов")
+                        .arg(m_stats.ber(), 0, 'g', 4)
+                        .arg(m_limits.maxBer, 0, 'g', 4)
+                        .arg(m_stats.received);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef STREAMINGANALYZER_H
+#define STREAMINGANALYZER_H
+
+#include <cstdint>
+#include <QMetaType>
+#include <QString>
+#include <QVector>
+#include "../core/communication/ppbprotocol.h"
+
+// Статистика ответа на текущий момент приема
+struct StreamStats {
+    int expected = 0;
+    int received = 0;
+    int highestCounter = -1;     // старший принятый счетчик
+    int missing = 0;             // счетчики ниже старшего, пока не принятые
+    int maxMissingRun = 0;       // наибольший пропуск подряд
+    int outOfOrder = 0;          // пришли после пакета с большим счетчиком
+    quint64 bitErrors = 0;       // расхождения с эталоном (если он есть)
+    quint64 bitsCompared = 0;
+
+    double ber() const { return bitsCompared ? double(bitErrors) / double(bitsCompared) : 0.0; }
+    bool complete() const { return received >= expected; }
+};
+Q_DECLARE_METATYPE(StreamStats)
+
+// ===== АНАЛИЗ НА ЛЕТУ =====
+// Обновляет статистику по каждому принятому пакету - O(1), без выделения памяти:
+// пропуски и порядок по счетчикам, битовые ошибки - сравнением с эталоном по счетчику.
+// Пакетный PacketAnalyzer по-прежнему строит подробный отчет по кнопке; здесь -
+// ход приема, частичный BER и признак, что дальше принимать бессмысленно.
+// Повторы счетчиков сюда не доходят - их отсекает буфер диалога.
+class StreamingAnalyzer
+{
+public:
+    // Пороги досрочного прекращения приема; 0 - порог не проверяется
+    struct Limits {
+        double maxBer = 0.0;
+        quint64 minBits = 1024;      // BER меньшей выборки не считается надежным
+        int maxMissingRun = 0;
+    };
+
+    // Новый ответ из expected пакетов; reference - эталон по счетчикам (nullptr - без сравнения),
+    // должен жить до конца приема
+    void reset(const QVector<DataPacket>* reference = nullptr, int expected = 0);
+    void setLimits(const Limits& limits) { m_limits = limits; }
+    const Limits& limits() const { return m_limits; }
+
+    void add(const DataPacket& packet);
+
+    const StreamStats& stats() const { return m_stats; }
+    bool hasReference() const { return m_reference != nullptr; }
+    bool failed() const { return !m_failure.isEmpty(); }
+    const QString& failureReason() const { return m_failure; }
+
+private:
+    void checkLimits();
+
+    const QVector<DataPacket>* m_reference = nullptr;
+    StreamStats m_stats;
+    Limits m_limits;
+    QString m_failure;
+};
+
+#endif // STREAMINGANALYZER_H
@@ -0,0 +1,172 @@
+#ifndef ADDRESSSLOTS_H
+#define ADDRESSSLOTS_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+
+// Таблица состояния по адресам ППБ. Адрес - битовая маска: 16 одиночных адресов
+// (один бит) лежат в фиксированных слотах по номеру бита - без хеширования и аллокаций.
+// Широковещательный и многобитовые адреса - в небольшой упорядоченной таблице переполнения.
+// Блокировок нет: таблица принадлежит потоку движка.
+template <typename T>
+class AddressSlots
+{
+public:
+    static constexpr int SLOT_COUNT = 16;
+
+    AddressSlots() = default;
+    AddressSlots(const AddressSlots&) = delete;
+    AddressSlots& operator=(const AddressSlots&) = delete;
+
+    // Номер слота для одиночного адреса, -1 - адрес не одиночный (0, несколько бит)
+    static int slotIndex(uint16_t address)
+    {
+        if (address == 0 || (address & (address - 1)) != 0) {
+            return -1;
+        }
+        int index = 0;
+        while (!(address & 1u)) {
+            address >>= 1;
+            ++index;
+        }
+        return index;
+    }
+
+    // Элемент адреса; создается значением по умолчанию, если его нет
+    T& operator[](uint16_t address)
+    {
+        const int index = slotIndex(address);
+        if (index < 0) {
+            return m_overflow[address];
+        }
+        if (!m_slots[index]) {
+            m_slots[index].emplace();
+        }
+        return *m_slots[index];
+    }
+
+    T* find(uint16_t address)
+    {
+        const int index = slotIndex(address);
+        if (index >= 0) {
+            return m_slots[index] ? &*m_slots[index] : nullptr;
+        }
+        auto it = m_overflow.find(address);
+        return it != m_overflow.end() ? &it->second : nullptr;
+    }
+
+    const T* find(uint16_t address) const
+    {
+        return const_cast<AddressSlots*>(this)->find(address);
+    }
+
+    bool contains(uint16_t address) const { return find(address) != nullptr; }
+
+    void erase(uint16_t address)
+    {
+        const int index = slotIndex(address);
+        if (index >= 0) {
+            m_slots[index].reset();
+        } else {
+            m_overflow.erase(address);
+        }
+    }
+
+    void clear()
+    {
+        for (auto& slot : m_slots) {
+            slot.reset();
+        }
+        m_overflow.clear();
+    }
+
+    // Обход существующих элементов: сначала слоты по возрастанию бита, затем переполнение
+    template <typename Function>
+    void forEach(Function function)
+    {
+        for (int index = 0; index < SLOT_COUNT; ++index) {
+            if (m_slots[index]) {
+                function(static_cast<uint16_t>(1u << index), *m_slots[index]);
+            }
+        }
+        for (auto& item : m_overflow) {
+            function(item.first, item.second);
+        }
+    }
+
+    template <typename Function>
+    void forEach(Function function) const
+    {
+        const_cast<AddressSlots*>(this)->forEach([&function](uint16_t address, T& value) {
+            function(address, static_cast<const T&>(value));
+        });
+    }
+
+private:
+    std::array<std::optional<T>, SLOT_COUNT> m_slots;
+    std::map<uint16_t, T> m_overflow;
+};
+
+// Множество адресов по тому же принципу: одиночные адреса - битами маски,
+// остальные - в таблице переполнения. Вставка одиночного адреса не выделяет память
+class AddressSet
+{
+public:
+    void insert(uint16_t address)
+    {
+        if (AddressSlots<bool>::slotIndex(address) >= 0) {
+            m_single |= address;
+        } else {
+            m_overflow.insert(address);
+        }
+    }
+
+    bool contains(uint16_t address) const
+    {
+        if (AddressSlots<bool>::slotIndex(address) >= 0) {
+            return (m_single & address) != 0;
+        }
+        return m_overflow.count(address) != 0;
+    }
+
+    bool isEmpty() const { return m_single == 0 && m_overflow.empty(); }
+
+    void clear()
+    {
+        m_single = 0;
+        m_overflow.clear();
+    }
+
+    // Содержимое целиком, множество остается пустым: обходчик может наполнять его заново
+    AddressSet take()
+    {
+        AddressSet taken;
+        taken.m_single = std::exchange(m_single, uint16_t(0));
+        taken.m_overflow.swap(m_overflow);
+        return taken;
+    }
+
+    // Обход: одиночные адреса по возрастанию бита, затем переполнение
+    template <typename Function>
+    void forEach(Function function) const
+    {
+        for (int index = 0; index < AddressSlots<bool>::SLOT_COUNT; ++index) {
+            if (m_single & (1u << index)) {
+                function(static_cast<uint16_t>(1u << index));
+            }
+        }
+        for (uint16_t address : m_overflow) {
+            function(address);
+        }
+    }
+
+private:
+    uint16_t m_single = 0;
+    std::set<uint16_t> m_overflow;
+};
+
+#endif // ADDRESSSLOTS_H
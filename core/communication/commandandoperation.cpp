@@ -3,77 +3,103 @@
 #include "../logging/logging_unified.h"
 #include <QDataStream>
 #include <QtEndian>
+#include <array>
 
-// Вспомогательная функция для преобразования QByteArray в uint32_t
-static uint32_t bytesToUInt32LE(const QByteArray& data) {
-    if (data.size() < 4) return 0;
-    uint32_t result;
-    memcpy(&result, data.constData(), 4);
-    return qFromLittleEndian(result); // или qFromBigEndian - зависит от протокола
+// Функция для парсинга 2 пакетов в uint32_t (для команд, где 2 пакета = 4 байта данных):
+// data[0], data[1] пакета 0, затем пакета 1, младший байт первым
+static uint32_t parseTwoPackets(const DialogBuffer& data) {
+    if (!data.hasLeading(2)) return 0;
+
+    const DataPacket& low = data.at(0);
+    const DataPacket& high = data.at(1);
+    return uint32_t(low.data[0]) | (uint32_t(low.data[1]) << 8) |
+           (uint32_t(high.data[0]) << 16) | (uint32_t(high.data[1]) << 24);
 }
 
-// Функция для парсинга 2 пакетов в uint32_t (для команд, где 2 пакета = 4 байта данных)
-static uint32_t parseTwoPackets(const QVector<QByteArray>& data) {
-    if (data.size() < 2) return 0;
+const QVector<DataPacket>& PPBConstants::testSequence() {
+    static const QVector<DataPacket> packets = [] {
+        QVector<DataPacket> sequence;
+        sequence.reserve(TEST_PACKET_COUNT);
 
-    // Извлекаем данные из DataPacket (первые 2 байта - данные, остальное - служебные)
-    QByteArray combined;
-    for (const QByteArray& packet : data) {
-        if (packet.size() >= 2) {
-            combined.append(packet.left(2)); // Берем только data[0] и data[1]
-        }
-    }
+        uint8_t lfsr = 0x01; // Начальное значение
+        for (int i = 0; i < TEST_PACKET_COUNT; ++i) {
+            DataPacket packet;
+            packet.data[0] = lfsr;
+            packet.data[1] = lfsr ^ 0x55; // XOR для разнообразия
+            packet.counter = i; // Номер пакета
+
+            // CRC от 3 байт
+            uint8_t crcData[3] = {packet.data[0], packet.data[1], packet.counter};
+            packet.crc = calculateCRC8(crcData, 3);
 
-    return bytesToUInt32LE(combined);
+            sequence.append(packet);
+
+            // LFSR сдвиг
+            lfsr = (lfsr >> 1) | ((lfsr ^ (lfsr >> 1)) << 7);
+        }
+        return sequence;
+    }();
+    return packets;
 }
 
-// Реализация метода create
-std::unique_ptr<PPBCommand> CommandFactory::create(TechCommand cmd) {
+const PPBCommand* CommandFactory::get(TechCommand cmd) {
+    // Команды без состояния - по одному экземпляру на всю программу
+    static const StatusCommand ts;
+    static const ResetCommand tc;
+    static const VersCommand vers;
+    static const VolumeCommand volume;
+    static const CheckSumCommand checksum;
+    static const ProgrammCommand programm;
+    static const CleanCommand clean;
+    static const DROPCommand drop;
+    static const PRBS_M2SCommand prbsM2S;
+    static const PRBS_S2MCommand prbsS2M;
+    static const BER_TCommand berT;
+    static const BER_FCommand berF;
+
     switch (cmd) {
-    case TechCommand::TS: return std::make_unique<StatusCommand>();
-    case TechCommand::TC: return std::make_unique<ResetCommand>();
-    case TechCommand::VERS: return std::make_unique<VersCommand>();
-    case TechCommand::VOLUME: return std::make_unique<VolumeCommand>();
-    case TechCommand::CHECKSUM: return std::make_unique<CheckSumCommand>();
-    case TechCommand::PROGRAMM: return std::make_unique<ProgrammCommand>();
-    case TechCommand::CLEAN: return std::make_unique<CleanCommand>();
-    case TechCommand::DROP: return std::make_unique<DROPCommand>();
-    case TechCommand::PRBS_M2S: return std::make_unique<PRBS_M2SCommand>();
-    case TechCommand::PRBS_S2M: return std::make_unique<PRBS_S2MCommand>();
-    case TechCommand::BER_T: return std::make_unique<BER_TCommand>();
-    case TechCommand::BER_F: return std::make_unique<BER_FCommand>();
+    case TechCommand::TS: return &ts;
+    case TechCommand::TC: return &tc;
+    case TechCommand::VERS: return &vers;
+    case TechCommand::VOLUME: return &volume;
+    case TechCommand::CHECKSUM: return &checksum;
+    case TechCommand::PROGRAMM: return &programm;
+    case TechCommand::CLEAN: return &clean;
+    case TechCommand::DROP: return &drop;
+    case TechCommand::PRBS_M2S: return &prbsM2S;
+    case TechCommand::PRBS_S2M: return &prbsS2M;
+    case TechCommand::BER_T: return &berT;
+    case TechCommand::BER_F: return &berF;
     default: return nullptr;
     }
 }
 
 QString CommandFactory::commandName(TechCommand cmd) {
-    static const QMap<TechCommand, QString> names = {
-                                                     {TechCommand::TS, "Опрос состояния"},
-                                                     {TechCommand::TC, "Сброс"},
-                                                     {TechCommand::VERS, "Запрос версии"},
-                                                     {TechCommand::VOLUME, "Принять том исполняемого ПО"},
-                                                     {TechCommand::CHECKSUM, "Выдать контрольную сумму"},
-                                                     {TechCommand::PROGRAMM, "Обновить исполняемый файл ПО"},
-                                                     {TechCommand::CLEAN, "Очистить временный файл ПО"},
-                                                     {TechCommand::DROP, "Отброшенные пакеты ФУ"},
-                                                     {TechCommand::PRBS_M2S, "Принять тестовую последовательность данных"},
-                                                     {TechCommand::PRBS_S2M, "Выдать тестовую последовательность"},
-                                                     {TechCommand::BER_T, "Коэффициент ошибок линии ТУ"},
-                                                     {TechCommand::BER_F, "Коэффициент ошибок линии ФУ"},
-                                                     };
-    return names.value(cmd, "Неизвестная команда");
+    // Код команды - 4 бита: таблица строк по коду, заполняется один раз
+    static const QString unknown = QStringLiteral("Неизвестная команда");
+    static const std::array<QString, 16> names = [] {
+        std::array<QString, 16> table;
+        table.fill(unknown);
+        for (const CommandDescriptor& descriptor : COMMAND_TABLE) {
+            table[static_cast<uint8_t>(descriptor.id)] = QString::fromUtf8(descriptor.name);
+        }
+        return table;
+    }();
+
+    const uint8_t code = static_cast<uint8_t>(cmd);
+    return code < names.size() ? names[code] : unknown;
 }
 
 // TS
 
-bool StatusCommand::parseResponseData(const QVector<QByteArray>& data,
-                                      QString& outMessage,
-                                      QVariant& outParsedData) const {
+bool ResponseParsers::status(const DialogBuffer& data,
+                             QString& outMessage,
+                             QVariant& outParsedData) {
     outMessage = "Статус получен";
 
     // Сохраняем сырые данные для дальнейшего парсинга в UI
     QVariantList packetsList;
-    for (const auto& packet : data) {
+    for (const QByteArray& packet : data.toByteArrays()) {
         packetsList.append(packet);
     }
     outParsedData = packetsList;
@@ -81,7 +107,7 @@ bool StatusCommand::parseResponseData(const QVector<QByteArray>& data,
     return true;
 }
 
-void StatusCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const {
+void StatusCommand::onDataReceived(CommandInterface* comm, const DialogBuffer& data) const {
     if (!comm) {
         LOG_CAT_WARNING("Command","StatusCommand::onDataReceived: comm is nullptr!");
         return;
@@ -96,7 +122,7 @@ void StatusCommand::onDataReceived(CommandInterface* comm, const QVector<QByteAr
         comm->setParseData(parsedData);
 
         // Отправляем сырые данные для UI
-        emit comm->statusDataReady(data);
+        emit comm->statusDataReady(data.toByteArrays());
 
         // Команда TS успешно выполнена только после получения всех пакетов
         // Завершение операции будет вызвано в communicationengine::completeOperation()
@@ -105,10 +131,10 @@ void StatusCommand::onDataReceived(CommandInterface* comm, const QVector<QByteAr
     }
 }
 // VERS
-bool VersCommand::parseResponseData(const QVector<QByteArray>& data,
-                                    QString& outMessage,
-                                    QVariant& outParsedData) const {
-    if (data.size() < 2) {
+bool ResponseParsers::version(const DialogBuffer& data,
+                              QString& outMessage,
+                              QVariant& outParsedData) {
+    if (!data.hasLeading(2)) {
         outMessage = "Ошибка: получено меньше 2 пакетов";
         return false;
     }
@@ -118,28 +144,28 @@ bool VersCommand::parseResponseData(const QVector<QByteArray>& data,
 
     QVariantMap extraData;
     extraData["crc32"] = crc;
-    extraData["rawPackets"] = data.size();
+    extraData["rawPackets"] = data.received();
     outParsedData = extraData;
 
     return true;
 }
 
-void VersCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const {
+void VersCommand::onDataReceived(CommandInterface* comm, const DialogBuffer& data) const {
     if (!comm) {
         LOG_CAT_WARNING("Command","VersCommand::onDataReceived: comm is nullptr!");
         return;
     }
 
     // 1. Проверяем количество пакетов
-    if (data.size() != expectedResponsePackets()) {
+    if (data.received() != expectedResponsePackets()) {
         // Частичные данные - устанавливаем соответствующий результат
         QString message = QString("Получено %1 из %2 пакетов")
-                              .arg(data.size())
+                              .arg(data.received())
                               .arg(expectedResponsePackets());
 
         // Можно сохранить то, что получили для анализа
         QVariantMap extraData;
-        extraData["received"] = data.size();
+        extraData["received"] = data.received();
         extraData["expected"] = expectedResponsePackets();
         extraData["partial"] = true;
 
@@ -159,14 +185,14 @@ void VersCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArra
     }
 
     // Отправляем сырые данные для UI (если нужно)
-    emit comm->statusDataReady(data);
+    emit comm->statusDataReady(data.toByteArrays());
 }
 
 // CHECKSUM
-bool CheckSumCommand::parseResponseData(const QVector<QByteArray>& data,
-                                        QString& outMessage,
-                                        QVariant& outParsedData) const {
-    if (data.size() < 2) {
+bool ResponseParsers::checksum(const DialogBuffer& data,
+                               QString& outMessage,
+                               QVariant& outParsedData) {
+    if (!data.hasLeading(2)) {
         outMessage = "Ошибка: получено меньше 2 пакетов";
         return false;
     }
@@ -181,7 +207,7 @@ bool CheckSumCommand::parseResponseData(const QVector<QByteArray>& data,
     return true;
 }
 
-void CheckSumCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const {
+void CheckSumCommand::onDataReceived(CommandInterface* comm, const DialogBuffer& data) const {
     if (!comm) {
         LOG_CAT_WARNING("Command","CheckSumCommand::onDataReceived: comm is nullptr!");
         return;
@@ -198,10 +224,10 @@ void CheckSumCommand::onDataReceived(CommandInterface* comm, const QVector<QByte
 }
 
 // DROP
-bool DROPCommand::parseResponseData(const QVector<QByteArray>& data,
-                                    QString& outMessage,
-                                    QVariant& outParsedData) const {
-    if (data.size() < 2) {
+bool ResponseParsers::dropped(const DialogBuffer& data,
+                              QString& outMessage,
+                              QVariant& outParsedData) {
+    if (!data.hasLeading(2)) {
         outMessage = "Ошибка: получено меньше 2 пакетов";
         return false;
     }
@@ -216,7 +242,7 @@ bool DROPCommand::parseResponseData(const QVector<QByteArray>& data,
     return true;
 }
 
-void DROPCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const {
+void DROPCommand::onDataReceived(CommandInterface* comm, const DialogBuffer& data) const {
     if (!comm) {
         LOG_CAT_WARNING("Command","DROPCommand::onDataReceived: comm is nullptr!");
         return;
@@ -233,10 +259,10 @@ void DROPCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArra
 }
 
 // ===== BER_TCommand =====
-bool BER_TCommand::parseResponseData(const QVector<QByteArray>& data,
-                                     QString& outMessage,
-                                     QVariant& outParsedData) const {
-    if (data.size() < 2) {
+bool ResponseParsers::berT(const DialogBuffer& data,
+                           QString& outMessage,
+                           QVariant& outParsedData) {
+    if (!data.hasLeading(2)) {
         outMessage = "Ошибка: получено меньше 2 пакетов";
         return false;
     }
@@ -253,7 +279,7 @@ bool BER_TCommand::parseResponseData(const QVector<QByteArray>& data,
     return true;
 }
 
-void BER_TCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const {
+void BER_TCommand::onDataReceived(CommandInterface* comm, const DialogBuffer& data) const {
     if (!comm) {
         LOG_CAT_WARNING("Command","BER_TCommand::onDataReceived: comm is nullptr!");
         return;
@@ -270,10 +296,10 @@ void BER_TCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArr
 }
 
 // ===== BER_FCommand =====
-bool BER_FCommand::parseResponseData(const QVector<QByteArray>& data,
-                                     QString& outMessage,
-                                     QVariant& outParsedData) const {
-    if (data.size() < 2) {
+bool ResponseParsers::berF(const DialogBuffer& data,
+                           QString& outMessage,
+                           QVariant& outParsedData) {
+    if (!data.hasLeading(2)) {
         outMessage = "Ошибка: получено меньше 2 пакетов";
         return false;
     }
@@ -290,7 +316,7 @@ bool BER_FCommand::parseResponseData(const QVector<QByteArray>& data,
     return true;
 }
 
-void BER_FCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const {
+void BER_FCommand::onDataReceived(CommandInterface* comm, const DialogBuffer& data) const {
     if (!comm) {
         LOG_CAT_WARNING("Command","BER_FCommand::onDataReceived: comm is nullptr!");
         return;
@@ -312,27 +338,9 @@ void PRBS_M2SCommand::onOkReceived(CommandInterface* comm, uint16_t address) con
         LOG_CAT_WARNING("Command","StatusCommand::onDataReceived: comm is nullptr!");
         return;
     }
-    // Генерируем тестовые пакеты прямо здесь
-    QVector<DataPacket> testPackets;
-
-    // Генерация 256 пакетов по протоколу
-    uint8_t lfsr = 0x01; // Начальное значение
+    // 256 пакетов тестовой последовательности по протоколу (общий экземпляр, без копии)
+    const QVector<DataPacket>& testPackets = PPBConstants::testSequence();
 
-    for (int i = 0; i < PPBConstants::TEST_PACKET_COUNT; ++i) {
-        DataPacket packet;
-        packet.data[0] = lfsr;
-        packet.data[1] = lfsr ^ 0x55; // XOR для разнообразия
-        packet.counter = i; // Номер пакета
-
-        // CRC от 3 байт
-        uint8_t crcData[3] = {packet.data[0], packet.data[1], packet.counter};
-        packet.crc = calculateCRC8(crcData, 3);
-
-        testPackets.append(packet);
-
-        // LFSR сдвиг
-        lfsr = (lfsr >> 1) | ((lfsr ^ (lfsr >> 1)) << 7);
-    }
     // Уведомляем о новых отправленных пакетах
     comm->notifySentPackets(testPackets);
 
@@ -343,57 +351,47 @@ void PRBS_M2SCommand::onOkReceived(CommandInterface* comm, uint16_t address) con
 }
 
 // ===== PRBS_S2MCommand =====
-bool PRBS_S2MCommand::parseResponseData(const QVector<QByteArray>& data,
-                                        QString& outMessage,
-                                        QVariant& outParsedData) const
+bool ResponseParsers::testSequence(const DialogBuffer& data,
+                                   QString& outMessage,
+                                   QVariant& outParsedData)
 {
     // Простая проверка количества
-    if (data.size() != expectedResponsePackets()) {
+    if (data.received() != PPBConstants::TEST_PACKET_COUNT) {
         outMessage = QString("Неверное количество пакетов: %1 (ожидалось %2)")
-                         .arg(data.size())
-                         .arg(expectedResponsePackets());
+                         .arg(data.received())
+                         .arg(PPBConstants::TEST_PACKET_COUNT);
         return false;
     }
 
-    outMessage = QString("Получено %1 пакетов тестовой последовательности").arg(data.size());
+    outMessage = QString("Получено %1 пакетов тестовой последовательности").arg(data.received());
 
     QVariantMap extraData;
-    extraData["packetCount"] = data.size();
+    extraData["packetCount"] = data.received();
     outParsedData = extraData;
 
     return true;
 }
 
-void PRBS_S2MCommand::onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const
+void PRBS_S2MCommand::onDataReceived(CommandInterface* comm, const DialogBuffer& data) const
 {
     if (!comm) {
         LOG_CAT_WARNING("Command","PRBS_S2MCommand::onDataReceived: comm is nullptr!");
         return;
     }
 
-    // 1. Парсим полученные пакеты
-    QVector<DataPacket> receivedPackets;
-    int parseErrors = 0;
-
-    for (const auto& packetData : data) {
-        DataPacket packet;
-        if (PacketBuilder::parseDataPacket(packetData, packet)) {
-            receivedPackets.append(packet);
-        } else {
-            parseErrors++;
-            LOG_CAT_WARNING("Command",QString("Ошибка парсинга пакета %1").arg(receivedPackets.size() + parseErrors));
-        }
-    }
+    // 1. Пакеты уже разобраны и проверены по CRC при приеме, лежат по счетчикам
+    const QVector<DataPacket> receivedPackets = data.packets();
 
     // Уведомляем о полученных пакетах
     comm->notifyReceivedPackets(receivedPackets);
 
     // 2. Проверяем, получили ли мы все пакеты
     if (receivedPackets.size() != PPBConstants::TEST_PACKET_COUNT) {
-        QString error = QString("Получено %1 из %2 пакетов (ошибок парсинга: %3)")
+        QString error = QString("Получено %1 из %2 пакетов (повторов: %3, вне последовательности: %4)")
                             .arg(receivedPackets.size())
                             .arg(PPBConstants::TEST_PACKET_COUNT)
-                            .arg(parseErrors);
+                            .arg(data.duplicates())
+                            .arg(data.outOfRange());
         comm->setParseResult(false, error);
         return;
     }
@@ -406,7 +404,8 @@ void PRBS_S2MCommand::onDataReceived(CommandInterface* comm, const QVector<QByte
 
     // Сохраняем количество пакетов
     extraData["packetCount"] = receivedPackets.size();
-    extraData["parseErrors"] = parseErrors;
+    extraData["duplicates"] = data.duplicates();
+    extraData["outOfRange"] = data.outOfRange();
 
     // Если нужно сохранить сами пакеты, можно сделать так:
     // extraData["receivedPackets"] = QVariant::fromValue(receivedPackets);
@@ -420,6 +419,17 @@ void PRBS_S2MCommand::onDataReceived(CommandInterface* comm, const QVector<QByte
     // emit comm->testDataReady(receivedPackets); - если нужно для UI
 }
 
+bool PRBS_S2MCommand::onPacket(CommandInterface* comm, int index, const DataPacket& packet,
+                               const StreamingAnalyzer& stream) const
+{
+    Q_UNUSED(comm);
+    Q_UNUSED(index);
+    Q_UNUSED(packet);
+
+    // Пропуски и BER уже посчитаны на лету; превышен порог - остаток пачки не ждем
+    return !stream.failed();
+}
+
 // VOLUME
 void VolumeCommand::onOkReceived(CommandInterface* comm, uint16_t address) const {
     if (!comm) {
@@ -7,6 +7,8 @@
 #include "ppbprotocol.h"
 #include "packetbuilder.h"
 #include "commandinterface.h"
+#include "dialogbuffer.h"
+#include "../../analyzer/streaminganalyzer.h"
 #include <QTimer>
 
 #include "../logging/logging_unified.h"
@@ -23,8 +25,93 @@ constexpr int CHECKSUM_RESPONSE=2;            //2 пакета контр сум
 constexpr int TS_TIMEOUT_MS = 1000;          // Таймаут подключения
 constexpr int DATA_TIMEOUT_MS = 10000;       // Таймаут получения данных
 constexpr int PRBS_TIMEOUT_MS = 100;       // Таймаут для тестовых последовательностей
+constexpr int COMMAND_TIMEOUT_MS = 3000;     // Таймаут команды по умолчанию
+
+// Тестовая последовательность PRBS (LFSR от 0x01): ее передает PRBS_M2S,
+// с ней же на лету сравнивается ответ PRBS_S2M. Строится один раз
+const QVector<DataPacket>& testSequence();
+}
+
+// ===== ТАБЛИЦА КОМАНД =====
+// Направление фазы данных после OK
+enum class DataDirection : uint8_t {
+    None,       // команда завершается самим OK
+    FromPPB,    // ППБ присылает expectedPackets пакетов
+    ToPPB       // тестер передает пакеты (пакетная передача)
+};
+
+// Класс команды в очереди адреса: меньше - раньше
+enum class CommandPriority : uint8_t {
+    Control,        // сброс, подключение: вне очереди
+    Interactive,    // команды оператора
+    Poll,           // автоопрос состояния
+    Bulk,           // длинные передачи данных
+    Count
+};
+
+// Разбор пакетов ответа (по счетчикам, CRC уже проверен) в сообщение и данные для UI
+using ResponseParser = bool (*)(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+
+namespace ResponseParsers {
+bool status(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+bool version(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+bool checksum(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+bool dropped(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+bool berT(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+bool berF(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+bool testSequence(const DialogBuffer& data, QString& outMessage, QVariant& outParsedData);
+}
+
+// Все, что известно о команде без ее экземпляра
+struct CommandDescriptor {
+    TechCommand id;
+    const char* name;            // UTF-8
+    int expectedPackets;         // пакетов ответа после OK
+    int timeoutMs;
+    DataDirection direction;
+    CommandPriority priority;    // класс в очереди (подключение - Control независимо от таблицы)
+    bool idempotent;             // только чтение: одинаковые запросы в очереди сливаются в один
+    ResponseParser parser;       // nullptr - только счетчик пакетов
+    bool repairable = false;     // повтор запроса дает те же пакеты: пропуски можно дозапросить
+};
+
+inline constexpr CommandDescriptor COMMAND_TABLE[] = {
+    {TechCommand::TS,       "Опрос состояния",                            PPBConstants::STATUS_RESPONSE,   PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::FromPPB, CommandPriority::Interactive, true,  &ResponseParsers::status},
+    {TechCommand::TC,       "Сброс",                                      0,                               PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::None,    CommandPriority::Control,     false, nullptr},
+    {TechCommand::VERS,     "Запрос версии",                              PPBConstants::VERS_RESPONSE,     PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::FromPPB, CommandPriority::Interactive, true,  &ResponseParsers::version},
+    {TechCommand::VOLUME,   "Принять том исполняемого ПО",                0,                               PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::ToPPB,   CommandPriority::Bulk,        false, nullptr},
+    {TechCommand::CHECKSUM, "Выдать контрольную сумму",                   PPBConstants::CHECKSUM_RESPONSE, PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::FromPPB, CommandPriority::Interactive, true,  &ResponseParsers::checksum},
+    {TechCommand::PROGRAMM, "Обновить исполняемый файл ПО",               0,                               PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::None,    CommandPriority::Interactive, false, nullptr},
+    {TechCommand::CLEAN,    "Очистить временный файл ПО",                 0,                               PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::None,    CommandPriority::Interactive, false, nullptr},
+    {TechCommand::DROP,     "Отброшенные пакеты ФУ",                      0,                               PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::None,    CommandPriority::Interactive, true,  &ResponseParsers::dropped},
+    {TechCommand::PRBS_M2S, "Принять тестовую последовательность данных", 0,                               PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::ToPPB,   CommandPriority::Bulk,        false, nullptr},
+    {TechCommand::PRBS_S2M, "Выдать тестовую последовательность",         PPBConstants::TEST_PACKET_COUNT, PPBConstants::DATA_TIMEOUT_MS,    DataDirection::FromPPB, CommandPriority::Bulk,        false, &ResponseParsers::testSequence, true},
+    {TechCommand::BER_T,    "Коэффициент ошибок линии ТУ",                PPBConstants::BER_RESPONSE,      PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::FromPPB, CommandPriority::Interactive, true,  &ResponseParsers::berT},
+    {TechCommand::BER_F,    "Коэффициент ошибок линии ФУ",                PPBConstants::BER_RESPONSE,      PPBConstants::COMMAND_TIMEOUT_MS, DataDirection::FromPPB, CommandPriority::Interactive, true,  &ResponseParsers::berF},
+};
+
+constexpr const CommandDescriptor* findCommandDescriptor(TechCommand id)
+{
+    for (const CommandDescriptor& descriptor : COMMAND_TABLE) {
+        if (descriptor.id == id) {
+            return &descriptor;
+        }
+    }
+    return nullptr;
 }
 
+// Пакеты ответа есть ровно у команд с данными от ППБ
+constexpr bool commandTableConsistent()
+{
+    for (const CommandDescriptor& descriptor : COMMAND_TABLE) {
+        if ((descriptor.direction == DataDirection::FromPPB) != (descriptor.expectedPackets > 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(commandTableConsistent(), "COMMAND_TABLE: expectedPackets не согласован с direction");
+
 // Базовый класс для всех команд
 class PPBCommand {
 
@@ -39,6 +126,8 @@ public:
 
     // Создать пакет запроса
     virtual QByteArray buildRequest(uint16_t address) const = 0;
+    // Тот же запрос записью на стеке - для отправки движком без выделения памяти
+    virtual BaseRequest buildRequestRecord(uint16_t address) const = 0;
 
     // Ожидаемое количество пакетов ответа
     virtual int expectedResponsePackets() const = 0;
@@ -58,7 +147,7 @@ public:
         }
     }
 
-    virtual void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const
+    virtual void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const
     {
         if (!comm) {
             LOG_CAT_WARNING("COMMAND","PPBCommand::onDataReceived: comm is nullptr!");
@@ -80,14 +169,30 @@ public:
     }
 
 
+    // Пакет ответа принят (новый счетчик, CRC проверен) - сразу, не дожидаясь конца пачки.
+    // stream - статистика ответа с учетом этого пакета. false - принимать дальше
+    // бессмысленно: прием прекращается, операция завершается с ошибкой
+    virtual bool onPacket(CommandInterface* comm, int index, const DataPacket& packet,
+                          const StreamingAnalyzer& stream) const
+    {
+        Q_UNUSED(comm);
+        Q_UNUSED(index);
+        Q_UNUSED(packet);
+        Q_UNUSED(stream);
+        return true;
+    }
+
+    // Эталон ответа по счетчикам для сравнения на лету; nullptr - считаются только пропуски
+    virtual const QVector<DataPacket>* referencePackets() const { return nullptr; }
+
     virtual void onTimeout(CommandInterface* comm) const  {comm->completeCurrentOperation(false, "Таймаут операции"); }
 
-    virtual bool parseResponseData(const QVector<QByteArray>& data,
+    virtual bool parseResponseData(const DialogBuffer& data,
                                    QString& outMessage,
                                    QVariant& outParsedData) const
     {
         // Базовая реализация - просто формирует сообщение о количестве пакетов
-        outMessage = QString("Получено %1 пакетов").arg(data.size());
+        outMessage = QString("Получено %1 пакетов").arg(data.received());
         outParsedData = QVariant(); // Пустые данные по умолчанию
         return true;
     }
@@ -95,7 +200,7 @@ public:
     virtual bool isConnectionCritical() const { return false; }
 
     virtual void onPartialDataReceived(CommandInterface* comm,
-                                       const QVector<QByteArray>& data,
+                                       const DialogBuffer& data,
                                        int received, int expected) const
     {
         // Реализация по умолчанию - просто таймаут
@@ -105,99 +210,114 @@ public:
 
 };
 
-// Базовый шаблонный класс конкретной команды
-template<TechCommand CmdId, int ExpectedPackets = 0, int Timeout = 3000>
+// Базовый шаблонный класс конкретной команды: параметры - из COMMAND_TABLE.
+// Команды без состояния: CommandFactory::get отдает общий неизменяемый экземпляр
+template<TechCommand CmdId>
 class ConcretePPBCommand : public PPBCommand {
 public:
+    static_assert(findCommandDescriptor(CmdId) != nullptr, "Команды нет в COMMAND_TABLE");
+    static constexpr const CommandDescriptor& descriptor() { return *findCommandDescriptor(CmdId); }
+
     TechCommand commandId() const override { return CmdId; }
-    int expectedResponsePackets() const override { return ExpectedPackets; }
-    int timeoutMs() const override { return Timeout; }
+    int expectedResponsePackets() const override { return descriptor().expectedPackets; }
+    int timeoutMs() const override { return descriptor().timeoutMs; }
 
     QByteArray buildRequest(uint16_t address) const override {
         return PacketBuilder::createTURequest(address, CmdId);
     }
+    BaseRequest buildRequestRecord(uint16_t address) const override {
+        return PacketBuilder::makeTURequest(address, CmdId);
+    }
+
+    bool parseResponseData(const DialogBuffer& data,
+                           QString& outMessage,
+                           QVariant& outParsedData) const override {
+        if (descriptor().parser) {
+            return descriptor().parser(data, outMessage, outParsedData);
+        }
+        return PPBCommand::parseResponseData(data, outMessage, outParsedData);
+    }
 
     QString name() const override;
 };
 
 // TS команда с переопределенным onDataReceived
-class StatusCommand : public ConcretePPBCommand<TechCommand::TS, PPBConstants::STATUS_RESPONSE> {
+class StatusCommand : public ConcretePPBCommand<TechCommand::TS> {
 public:
     bool isConnectionCritical() const override { return true; }
-    void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const override;
-    bool parseResponseData(const QVector<QByteArray>& data, QString& outMessage, QVariant& outParsedData) const override;
+    void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const override;
 };
 
 // TC команда (использует реализацию по умолчанию)
-using ResetCommand = ConcretePPBCommand<TechCommand::TC, 0>;
+using ResetCommand = ConcretePPBCommand<TechCommand::TC>;
 
 // VERS команда с переопределенным onDataReceived
-class VersCommand : public ConcretePPBCommand<TechCommand::VERS, PPBConstants::VERS_RESPONSE> {
+class VersCommand : public ConcretePPBCommand<TechCommand::VERS> {
 public:
-    void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const override;
-    bool parseResponseData(const QVector<QByteArray>& data, QString& outMessage, QVariant& outParsedData) const override;
+    void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const override;
 };
 
 // VOLUME команда с переопределенным onOkReceived
-class VolumeCommand : public ConcretePPBCommand<TechCommand::VOLUME, 0> {
+class VolumeCommand : public ConcretePPBCommand<TechCommand::VOLUME> {
 public:
     void onOkReceived(CommandInterface* comm, uint16_t address) const override;
 };
 
 // CHECKSUM команда с переопределенным onDataReceived
-class CheckSumCommand : public ConcretePPBCommand<TechCommand::CHECKSUM, PPBConstants::CHECKSUM_RESPONSE> {
+class CheckSumCommand : public ConcretePPBCommand<TechCommand::CHECKSUM> {
 public:
-    void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const override;
-    bool parseResponseData(const QVector<QByteArray>& data, QString& outMessage, QVariant& outParsedData) const override;
+    void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const override;
 };
 
 // Остальные команды (используют реализацию по умолчанию)
-using ProgrammCommand = ConcretePPBCommand<TechCommand::PROGRAMM, 0>;
-using CleanCommand = ConcretePPBCommand<TechCommand::CLEAN, 0>;
+using ProgrammCommand = ConcretePPBCommand<TechCommand::PROGRAMM>;
+using CleanCommand = ConcretePPBCommand<TechCommand::CLEAN>;
 
 // DROP команда с переопределенным onDataReceived
-class DROPCommand : public ConcretePPBCommand<TechCommand::DROP, 0> {
+class DROPCommand : public ConcretePPBCommand<TechCommand::DROP> {
 public:
-    void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const override;
-    bool parseResponseData(const QVector<QByteArray>& data, QString& outMessage, QVariant& outParsedData) const override;
+    void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const override;
 };
 
 // PRBS_M2S команда с переопределенным onOkReceived
-class PRBS_M2SCommand : public ConcretePPBCommand<TechCommand::PRBS_M2S, PPBConstants::PRBS_TIMEOUT_MS> {
+class PRBS_M2SCommand : public ConcretePPBCommand<TechCommand::PRBS_M2S> {
 public:
     void onOkReceived(CommandInterface* comm, uint16_t address) const override;
 };
 
 // PRBS_S2M команда с переопределенным onDataReceived
-class PRBS_S2MCommand : public ConcretePPBCommand<TechCommand::PRBS_S2M, PPBConstants::TEST_PACKET_COUNT, 10000> {
+class PRBS_S2MCommand : public ConcretePPBCommand<TechCommand::PRBS_S2M> {
 public:
-    void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const override;
-    bool parseResponseData(const QVector<QByteArray>& data, QString& outMessage, QVariant& outParsedData) const override;
+    void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const override;
+    bool onPacket(CommandInterface* comm, int index, const DataPacket& packet,
+                  const StreamingAnalyzer& stream) const override;
+    const QVector<DataPacket>* referencePackets() const override { return &PPBConstants::testSequence(); }
 };
 
 // BER_T команда с переопределенным onDataReceived
-class BER_TCommand : public ConcretePPBCommand<TechCommand::BER_T, PPBConstants::BER_RESPONSE> {
+class BER_TCommand : public ConcretePPBCommand<TechCommand::BER_T> {
 public:
-    void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const override;
-     bool parseResponseData(const QVector<QByteArray>& data, QString& outMessage, QVariant& outParsedData) const override;
+    void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const override;
 };
 
 // BER_F команда с переопределенным onDataReceived
-class BER_FCommand : public ConcretePPBCommand<TechCommand::BER_F, PPBConstants::BER_RESPONSE> {
+class BER_FCommand : public ConcretePPBCommand<TechCommand::BER_F> {
 public:
-    void onDataReceived(CommandInterface* comm, const QVector<QByteArray>& data) const override;
-    bool parseResponseData(const QVector<QByteArray>& data, QString& outMessage, QVariant& outParsedData) const override;
+    void onDataReceived(CommandInterface* comm, const DialogBuffer& data) const override;
 };
 
 class CommandFactory {
 public:
-    static std::unique_ptr<PPBCommand> create(TechCommand cmd);
+    // Общий неизменяемый экземпляр команды (без выделения памяти); nullptr - неизвестная команда
+    static const PPBCommand* get(TechCommand cmd);
+    static const CommandDescriptor* descriptor(TechCommand cmd) { return findCommandDescriptor(cmd); }
+    // Строки имен создаются один раз, дальше - копия разделяемой строки
     static QString commandName(TechCommand cmd);
 };
 
 // Определяем метод name() для ConcretePPBCommand
-template<TechCommand CmdId, int ExpectedPackets, int Timeout>
-QString ConcretePPBCommand<CmdId, ExpectedPackets, Timeout>::name() const {
+template<TechCommand CmdId>
+QString ConcretePPBCommand<CmdId>::name() const {
     return CommandFactory::commandName(CmdId);
 }
 
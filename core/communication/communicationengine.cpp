@@ -1,10 +1,17 @@
 #include "communicationengine.h"
-#include <QMutex>
+#include "trafficreplay.h"
 #include <QThread>
+#include <QStringList>
+#include <algorithm>
+#include <utility>
 
 #include "../logging/logging_unified.h"
 
-static int techCommandType = qRegisterMetaType<TechCommand>("TechCommand");
+// Имя команды из COMMAND_TABLE для журнала и отправки - без создания QString
+static const char* commandLabel(const PPBCommand* command) {
+    const CommandDescriptor* descriptor = CommandFactory::descriptor(command->commandId());
+    return descriptor ? descriptor->name : "?";
+}
 
 // Определения методов для Internal::StateManager
 namespace Internal {
@@ -12,22 +19,18 @@ namespace Internal {
 StateManager::StateManager(QObject* parent) : QObject(parent) {}
 
 PPBState StateManager::getState(uint16_t address) const {
-    QMutexLocker locker(&m_mutex);
-    return m_states.value(address, PPBState::Idle);
+    const PPBState* state = m_states.find(address);
+    return state ? *state : PPBState::Idle;
 }
 
 void StateManager::setState(uint16_t address, PPBState state) {
-    {
-        QMutexLocker locker(&m_mutex);
-        PPBState oldState = m_states.value(address, PPBState::Idle);
-        if (oldState == state) return;
-        m_states[address] = state;
-    }
+    PPBState& current = m_states[address];
+    if (current == state) return;
+    current = state;
     emit stateChanged(address, state);
 }
 
 void StateManager::clear() {
-    QMutexLocker locker(&m_mutex);
     m_states.clear();
 }
 
@@ -37,48 +40,252 @@ CommandQueue::~CommandQueue() {
     clear(); // Очищаем все команды при уничтожении
 }
 
-void Internal::CommandQueue::enqueue(uint16_t address, std::unique_ptr<PPBCommand> cmd) {
-    QMutexLocker locker(&m_mutex);
-    m_queues[address].push_back(std::move(cmd));
-    emit queueChanged(address, m_queues[address].size());
+void Internal::CommandQueue::ClassQueue::push_back(QueuedCommand&& item) {
+    if (m_size == m_items.size()) {
+        // Рост: элементы переносятся по порядку, голова - в начало
+        std::vector<QueuedCommand> items(qMax<size_t>(4, m_items.size() * 2));
+        for (size_t i = 0; i < m_size; ++i) {
+            items[i] = std::move((*this)[i]);
+        }
+        m_items.swap(items);
+        m_head = 0;
+    }
+    m_items[(m_head + m_size) % m_items.size()] = std::move(item);
+    ++m_size;
+}
+
+void Internal::CommandQueue::ClassQueue::pop_front() {
+    m_items[m_head] = QueuedCommand();
+    m_head = (m_head + 1) % m_items.size();
+    --m_size;
+}
+
+void Internal::CommandQueue::ClassQueue::erase(size_t index) {
+    for (size_t i = index; i + 1 < m_size; ++i) {
+        (*this)[i] = std::move((*this)[i + 1]);
+    }
+    (*this)[m_size - 1] = QueuedCommand();
+    --m_size;
+}
+
+void Internal::CommandQueue::setDefaultLimit(int depth, QueueOverflowPolicy policy) {
+    m_defaultLimit = Limit{qMax(0, depth), policy};
 }
 
-std::unique_ptr<PPBCommand> Internal::CommandQueue::dequeue(uint16_t address) {
-    QMutexLocker locker(&m_mutex);
+void Internal::CommandQueue::setLimit(uint16_t address, int depth, QueueOverflowPolicy policy) {
+    m_limits.insert(address, Limit{qMax(0, depth), policy});
+}
+
+Internal::CommandQueue::EnqueueResult Internal::CommandQueue::enqueue(
+    uint16_t address, const PPBCommand* cmd, int64_t enqueuedAtNs,
+    CommandPriority priority, quint64 requestId, QueuedCommand* dropped) {
+    if (priority >= CommandPriority::Count) {
+        priority = CommandPriority::Bulk;
+    }
+    if (enqueuedAtNs == 0) {
+        enqueuedAtNs = wallClockNs();
+    }
+
+    ClassQueues& queues = m_queues[address];
+
+    // Одинаковый запрос только на чтение уже ждет - его результат годится всем
+    const CommandDescriptor* descriptor = cmd ? CommandFactory::descriptor(cmd->commandId()) : nullptr;
+    if (descriptor && descriptor->idempotent && attach(queues, cmd, priority, enqueuedAtNs, requestId)) {
+        ++m_coalesced;
+        return EnqueueResult::Coalesced;
+    }
+
+    // Лимит глубины: управление (сброс, подключение) принимается всегда
+    const Limit limit = m_limits.value(address, m_defaultLimit);
+    EnqueueResult result = EnqueueResult::Queued;
+    if (limit.depth > 0 && priority != CommandPriority::Control && totalSize(queues) >= limit.depth) {
+        switch (limit.policy) {
+        case QueueOverflowPolicy::Coalesce:
+            if (attach(queues, cmd, priority, enqueuedAtNs, requestId)) {
+                ++m_coalesced;
+                return EnqueueResult::CoalescedOverflow;
+            }
+            return EnqueueResult::Rejected;
 
-    auto it = m_queues.find(address);
-    if (it != m_queues.end() && !it->second.empty()) {
-        // Берем первый элемент из deque
-        std::unique_ptr<PPBCommand> cmd = std::move(it->second.front());
-        it->second.pop_front();
+        case QueueOverflowPolicy::DropOldest: {
+            // Вытесняем только менее или так же срочное, чем новая команда
+            int level = static_cast<int>(queues.size()) - 1;
+            while (level >= 0 && queues[level].empty()) {
+                --level;
+            }
+            if (level < static_cast<int>(priority)) {
+                return EnqueueResult::Rejected;
+            }
+            if (dropped) {
+                *dropped = std::move(queues[level].front());
+            }
+            queues[level].pop_front();
+            result = EnqueueResult::DroppedOldest;
+            break;
+        }
 
-        if (it->second.empty()) {
-            m_queues.erase(it);
+        case QueueOverflowPolicy::Reject:
+            return EnqueueResult::Rejected;
         }
+    }
 
-        emit queueChanged(address, m_queues.count(address) ? m_queues[address].size() : 0);
-        return cmd;
+    QueuedCommand item{cmd, enqueuedAtNs, enqueuedAtNs, {}};
+    if (requestId != 0) {
+        item.requestIds.append(requestId);
     }
+    queues[size_t(priority)].push_back(std::move(item));
+    emit queueChanged(address, totalSize(queues));
+    return result;
+}
 
-    return nullptr;
+bool Internal::CommandQueue::attach(ClassQueues& queues, const PPBCommand* cmd, CommandPriority priority,
+                                    int64_t enqueuedAtNs, quint64 requestId) {
+    for (size_t level = 0; level < queues.size(); ++level) {
+        ClassQueue& queue = queues[level];
+        size_t index = 0;
+        while (index < queue.size() && queue[index].command != cmd) {
+            ++index;
+        }
+        if (index == queue.size()) {
+            continue;
+        }
+
+        if (requestId != 0) {
+            queue[index].requestIds.append(requestId);
+        }
+
+        // Присоединившийся ждет срочнее - команда переходит в его класс
+        if (size_t(priority) < level) {
+            QueuedCommand item = std::move(queue[index]);
+            queue.erase(index);
+            item.classSinceNs = enqueuedAtNs;
+            queues[size_t(priority)].push_back(std::move(item));
+        }
+        return true;
+    }
+    return false;
+}
+
+const PPBCommand* Internal::CommandQueue::dequeue(uint16_t address, int64_t* enqueuedAtNs,
+                                                  QVector<quint64>* requestIds) {
+    ClassQueues* queues = m_queues.find(address);
+    if (!queues) {
+        return nullptr;
+    }
+
+    // Берем первый элемент старшего непустого класса; кольца сохраняют емкость - без аллокаций
+    const int level = firstClass(*queues);
+    if (level < 0) {
+        return nullptr;
+    }
+    ClassQueue* queue = &(*queues)[level];
+
+    const PPBCommand* cmd = queue->front().command;
+    if (enqueuedAtNs) {
+        *enqueuedAtNs = queue->front().enqueuedAtNs;
+    }
+    if (requestIds) {
+        *requestIds = std::move(queue->front().requestIds);
+    }
+    queue->pop_front();
+
+    emit queueChanged(address, totalSize(*queues));
+    return cmd;
+}
+
+const PPBCommand* Internal::CommandQueue::front(uint16_t address) const {
+    const ClassQueues* queues = m_queues.find(address);
+    const int level = queues ? firstClass(*queues) : -1;
+    return level >= 0 ? (*queues)[level].front().command : nullptr;
+}
+
+CommandPriority Internal::CommandQueue::frontPriority(uint16_t address) const {
+    const ClassQueues* queues = m_queues.find(address);
+    const int level = queues ? firstClass(*queues) : -1;
+    return level >= 0 ? static_cast<CommandPriority>(level) : CommandPriority::Count;
+}
+
+int Internal::CommandQueue::count(uint16_t address, CommandPriority priority) const {
+    const ClassQueues* queues = m_queues.find(address);
+    if (!queues || priority >= CommandPriority::Count) {
+        return 0;
+    }
+    return static_cast<int>((*queues)[size_t(priority)].size());
 }
+
+int Internal::CommandQueue::size(uint16_t address) const {
+    const ClassQueues* queues = m_queues.find(address);
+    return queues ? totalSize(*queues) : 0;
+}
+
 bool Internal::CommandQueue::isEmpty(uint16_t address) const {
-    QMutexLocker locker(&m_mutex);
-    auto it = m_queues.find(address);
-    return it == m_queues.end() || it->second.empty();
+    const ClassQueues* queues = m_queues.find(address);
+    return !queues || firstClass(*queues) < 0;
 }
 
-void Internal::CommandQueue::clear() {
-    QMutexLocker locker(&m_mutex);
+void Internal::CommandQueue::clear(QVector<quint64>* requestIds) {
+    if (requestIds) {
+        m_queues.forEach([requestIds](uint16_t, const ClassQueues& queues) {
+            for (const ClassQueue& queue : queues) {
+                for (size_t i = 0; i < queue.size(); ++i) {
+                    *requestIds += queue[i].requestIds;
+                }
+            }
+        });
+    }
     m_queues.clear();
 }
 
+void Internal::CommandQueue::setAgingMs(int agingMs) {
+    m_agingNs = int64_t(qMax(0, agingMs)) * 1000000;
+}
+
+int Internal::CommandQueue::age(uint16_t address, int64_t nowNs) {
+    ClassQueues* queues = m_queues.find(address);
+    if (!queues || m_agingNs <= 0) {
+        return 0;
+    }
+
+    // От старших классов к младшим: повышенная команда за один проход поднимается на один класс.
+    // Внутри класса команды упорядочены по времени попадания в него - проверяем только голову
+    int promoted = 0;
+    for (size_t level = 1; level < queues->size(); ++level) {
+        ClassQueue& queue = (*queues)[level];
+        while (!queue.empty() && nowNs - queue.front().classSinceNs >= m_agingNs) {
+            QueuedCommand item = std::move(queue.front());
+            queue.pop_front();
+            item.classSinceNs = nowNs;
+            (*queues)[level - 1].push_back(std::move(item));
+            ++promoted;
+        }
+    }
+    return promoted;
+}
+
+int Internal::CommandQueue::firstClass(const ClassQueues& queues) {
+    for (size_t level = 0; level < queues.size(); ++level) {
+        if (!queues[level].empty()) {
+            return static_cast<int>(level);
+        }
+    }
+    return -1;
+}
+
+int Internal::CommandQueue::totalSize(const ClassQueues& queues) {
+    int size = 0;
+    for (const ClassQueue& queue : queues) {
+        size += static_cast<int>(queue.size());
+    }
+    return size;
+}
+
 QList<uint16_t> Internal::CommandQueue::addresses() const {
-    QMutexLocker locker(&m_mutex);
     QList<uint16_t> keys;
-    for (const auto& pair : m_queues) {
-        keys.append(pair.first);
-    }
+    m_queues.forEach([&keys](uint16_t address, const ClassQueues& queues) {
+        if (firstClass(queues) >= 0) {
+            keys.append(address);
+        }
+    });
     return keys;
 }
 
@@ -87,61 +294,92 @@ QList<uint16_t> Internal::CommandQueue::addresses() const {
 communicationengine::communicationengine(UDPClient* udpClient, QObject* parent)
     : QObject(parent)
     , m_udpClient(udpClient)
-    , m_queueTimer(nullptr)
     , m_commandInterface(nullptr)
-    , m_timeoutTimer(nullptr)
     , m_currentAddress(0)
     , m_currentPort(0)
-    , m_activeDataAddress(0)
-    , m_waitingForData(false)
     , m_stateManager(new Internal::StateManager(this))
     , m_commandQueue(new Internal::CommandQueue(this))
 {
 
     LOG_CAT_INFO("Engine","communicationengine создан");
 
+    // Типы сигналов, уходящих в GUI через очередь событий
+    qRegisterMetaType<TechCommand>("TechCommand");
+    qRegisterMetaType<PacerStats>("PacerStats");
+    qRegisterMetaType<BroadcastResult>("BroadcastResult");
+    qRegisterMetaType<TimerWheelStats>("TimerWheelStats");
+    qRegisterMetaType<QueueOverflowPolicy>("QueueOverflowPolicy");
+    qRegisterMetaType<OverloadEvent>("OverloadEvent");
+    qRegisterMetaType<EngineMetricsSnapshot>("EngineMetricsSnapshot");
+    qRegisterMetaType<StreamStats>("StreamStats");
+
     if (m_udpClient) {
         connect(m_udpClient, &UDPClient::dataReceived,
                 this, &communicationengine::onDataReceived, Qt::DirectConnection);
+        connect(m_udpClient, &UDPClient::datagramsReceived,
+                this, &communicationengine::onDatagramsReceived, Qt::DirectConnection);
         connect(m_udpClient, &UDPClient::errorOccurred,
                 this, &communicationengine::onNetworkError, Qt::DirectConnection);
+        connect(m_udpClient, &UDPClient::receiveOverflow,
+                this, &communicationengine::onReceiveOverflow, Qt::DirectConnection);
     }
 
-    m_queueTimer = new QTimer(this);
-    m_queueTimer->setInterval(100);
-    connect(m_queueTimer, &QTimer::timeout, this, &communicationengine::processCommandQueue);
-    m_queueTimer->start();
+    m_timers = new TimerWheel(this);
 
-}
+    m_pacer = new PacketPacer(this);
+    connect(m_pacer, &PacketPacer::sendWindow, this, &communicationengine::onPacerWindow, Qt::DirectConnection);
+    connect(m_pacer, &PacketPacer::statsUpdated, this, &communicationengine::pacerStatsUpdated);
 
+}
 
 
-communicationengine::~communicationengine() {
-    m_queueTimer->stop();
 
-    // Очищаем все контексты и их таймеры
+bool communicationengine::setClock(EngineClock* clock) {
+    if (!m_timers->setClock(clock)) {
+        LOG_CAT_WARNING("Engine", "Часы движка не сменены: взведены таймеры (сначала отключитесь)");
+        return false;
+    }
+    LOG_CAT_INFO("Engine", m_timers->clock()->isVirtual() ? "Часы движка: виртуальное время"
+                                                          : "Часы движка: системные");
+    return true;
+}
 
+communicationengine::~communicationengine() {
+    // Очищаем все контексты; их дедлайны уходят вместе с колесом таймеров
+    m_timers->clear();
     m_contexts.clear();
 }
 
 
 // Получаем контекст для адреса
 communicationengine::PPBContext* communicationengine::getContext(uint16_t address) {
-    //QMutexLocker locker(&m_contextsMutex);
-    return &m_contexts[address];  // std::unordered_map автоматически создает элемент
+    return &m_contexts[address];  // слот создается при первом обращении
+}
+
+void communicationengine::armOperationTimer(uint16_t address, PPBContext* context, int timeoutMs) {
+    m_timers->cancel(context->operationTimer);
+    context->operationTimer = m_timers->arm(timeoutMs, [this, address]() { onOperationTimeout(address); });
+}
+
+int communicationengine::phaseTimeoutMs(uint16_t address, const PPBCommand* command,
+                                        RtoEstimator::Phase phase) const {
+    return m_rto.timeoutMs(address, command->commandId(), phase, command->timeoutMs());
+}
+
+void communicationengine::cancelTimers(PPBContext* context) {
+    m_timers->cancel(context->operationTimer);
+    m_timers->cancel(context->packetTimer);
+    context->operationTimer = 0;
+    context->packetTimer = 0;
 }
 
 // Очищаем контекст
 void communicationengine::clearContext(uint16_t address) {
      LOG_CAT_DEBUG("Engine",QString("Очистка контекста для адреса 0x%1").arg(address, 4, 16, QChar('0')));
-    //QMutexLocker locker(&m_contextsMutex);
-    auto it = m_contexts.find(address);
-    if (it != m_contexts.end()) {
-        if (it->second.operationTimer) {
-            it->second.operationTimer->stop();
-           it->second.operationTimer.reset();
-        }
-        m_contexts.erase(it);
+    PPBContext* context = m_contexts.find(address);
+    if (context) {
+        cancelTimers(context);
+        m_contexts.erase(address);
           LOG_CAT_DEBUG("Engine","Контекст удален");
     }
 }
@@ -164,15 +402,25 @@ bool communicationengine::connectToPPB(uint16_t address, const QString& ip, quin
 
     m_currentAddress = address;
     m_currentIP = ip;
+    m_currentHost = QHostAddress(ip);
     m_currentPort = port;
 
-    auto tsCommand = CommandFactory::create(TechCommand::TS);
+    auto tsCommand = CommandFactory::get(TechCommand::TS);
     if (!tsCommand) {
         emit errorOccurred("Не удалось создать команду TS");
         return false;
     }
 
-    m_commandQueue->enqueue(address, std::move(tsCommand));
+    // Как у остальных источников команд: переполнение очереди сообщается overloaded()
+    bool rejected = false;
+    if (enqueueCommand(address, tsCommand, clockNs(), priorityOf(tsCommand), 0, &rejected)) {
+        scheduleDispatch(address);
+    }
+    if (rejected) {
+        LOG_CAT_WARNING("Engine",QString("connectToPPB 0x%1: очередь команд переполнена, TS не принят")
+                        .arg(address, 4, 16, QChar('0')));
+        return false;
+    }
     return true;
 }
 
@@ -185,45 +433,236 @@ void communicationengine::disconnect() {
 
     LOG_CAT_INFO("Engine","communicationengine::disconnect");
 
-    // Сбрасываем активный диалог
-    {
-        QMutexLocker locker(&m_activeDataMutex);
-        m_activeDataAddress = 0;
-        m_waitingForData = false;
+    // Накопленные задержки - в лог, чтобы не потерять их при переподключении
+    const EngineMetrics::Snapshot metrics = m_metrics.snapshot();
+    if (metrics.hasLatency()) {
+        LOG_CAT_INFO("Engine", metrics.latencyReport());
     }
 
-    m_commandQueue->clear();
+    // Сбрасываем активные диалоги
+    m_dataDialogs.clear();
+
+    // Прерываем пакетную передачу
+    m_pacer->stop();
+    m_bulk = BulkTransfer();
+
+    // Конвейеры и очереди: ожидающие номера запросов получают отказ
+    QVector<quint64> abandoned;
+    m_pipelines.forEach([&abandoned](uint16_t, const std::deque<InFlight>& pipeline) {
+        for (const InFlight& entry : pipeline) {
+            abandoned += entry.requestIds;
+        }
+    });
+    m_timers->cancel(m_pipelineTimer);
+    m_pipelineTimer = 0;
+    m_pipelines.clear();
+
+    // И широковещательную команду - без итога, ответы после отключения не нужны
+    m_timers->cancel(m_broadcastTimer);
+    m_broadcastTimer = 0;
+    m_broadcast = Broadcast();
+
+    m_commandQueue->clear(&abandoned);
+    for (quint64 requestId : abandoned) {
+        emit requestCompleted(requestId, false, "Отключено", TechCommand::TS);
+    }
+    m_dispatchPending.clear();
+    m_blockedByDataDialog.clear();
     m_stateManager->clear();
     emit disconnected();
 }
 
 void communicationengine::executeCommand(TechCommand cmd, uint16_t address) {
+    submitCommand(cmd, address, 0);
+}
+
+void communicationengine::submitCommand(TechCommand cmd, uint16_t address, quint64 requestId) {
 
     if (QThread::currentThread() != this->thread()) {
-                QMetaObject::invokeMethod(this, "executeCommand", Qt::QueuedConnection,
+                QMetaObject::invokeMethod(this, "submitCommand", Qt::QueuedConnection,
                                                                     Q_ARG(TechCommand, cmd),
-                                                                   Q_ARG(uint16_t, address));
+                                                                   Q_ARG(uint16_t, address),
+                                                                   Q_ARG(quint64, requestId));
                 return;
             }
 
     LOG_CAT_INFO("Engine",QString("communicationengine::executeCommand: команда=%1, адрес=%2")
                  .arg(static_cast<int>(cmd)).arg(address, 4, 16, QChar('0')));
 
-    auto command = CommandFactory::create(cmd);
+    auto command = CommandFactory::get(cmd);
     if (!command) {
         emit errorOccurred(QString("Неизвестная команда: %1").arg(static_cast<int>(cmd)));
+        completeRequests({requestId}, false, "Неизвестная команда", cmd);
         return;
     }
 
+    const int64_t requestedAtNs = clockNs();
+
+    // ППБ занят или перед командой уже есть очередь - встаем в конец, порядок сохраняется.
+    // Команда уйдет сразу по переходу адреса в Ready/Idle (scheduleDispatch), без опроса
+    // Команда для конвейера тоже идет через очередь: окно и порядок проверяются в одном месте
+    // Внутри очереди команда встает в конец своего класса (CommandPriority)
+    const CommandPriority priority = priorityOf(command);
     PPBState currentState = m_stateManager->getState(address);
-    if (currentState != PPBState::Ready && currentState != PPBState::Idle) {
-        m_commandQueue->enqueue(address, std::move(command));
-       LOG_CAT_INFO("Engine",QString("Команда %1 для адреса 0x%2 поставлена в очередь")
-                            .arg(command->name())
-                            .arg(address, 4, 16, QChar('0')));
+    if (isPipelinable(address, command)) {
+        if (enqueueCommand(address, command, requestedAtNs, priority, requestId)) {
+            processNextCommandForAddress(address);
+        }
+    } else if ((currentState != PPBState::Ready && currentState != PPBState::Idle) ||
+        !m_commandQueue->isEmpty(address)) {
+        if (!enqueueCommand(address, command, requestedAtNs, priority, requestId)) {
+            return;   // слита с ожидающей или отклонена - итог уже определен
+        }
+        LOG_CAT_INFO("Engine",QString("Команда %1 для адреса 0x%2 поставлена в очередь (класс %3)")
+                              .arg(command->name())
+                              .arg(address, 4, 16, QChar('0'))
+                              .arg(static_cast<int>(priority)));
+        if (priority <= CommandPriority::Interactive) {
+            preemptBulk(address);
+        }
+        scheduleDispatch(address);
     } else {
-        executeCommandImmediately(address, std::move(command));
+        QVector<quint64> requestIds;
+        if (requestId != 0) {
+            requestIds.append(requestId);
+        }
+        executeCommandImmediately(address, command, requestedAtNs, requestIds);
+    }
+}
+
+bool communicationengine::enqueueCommand(uint16_t address, const PPBCommand* command, int64_t requestedAtNs,
+                                         CommandPriority priority, quint64 requestId, bool* rejected) {
+    using Result = Internal::CommandQueue::EnqueueResult;
+
+    Internal::CommandQueue::QueuedCommand dropped;
+    const Result result = m_commandQueue->enqueue(address, command, requestedAtNs, priority, requestId, &dropped);
+    if (rejected) {
+        *rejected = result == Result::Rejected;
+    }
+
+    switch (result) {
+    case Result::Queued:
+        return true;
+
+    case Result::Coalesced:
+        // Такой же запрос уже ждет в очереди - итог придет от него
+        LOG_CAT_DEBUG("Engine",QString("Команда %1 для адреса 0x%2 слита с ожидающей в очереди")
+                      .arg(command->name())
+                      .arg(address, 4, 16, QChar('0')));
+        return false;
+
+    case Result::CoalescedOverflow:
+        reportOverload(OverloadEvent::Kind::QueueCoalesced, address, command->commandId());
+        return false;
+
+    case Result::DroppedOldest:
+        reportOverload(OverloadEvent::Kind::QueueDropped, address, dropped.command->commandId());
+        completeRequests(dropped.requestIds, false, "Вытеснена из переполненной очереди",
+                         dropped.command->commandId());
+        return true;
+
+    case Result::Rejected:
+        reportOverload(OverloadEvent::Kind::QueueRejected, address, command->commandId());
+        completeRequests({requestId}, false, "Очередь команд переполнена", command->commandId());
+        return false;
+    }
+    return false;
+}
+
+void communicationengine::reportOverload(OverloadEvent::Kind kind, uint16_t address, TechCommand command) {
+    OverloadEvent event;
+    event.kind = kind;
+    event.address = address;
+    event.command = command;
+    event.queueDepth = m_commandQueue->size(address);
+    event.total = ++m_overloadEvents;
+
+    static const char* const kindNames[] = {
+        "команда отклонена", "вытеснена ожидавшая команда", "команда слита с ожидающей",
+        "переполнен буфер диалога"
+    };
+    LOG_CAT_WARNING("Engine",QString("Перегрузка 0x%1: %2 %3 (в очереди %4, всего событий %5)")
+                    .arg(address, 4, 16, QChar('0'))
+                    .arg(kindNames[static_cast<int>(kind)])
+                    .arg(CommandFactory::commandName(command))
+                    .arg(event.queueDepth)
+                    .arg(event.total));
+
+    emit overloaded(event);
+}
+
+void communicationengine::completeRequests(const QVector<quint64>& requestIds, bool success,
+                                           const QString& report, TechCommand command) {
+    for (quint64 requestId : requestIds) {
+        if (requestId != 0) {
+            emit requestCompleted(requestId, success, report, command);
+        }
+    }
+}
+
+void communicationengine::executeBroadcast(TechCommand cmd, uint16_t mask) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "executeBroadcast", Qt::QueuedConnection,
+                                                                    Q_ARG(TechCommand, cmd),
+                                                                    Q_ARG(uint16_t, mask));
+                return;
+            }
+
+    LOG_CAT_INFO("Engine",QString("communicationengine::executeBroadcast: команда=%1, маска=0x%2")
+                 .arg(static_cast<int>(cmd)).arg(mask, 4, 16, QChar('0')));
+
+    if (mask == 0) {
+        emit errorOccurred("Широковещательная команда: пустая маска ППБ");
+        return;
+    }
+
+    if (m_broadcast.active) {
+        emit errorOccurred("Широковещательная команда уже выполняется");
+        return;
+    }
+
+    // Пакетная передача в ППБ адресуется одному блоку - широковещательно не выполняется
+    const CommandDescriptor* descriptor = CommandFactory::descriptor(cmd);
+    if (descriptor && descriptor->direction == DataDirection::ToPPB) {
+        emit errorOccurred(QString("Команда %1 не выполняется широковещательно").arg(static_cast<int>(cmd)));
+        return;
+    }
+
+    auto command = CommandFactory::get(cmd);
+    if (!command) {
+        emit errorOccurred(QString("Неизвестная команда: %1").arg(static_cast<int>(cmd)));
+        return;
+    }
+
+    // Пакеты данных без адреса: пока идет другой диалог через бридж, их не разделить
+    if (command->expectedResponsePackets() > 0) {
+        if (findDataDialog(endpointKey(m_currentHost, m_currentPort))) {
+            emit errorOccurred("Широковещательная команда: идет диалог с данными, повторите позже");
+            return;
+        }
+    }
+
+    m_broadcast = Broadcast();
+    m_broadcast.active = true;
+    m_broadcast.mask = mask;
+    m_broadcast.pending = mask;
+    for (int bit = 0; bit < 16; ++bit) {
+        if (mask & (1u << bit)) {
+            m_broadcast.units[static_cast<uint16_t>(1u << bit)] = BroadcastUnit();
+        }
     }
+    m_broadcast.command = command;
+    m_broadcast.startedAtNs = clockNs();
+
+    sendPacketInternal(m_broadcast.command->buildRequest(mask),
+                       QString("%1 (маска 0x%2)").arg(m_broadcast.command->name())
+                                                 .arg(mask, 4, 16, QChar('0')));
+    m_timers->cancel(m_broadcastTimer);
+    m_broadcastTimer = m_timers->arm(m_broadcast.command->timeoutMs(), [this]() {
+        m_broadcastTimer = 0;
+        finishBroadcast("таймаут");
+    });
 }
 
 void communicationengine::sendFUTransmit(uint16_t address) {
@@ -287,6 +726,20 @@ void communicationengine::setCommandParseResult(uint16_t address, bool success,
                 return;
             }
 
+    // Разбор ответа одного ППБ широковещательной команды
+    if (m_broadcastCallbackUnit) {
+        m_broadcastCallbackUnit->parsedSet = true;
+        m_broadcastCallbackUnit->parsedSuccess = success;
+        m_broadcastCallbackUnit->message = message;
+        return;
+    }
+
+    // Из колбэка команды результат относится к ее адресу: CommandInterface знает только
+    // адрес подключения, а диалогов может идти несколько
+    if (m_callbackAddress != 0) {
+        address = m_callbackAddress;
+    }
+
     PPBContext* context = getContext(address);
     if (!context) {
         LOG_CAT_WARNING("Engine",QString("setCommandParseResult: нет контекста для адреса 0x%1")
@@ -312,6 +765,15 @@ void communicationengine::setCommandParseData(uint16_t address, const QVariant&
                 return;
             }
 
+    if (m_broadcastCallbackUnit) {
+        m_broadcastCallbackUnit->parsedData = data;
+        return;
+    }
+
+    if (m_callbackAddress != 0) {
+        address = m_callbackAddress;
+    }
+
     PPBContext* context = getContext(address);
     if (!context) {
         LOG_CAT_WARNING("Engine",QString("setCommandParseData: нет контекста для адреса 0x%1")
@@ -328,17 +790,27 @@ void communicationengine::setCommandParseData(uint16_t address, const QVariant&
 
 // ===== ПРИВАТНЫЕ МЕТОДЫ =====
 
-void communicationengine::executeCommandImmediately(uint16_t address, std::unique_ptr<PPBCommand> command) {
+void communicationengine::executeCommandImmediately(uint16_t address, const PPBCommand* command,
+                                                    int64_t requestedAtNs,
+                                                    const QVector<quint64>& requestIds) {
     if (!command) return;
 
-    if (!canExecuteCommand(address, command.get())) {
+    if (!canExecuteCommand(address, command)) {
+        const DataDialog* dialog = findDataDialog(bridgeKey(address));
         LOG_CAT_WARNING("Engine",QString("Не могу выполнить команду %1 для 0x%2: активен диалог с данными для 0x%3")
                         .arg(command->name())
                         .arg(address, 4, 16, QChar('0'))
-                        .arg(m_activeDataAddress, 4, 16, QChar('0')));
-
-        // Возвращаем команду в очередь
-        m_commandQueue->enqueue(address, std::move(command));
+                        .arg(dialog ? dialog->address : 0, 4, 16, QChar('0')));
+
+        // Возвращаем команду в очередь - уйдет, когда диалог с данными закончится.
+        // Через enqueueCommand: переполнение очереди сообщается, а отклоненные запросы завершаются
+        // отказом. Слитые запросы идемпотентны - второй и следующие присоединятся к первому
+        enqueueCommand(address, command, requestedAtNs, priorityOf(command),
+                       requestIds.isEmpty() ? 0 : requestIds.first());
+        for (int i = 1; i < requestIds.size(); ++i) {
+            enqueueCommand(address, command, requestedAtNs, priorityOf(command), requestIds[i]);
+        }
+        m_blockedByDataDialog.insert(address);
         return;
     }
 
@@ -350,94 +822,161 @@ void communicationengine::executeCommandImmediately(uint16_t address, std::uniqu
                         .arg(command->name())
                         .arg(address, 4, 16, QChar('0'))
                         .arg(stateToString(currentState)));
+        completeRequests(requestIds, false,
+                         QString("ППБ занят: %1").arg(stateToString(currentState)), command->commandId());
         return;
     }
 
     // Создаём/очищаем контекст
     PPBContext* context = getContext(address);
+    cancelTimers(context);
     *context = PPBContext(); // Полная очистка
 
     context->stateBeforeCommand = currentState;
     // Настраиваем контекст
-    context->currentCommand = std::move(command);
+    context->currentCommand = command;
     context->waitingForOk = true;
+    context->awaitingBulk = false;
+    context->sentAtNs = 0;
+    context->okAtNs = 0;
+    context->lastDataAtNs = 0;
+    context->hostDrops = 0;
+    context->requestedAtNs = requestedAtNs ? requestedAtNs : clockNs();
     context->operationCompleted = false;
     context->packetsExpected = 0;
     context->packetsReceived = 0;
-    context->receivedData.clear();
+    context->receivedData.reset();
+    context->requestIds = requestIds;
 
-    // Переходим в состояние отправки команды
-    transitionState(address, PPBState::SendingCommand,
-                    QString("Начинаем %1").arg(context->currentCommand->name()));
+    // Переходим в состояние отправки команды (какой - в журнале ниже)
+    transitionState(address, PPBState::SendingCommand, "Начало команды");
+
+    // Команда с данными занимает конечную точку уже сейчас: OK других ППБ того же бриджа
+    // может прийти раньше нашего, и их пакеты данных смешались бы с нашими
+    if (command->expectedResponsePackets() > 0) {
+        reserveDataDialog(address);
+    }
 
     // Отправляем запрос
-    QByteArray request = context->currentCommand->buildRequest(address);
-    sendPacketInternal(request, context->currentCommand->name());
+    sendToAddress(address, context->currentCommand->buildRequestRecord(address),
+                  commandLabel(context->currentCommand));
+    context->sentAtNs = m_lastSendNs;
+    m_metrics.count(address, context->currentCommand->commandId(), EngineMetrics::Counter::Sent);
+    m_metrics.record(address, context->currentCommand->commandId(), EngineMetrics::Stage::QueueWait,
+                     context->sentAtNs - context->requestedAtNs);
 
-    // Настраиваем таймер
-    context->operationTimer = std::make_unique<QTimer>();
-    context->operationTimer->setSingleShot(true);
-    connect(context->operationTimer.get(), &QTimer::timeout,
-            this, [this, address]() { onOperationTimeout(address); });
-    context->operationTimer->start(context->currentCommand->timeoutMs());
+    // Таймаут ожидания OK - по оценке времени ответа этого ППБ
+    const int timeoutMs = phaseTimeoutMs(address, context->currentCommand, RtoEstimator::Phase::Ok);
+    armOperationTimer(address, context, timeoutMs);
 
     LOG_CAT_INFO("Engine",QString("Выполняется %1 для 0x%2 (таймаут: %3 мс)")
                  .arg(context->currentCommand->name())
                  .arg(address, 4, 16, QChar('0'))
-                 .arg(context->currentCommand->timeoutMs()));
+                 .arg(timeoutMs));
 }
 
-void communicationengine::processCommandQueue() {
-    auto addresses = m_commandQueue->addresses();
+void communicationengine::scheduleDispatch(uint16_t address) {
+    m_dispatchPending.insert(address);
 
-    for (uint16_t address : addresses) {
-        PPBState state = m_stateManager->getState(address);
+    // Переход из разбора принятых датаграмм: очереди проверит finishReceive, без отложенного вызова
+    if (m_receiveDepth > 0) {
+        return;
+    }
 
-        if ((state == PPBState::Ready || state == PPBState::Idle) &&
-            !m_commandQueue->isEmpty(address)) {
-            auto command = m_commandQueue->dequeue(address);
-            if (command) {
-                executeCommandImmediately(address, std::move(command));
-            }
-        }
+    // Один отложенный вызов на все события текущей итерации цикла: переходы состояния
+    // происходят внутри completeOperation, отправлять из него же нельзя (реентерабельность)
+    if (!m_dispatchScheduled) {
+        m_dispatchScheduled = true;
+        QMetaObject::invokeMethod(this, "dispatchPending", Qt::QueuedConnection);
     }
 }
 
+void communicationengine::dispatchPending() {
+    m_dispatchScheduled = false;
+
+    m_dispatchPending.take().forEach([this](uint16_t address) { processNextCommandForAddress(address); });
+}
+
 void communicationengine::onDataReceived(const QByteArray& data, const QHostAddress& sender, quint16 port) {
     LOG_CAT_DEBUG("Engine",QString("communicationengine::onDataReceived: размер=%1, от=%2:%3")
                   .arg(data.size())
                   .arg(sender.toString())
                   .arg(port));
 
-    QString hexData = data.toHex(' ').toUpper();
-    LOG_CAT_DEBUG("Engine",QString("Данные: %1").arg(hexData));
+    LOG_CAT_DEBUG("Engine",QString("Данные: %1").arg(QString::fromLatin1(data.toHex(' ').toUpper())));
 
-    // Проверяем, находимся ли мы в состоянии ожидания данных
-    bool waitingForData = false;
-    uint16_t activeAddress = 0;
-    {
-        QMutexLocker locker(&m_activeDataMutex);
-        waitingForData = m_waitingForData;
-        activeAddress = m_activeDataAddress;
+    ++m_receiveDepth;
+    processDatagram(reinterpret_cast<const uint8_t*>(data.constData()), data.size(), clockNs(),
+                    endpointKey(sender, port));
+    finishReceive();
+}
+
+void communicationengine::onDatagramsReceived(const RxBatch& batch) {
+    LOG_CAT_DEBUG("Engine",QString("communicationengine::onDatagramsReceived: %1 датаграмм").arg(batch.count));
+
+    ++m_receiveDepth;
+    for (const RxDatagram& record : batch) {
+        processDatagram(record.data, record.size,
+                        m_timers->clock()->isVirtual() ? clockNs() : record.rxTimestampNs,
+                        endpointKey(record.senderIPv4, record.senderPort));
+    }
+    finishReceive();
+}
+
+void communicationengine::finishReceive() {
+    // Разбор закончен, в стеке нет completeOperation - освободившиеся адреса отправляют сразу
+    if (--m_receiveDepth == 0 && !m_dispatchPending.isEmpty()) {
+        dispatchPending();
+    }
+}
+
+void communicationengine::processDatagram(const uint8_t* data, int size, int64_t rxTimestampNs,
+                                          quint64 senderKey) {
+    m_rxTimestampNs = rxTimestampNs;
+
+    // Данные широковещательной команды: от отправителя нет своего диалога, а ППБ ждут данных
+    if (m_broadcast.active && !m_broadcast.dataOrder.empty() &&
+        size == static_cast<int>(sizeof(DataPacket))) {
+        const bool ownDialog = findDataDialog(senderKey) != nullptr;
+        DataPacket packet;
+        if (!ownDialog && PacketBuilder::parseDataPacket(data, size, packet) &&
+            processBroadcastData(packet)) {
+            return;
+        }
+    }
+
+    // Проверяем, ждем ли данные от этого отправителя
+    const uint16_t dialogAddress = dataDialogAddress(senderKey);
+    bool waitingForData = dialogAddress != 0;
+
+    // OK и пакет данных одного размера и с той же CRC: по форме их не различить.
+    // Пока идет диалог, через тот же бридж могут ждать OK другие ППБ (команды без данных,
+    // конвейер) - датаграмма с адресом такого ППБ считается его ответом, а не пакетом диалога
+    if (waitingForData && size == static_cast<int>(sizeof(PPBResponse))) {
+        PPBResponse response;
+        if (PacketBuilder::parsePPBResponse(data, size, response) &&
+            response.address != dialogAddress && isAwaitingOk(response.address)) {
+            waitingForData = false;
+        }
     }
 
     // Определяем тип пакета по размеру и состоянию
-    if (waitingForData && data.size() == sizeof(DataPacket)) {
+    if (waitingForData && size == static_cast<int>(sizeof(DataPacket))) {
         // В состоянии ожидания данных пробуем сначала разобрать как DataPacket
         DataPacket packet;
-        if (PacketBuilder::parseDataPacket(data, packet)) {
+        if (PacketBuilder::parseDataPacket(data, size, packet)) {
             LOG_CAT_DEBUG("Engine",QString("Пакет данных в состоянии ожидания: counter=%1")
                           .arg(packet.counter));
-            processDataPacket(packet);
+            processDataPacket(packet, senderKey);
             return;
         }
     }
 
     // Обычная логика определения типа пакета
-    if (data.size() == sizeof(PPBResponse)) {
+    if (size == static_cast<int>(sizeof(PPBResponse))) {
         // Это ответ от ППБ
         PPBResponse response;
-        if (PacketBuilder::parsePPBResponse(data, response)) {
+        if (PacketBuilder::parsePPBResponse(data, size, response)) {
             LOG_CAT_DEBUG("Engine",QString("Ответ ППБ: адрес=0x%1, статус=0x%2")
                           .arg(response.address, 4, 16, QChar('0'))
                           .arg(response.status, 2, 16, QChar('0')));
@@ -446,10 +985,10 @@ void communicationengine::onDataReceived(const QByteArray& data, const QHostAddr
         } else {
             LOG_CAT_WARNING("Engine","Не удалось распарсить ответ ППБ");
         }
-    } else if (data.size() == sizeof(BridgeResponse)) {
+    } else if (size == static_cast<int>(sizeof(BridgeResponse))) {
         // Это ответ от бриджа
         BridgeResponse response;
-        if (PacketBuilder::parseBridgeResponse(data, response)) {
+        if (PacketBuilder::parseBridgeResponse(data, size, response)) {
             LOG_CAT_DEBUG("Engine",QString("Ответ бриджа: адрес=0x%1, статус=%2")
                           .arg(response.address)
                           .arg(response.status));
@@ -458,10 +997,10 @@ void communicationengine::onDataReceived(const QByteArray& data, const QHostAddr
         } else {
             LOG_CAT_WARNING("Engine","Не удалось распарсить ответ бриджа");
         }
-    } else if (data.size() == sizeof(DataPacket)) {
+    } else if (size == static_cast<int>(sizeof(DataPacket))) {
         // Это пакет данных (но не в состоянии ожидания)
         DataPacket packet;
-        if (PacketBuilder::parseDataPacket(data, packet)) {
+        if (PacketBuilder::parseDataPacket(data, size, packet)) {
             LOG_CAT_DEBUG("Engine",QString("Пакет данных вне состояния ожидания: counter=%1")
                           .arg(packet.counter));
             // Если не в состоянии ожидания, игнорируем (или обрабатываем иначе)
@@ -470,54 +1009,143 @@ void communicationengine::onDataReceived(const QByteArray& data, const QHostAddr
             LOG_CAT_WARNING("Engine","Не удалось распарсить пакет данных");
         }
     } else {
-        LOG_CAT_WARNING("Engine",QString("Неизвестный размер пакета: %1 байт").arg(data.size()));
+        LOG_CAT_WARNING("Engine",QString("Неизвестный размер пакета: %1 байт").arg(size));
+    }
+}
+
+bool communicationengine::isAwaitingOk(uint16_t address) const {
+    const std::deque<InFlight>* pipeline = m_pipelines.find(address);
+    if (pipeline && !pipeline->empty()) {
+        return true;
     }
+    const PPBContext* context = m_contexts.find(address);
+    return context && context->currentCommand && context->waitingForOk && !context->operationCompleted;
 }
 
 void communicationengine::onNetworkError(const QString& error) {
     emit errorOccurred(error);
 }
 
+void communicationengine::onReceiveOverflow(quint64 newDrops, quint64 totalDrops) {
+    QList<uint16_t> activeAddresses;
+    for (const DataDialog& dialog : m_dataDialogs) {
+        if (dialog.receiving) {
+            activeAddresses.append(dialog.address);
+        }
+    }
+
+    if (activeAddresses.isEmpty()) {
+        LOG_CAT_WARNING("Engine",QString("Потеряно на хосте %1 датаграмм (всего %2) вне диалога с данными")
+                        .arg(newDrops).arg(totalDrops));
+        return;
+    }
+
+    // Потери во время приема данных: учитываем в диалогах, чтобы таймаут не списал их на ППБ.
+    // Это предположение: ядро сообщает только число отброшенных датаграмм, но не чьи они
+    // (могли быть и чужие, и ответы вне диалога). Поэтому отмечаются все идущие диалоги,
+    // а в сообщениях таймаута потери на хосте - причина вероятная, а не доказанная
+    for (uint16_t address : activeAddresses) {
+        PPBContext* context = getContext(address);
+        if (context && !context->operationCompleted) {
+            context->hostDrops += newDrops;
+        }
+    }
+    const uint16_t activeAddress = activeAddresses.first();
+
+    const int current = m_udpClient->receiveBufferSize();
+    if (current >= MAX_RX_BUFFER_BYTES) {
+        LOG_CAT_WARNING("Engine",QString("Потеряно на хосте %1 датаграмм от 0x%2, буфер приема уже максимальный (%3 байт)")
+                        .arg(newDrops)
+                        .arg(activeAddress, 4, 16, QChar('0'))
+                        .arg(current));
+        return;
+    }
+
+    // Буфер растет при потерях во время любого диалога с данными (TS, PRBS_S2M и др.):
+    // по той же причине нельзя сказать, поток какого диалога переполнил сокет
+    const int target = qMin(MAX_RX_BUFFER_BYTES, qMax(current * 2, MIN_RX_BUFFER_GROW_BYTES));
+    m_udpClient->setReceiveBufferSize(target);
+
+    LOG_CAT_WARNING("Engine",QString("Потеряно на хосте %1 датаграмм от 0x%2: буфер приема %3 -> %4 байт")
+                    .arg(newDrops)
+                    .arg(activeAddress, 4, 16, QChar('0'))
+                    .arg(current)
+                    .arg(m_udpClient->receiveBufferSize()));
+}
+
 void communicationengine::onOperationTimeout(uint16_t address) {
     PPBContext* context = getContext(address);
     if (!context || !context->currentCommand) {
         // Нет контекста → просто переходим в Ready
         transitionState(address, PPBState::Ready, "Таймаут без активной команды");
 
-        {
-            QMutexLocker locker(&m_activeDataMutex);
-            if (address == m_activeDataAddress) {
-                m_activeDataAddress = 0;
-                m_waitingForData = false;
-            }
-        }
+        endDataDialog(address);
+
+        return;
+    }
 
+    // Пакетная передача еще идет - таймаут операции отсчитываем заново
+    if (m_bulk.active && !m_bulk.paused && m_bulk.address == address) {
+        LOG_CAT_DEBUG("Engine",QString("Таймаут для 0x%1 отложен: идет пакетная передача (%2/%3)")
+                      .arg(address, 4, 16, QChar('0'))
+                      .arg(m_bulk.next).arg(m_bulk.packets.size()));
+        armOperationTimer(address, context,
+                          phaseTimeoutMs(address, context->currentCommand,
+                                         context->waitingForOk ? RtoEstimator::Phase::Ok
+                                                               : RtoEstimator::Phase::Data));
         return;
     }
 
+    m_rto.timedOut(address, context->currentCommand->commandId(),
+                   context->waitingForOk ? RtoEstimator::Phase::Ok : RtoEstimator::Phase::Data);
+
     LOG_CAT_WARNING("Engine",QString("Таймаут для %1 (0x%2)")
                                   .arg(context->currentCommand->name())
                                   .arg(address, 4, 16, QChar('0')));
 
-    {
-        QMutexLocker locker(&m_activeDataMutex);
-        if (address == m_activeDataAddress) {
-            m_activeDataAddress = 0;
-            m_waitingForData = false;
+    // Пачка оборвалась с пропусками - дозапрашиваем их вместо завершения.
+    // Пропущенный хвост последнего повтора мог досчитать все пакеты - тогда это успех
+    if (context->gapRepair) {
+        if (context->packetsReceived >= context->packetsExpected) {
+            endDataDialog(address);
+            completeOperation(address, true,
+                              QString("Получены все %1 пакетов (повторов запроса: %2)")
+                                  .arg(context->packetsExpected).arg(context->repairAttempts), true);
+            return;
+        }
+        if (tryGapRepair(address, context)) {
+            return;
         }
     }
 
+    endDataDialog(address);
+
+    // Где потеряны пакеты: ядро хоста само считает, что отбросило (SO_RXQ_OVFL),
+    // все остальное - потери в линии или на стороне ППБ
+    QString lossReason;
+    if (context->hostDrops > 0) {
+        lossReason = QString(" (отброшено на хосте: %1, переполнен буфер приема)").arg(context->hostDrops);
+    } else if (context->packetsExpected > 0) {
+        lossReason = " (на хосте потерь нет - потеря в линии или ППБ)";
+    }
+
     // Проверяем, получили ли мы часть данных
     if (context->packetsReceived > 0) {
         // Были получены частичные данные
-        QString partialMessage = QString("Таймаут операции. Получено %1 из %2 пакетов")
+        QString partialMessage = QString("Таймаут операции. Получено %1 из %2 пакетов%3")
                                      .arg(context->packetsReceived)
-                                     .arg(context->packetsExpected);
+                                     .arg(context->packetsExpected)
+                                     .arg(lossReason);
+        if (context->gapRepair) {
+            partialMessage += QString(", повторов запроса: %1, не получены: %2")
+                                  .arg(context->repairAttempts)
+                                  .arg(context->receivedData.missingRanges());
+        }
 
-        completeOperation(address, true, partialMessage);
+        completeOperation(address, true, partialMessage, true);
     } else {
         // Данных не было совсем
-        completeOperation(address, false, "Таймаут операции");
+        completeOperation(address, false, "Таймаут операции" + lossReason, true);
     }
 }
 
@@ -535,16 +1163,21 @@ void communicationengine::sendPacketInternal(const QByteArray& packet, const QSt
         return;
     }
 
-    if (m_currentIP.isEmpty() || m_currentIP == "255.255.255.255") {
+    if (m_currentHost.isNull() || m_currentHost == QHostAddress::Broadcast) {
         m_udpClient->sendBroadcast(packet, m_currentPort);
     } else {
-        m_udpClient->sendTo(packet, m_currentIP, m_currentPort);
+        m_udpClient->sendTo(packet, m_currentHost, m_currentPort);
     }
+    m_lastSendNs = clockNs();
 
     LOG_CAT_INFO("Engine",QString("Отправлен пакет: %1").arg(description));
 }
 
 void communicationengine::processPPBResponse(const PPBResponse& response) {
+    if (processBroadcastResponse(response) || processPipelineResponse(response)) {
+        return;
+    }
+
     uint16_t address = response.address;
     PPBContext* context = getContext(address);
 
@@ -564,8 +1197,14 @@ void communicationengine::processPPBResponse(const PPBResponse& response) {
                                    .arg(address, 4, 16, QChar('0'))
                                    .arg(context->currentCommand->name()));
 
-        // Вызываем логику команды для обработки OK
-        context->currentCommand->onOkReceived(m_commandInterface, address);
+        context->okAtNs = m_rxTimestampNs;
+
+        // Вызываем логику команды для обработки OK (без интерфейса команд - прогоны движка без GUI)
+        if (m_commandInterface) {
+            m_callbackAddress = address;
+            context->currentCommand->onOkReceived(m_commandInterface, address);
+            m_callbackAddress = 0;
+        }
 
         // +++ ОБРАБОТКА TS ОТДЕЛЬНО +++
         if (context->currentCommand->commandId() == TechCommand::TS) {
@@ -573,11 +1212,7 @@ void communicationengine::processPPBResponse(const PPBResponse& response) {
             bool wasIdle = (context->stateBeforeCommand == PPBState::Idle);
 
             // Устанавливаем активный диалог для приема данных статуса
-            {
-                QMutexLocker locker(&m_activeDataMutex);
-                m_activeDataAddress = address;
-                m_waitingForData = true;
-            }
+            beginDataDialog(address);
 
             LOG_CAT_INFO("Engine",QString("TS: ожидание %1 пакетов статуса для адреса 0x%2")
                                        .arg(context->currentCommand->expectedResponsePackets())
@@ -587,25 +1222,21 @@ void communicationengine::processPPBResponse(const PPBResponse& response) {
             context->waitingForOk = false;
             context->packetsExpected = context->currentCommand->expectedResponsePackets();
             context->packetsReceived = 0;
-            context->receivedData.clear();
+            context->receivedData.reset(context->packetsExpected);
+            context->stream.reset(nullptr, context->packetsExpected);
 
             // Переходим в состояние ожидания данных
             transitionState(address, PPBState::WaitingData,
                             wasIdle ? "Подключение: ожидание статуса" : "Опрос состояния: ожидание данных");
 
             // Перезапускаем таймер для ожидания данных статуса
-            if (context->operationTimer) {
-                context->operationTimer->start(context->currentCommand->timeoutMs());
-            }
+            armOperationTimer(address, context,
+                              phaseTimeoutMs(address, context->currentCommand, RtoEstimator::Phase::Data));
         }
         // +++ ОБРАБОТКА ДРУГИХ КОМАНД С ДАННЫМИ +++
         else if (context->currentCommand->expectedResponsePackets() > 0) {
             // Команда ожидает данные - устанавливаем глобальный активный диалог
-            {
-                QMutexLocker locker(&m_activeDataMutex);
-                m_activeDataAddress = address;
-                m_waitingForData = true;
-            }
+            beginDataDialog(address);
 
             LOG_CAT_INFO("Engine",QString("Установлен активный диалог с данными для адреса 0x%1")
                                        .arg(address, 4, 16, QChar('0')));
@@ -613,19 +1244,34 @@ void communicationengine::processPPBResponse(const PPBResponse& response) {
             // Команда ожидает данные
             context->waitingForOk = false;
             context->packetsExpected = context->currentCommand->expectedResponsePackets();
-            context->packetsReceived = 0;
-            context->receivedData.clear();
+
+            // OK на повторный запрос: принятое раньше сохраняем, ждем только пропуски
+            if (context->repairAttempts == 0) {
+                const CommandDescriptor* descriptor = CommandFactory::descriptor(context->currentCommand->commandId());
+                context->gapRepair = m_gapRepair && descriptor && descriptor->repairable;
+                context->packetsReceived = 0;
+                context->receivedData.reset(context->packetsExpected);
+                context->stream.reset(context->currentCommand->referencePackets(), context->packetsExpected);
+                // С дозапросом пропуски в первой пачке ожидаемы - пороги не применяются
+                context->stream.setLimits(context->gapRepair ? StreamingAnalyzer::Limits() : m_streamLimits);
+            }
 
             // Переходим в состояние ожидания данных
-            transitionState(address, PPBState::WaitingData,
-                            QString("Ожидание %1 пакетов").arg(context->packetsExpected));
+            transitionState(address, PPBState::WaitingData, "Ожидание пакетов данных");
 
             // Перезапускаем таймер на время ожидания данных
-            if (context->operationTimer) {
-                context->operationTimer->start(context->currentCommand->timeoutMs());
-            }
+            armOperationTimer(address, context,
+                              phaseTimeoutMs(address, context->currentCommand, RtoEstimator::Phase::Data));
         }
         // +++ КОМАНДЫ БЕЗ ДАННЫХ +++
+        else if (m_bulk.active && !m_bulk.paused && m_bulk.address == address) {
+            // Команда начала пакетную передачу - завершим ее по окончании передачи
+            context->awaitingBulk = true;
+            context->waitingForOk = false;
+            LOG_CAT_INFO("Engine",QString("0x%1: ожидание окончания передачи %2 пакетов")
+                                       .arg(address, 4, 16, QChar('0'))
+                                       .arg(m_bulk.packets.size()));
+        }
         else {
             completeOperation(address, true, "Команда выполнена");
         }
@@ -635,13 +1281,7 @@ void communicationengine::processPPBResponse(const PPBResponse& response) {
                                     .arg(response.status, 2, 16, QChar('0')));
 
         // Если это был активный диалог - сбрасываем
-        {
-            QMutexLocker locker(&m_activeDataMutex);
-            if (address == m_activeDataAddress) {
-                m_activeDataAddress = 0;
-                m_waitingForData = false;
-            }
-        }
+        endDataDialog(address);
 
         // Завершаем с ошибкой
         completeOperation(address, false,
@@ -667,24 +1307,19 @@ void communicationengine::processBridgeResponse(const BridgeResponse& response)
     // ФУ команды не меняют состояние
 }
 
-void communicationengine::processDataPacket(const DataPacket& packet) {
-    QByteArray packetData(reinterpret_cast<const char*>(&packet), sizeof(DataPacket));
-
-    QMutexLocker dataLocker(&m_activeDataMutex);
+void communicationengine::processDataPacket(const DataPacket& packet, quint64 senderKey) {
+    // Адреса в пакете нет - ППБ определяем по конечной точке отправителя
+    const uint16_t activeAddress = dataDialogAddress(senderKey);
 
     // Если нет активного диалога с данными - игнорируем пакет
-    if (!m_waitingForData || m_activeDataAddress == 0) {
+    if (activeAddress == 0) {
         LOG_CAT_DEBUG("Engine","Получен пакет данных, но нет активного диалога, игнорируем");
         return;
     }
 
-    uint16_t activeAddress = m_activeDataAddress;
-    dataLocker.unlock(); // Разблокируем мьютекс
-
     // Проверяем, что контекст все еще существует
     {
-        //QMutexLocker locker(&m_contextsMutex);
-        if (m_contexts.find(activeAddress) == m_contexts.end()) {
+        if (!m_contexts.contains(activeAddress)) {
             LOG_CAT_WARNING("Engine",QString("Контекст для адреса 0x%1 уже удален, игнорируем пакет")
                             .arg(activeAddress, 4, 16, QChar('0')));
             return;
@@ -713,27 +1348,689 @@ void communicationengine::processDataPacket(const DataPacket& packet) {
         return;
     }
 
-    // Сохраняем пакет
-    context->receivedData.append(packetData);
-    context->packetsReceived++;
+    // Диалог ограничен: ППБ, шлющий повторы без конца, не должен держать его вечно -
+    // в том числе во время дозапроса пропусков
+    if (context->receivedData.arrivals() >= m_dialogPacketLimit) {
+        reportOverload(OverloadEvent::Kind::DialogBufferFull, activeAddress, context->currentCommand->commandId());
+        endDataDialog(activeAddress);
+        completeOperation(activeAddress, false,
+                          QString("Переполнен буфер диалога: %1 пакетов").arg(m_dialogPacketLimit));
+        return;
+    }
 
-    LOG_CAT_DEBUG("Engine",QString("Пакет %1/%2 для активного адреса 0x%3")
-                  .arg(context->packetsReceived)
-                  .arg(context->packetsExpected)
+    if (context->gapRepair) {
+        processCountedPacket(activeAddress, context, packet);
+        return;
+    }
+
+    // Пакет ложится на позицию своего счетчика
+    switch (context->receivedData.place(packet)) {
+    case DialogBuffer::Placement::Stored:
+        break;
+    case DialogBuffer::Placement::Duplicate:
+        LOG_CAT_DEBUG("Engine",QString("Повтор пакета #%1 для 0x%2, отброшен")
+                      .arg(packet.counter)
+                      .arg(activeAddress, 4, 16, QChar('0')));
+        return;
+    case DialogBuffer::Placement::OutOfRange:
+        LOG_CAT_WARNING("Engine",QString("Пакет #%1 для 0x%2 вне ответа из %3 пакетов, отброшен")
+                        .arg(packet.counter)
+                        .arg(activeAddress, 4, 16, QChar('0'))
+                        .arg(context->packetsExpected));
+        return;
+    }
+    context->packetsReceived = context->receivedData.received();
+    context->lastDataAtNs = m_rxTimestampNs;
+    if (!streamPacket(activeAddress, context, packet)) {
+        return;
+    }
+
+    LOG_CAT_DEBUG("Engine",QString("Пакет %1/%2 для активного адреса 0x%3")
+                  .arg(context->packetsReceived)
+                  .arg(context->packetsExpected)
                   .arg(activeAddress, 4, 16, QChar('0')));
 
     // Если получили все пакеты
     if (context->packetsReceived >= context->packetsExpected) {
         // Сбрасываем активный диалог
-        {
-            QMutexLocker locker(&m_activeDataMutex);
-            m_activeDataAddress = 0;
-            m_waitingForData = false;
+        endDataDialog(activeAddress);
+
+        completeOperation(activeAddress, true, allPacketsMessage(context->packetsExpected));
+        return;
+    }
+
+    // Поток пакетов начался: пауза больше PACKET_TIMEOUT_MS - обрыв, не ждем весь таймаут операции
+    m_timers->cancel(context->packetTimer);
+    context->packetTimer = m_timers->arm(PPBConstants::PACKET_TIMEOUT_MS,
+                                         [this, activeAddress]() { onPacketTimeout(activeAddress); });
+}
+
+const QString& communicationengine::allPacketsMessage(int packets) {
+    auto it = m_allPacketsMessages.find(packets);
+    if (it == m_allPacketsMessages.end()) {
+        it = m_allPacketsMessages.insert(packets, QString("Получены все %1 пакетов").arg(packets));
+    }
+    return it.value();
+}
+
+void communicationengine::onPacketTimeout(uint16_t address) {
+    PPBContext* context = m_contexts.find(address);
+    if (!context || !context->currentCommand || context->operationCompleted) {
+        return;
+    }
+    context->packetTimer = 0;
+
+    LOG_CAT_WARNING("Engine",QString("0x%1: нет пакетов данных %2 мс (получено %3 из %4)")
+                    .arg(address, 4, 16, QChar('0'))
+                    .arg(PPBConstants::PACKET_TIMEOUT_MS)
+                    .arg(context->packetsReceived)
+                    .arg(context->packetsExpected));
+    onOperationTimeout(address);
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ ДОЗАПРОС ПРОПУСКОВ +++++++++++++++++++++++++++++++++++++
+void communicationengine::setGapRepair(bool enabled, int maxAttempts) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setGapRepair", Qt::QueuedConnection,
+                                                                     Q_ARG(bool, enabled),
+                                                                     Q_ARG(int, maxAttempts));
+                return;
+            }
+
+    m_gapRepair = enabled;
+    m_gapRepairMaxAttempts = qMax(0, maxAttempts);
+
+    LOG_CAT_INFO("Engine",QString("Дозапрос пропущенных пакетов: %1, повторов не больше %2")
+                 .arg(enabled ? "включен" : "выключен")
+                 .arg(m_gapRepairMaxAttempts));
+}
+
+void communicationengine::processCountedPacket(uint16_t address, PPBContext* context,
+                                               const DataPacket& packet) {
+    // Повтор запроса присылает всю последовательность: уже принятые счетчики отбрасываются
+    const int index = packet.counter;
+    const bool burstEnded = (index == context->packetsExpected - 1);
+
+    if (context->receivedData.place(packet) == DialogBuffer::Placement::Stored) {
+        context->packetsReceived = context->receivedData.received();
+        context->lastDataAtNs = m_rxTimestampNs;
+        if (context->repairAttempts > 0) {
+            ++m_repairedPackets;
+        }
+        if (!streamPacket(address, context, packet)) {
+            return;
+        }
+    }
+
+    LOG_CAT_DEBUG("Engine",QString("Пакет #%1 (%2/%3) для 0x%4")
+                  .arg(index)
+                  .arg(context->packetsReceived)
+                  .arg(context->packetsExpected)
+                  .arg(address, 4, 16, QChar('0')));
+
+    // Во время повтора дожидаемся конца пачки: хвост повтора не должен попасть в следующий диалог
+    if (context->packetsReceived >= context->packetsExpected &&
+        (context->repairAttempts == 0 || burstEnded)) {
+        endDataDialog(address);
+        completeOperation(address, true,
+                          context->repairAttempts > 0
+                              ? QString("Получены все %1 пакетов (повторов запроса: %2)")
+                                    .arg(context->packetsExpected).arg(context->repairAttempts)
+                              : allPacketsMessage(context->packetsExpected));
+        return;
+    }
+
+    // Последний пакет пачки пришел, а пропуски остались - дозапрашиваем сразу, не дожидаясь таймаута
+    if (burstEnded && context->packetsReceived < context->packetsExpected &&
+        tryGapRepair(address, context)) {
+        return;
+    }
+
+    m_timers->cancel(context->packetTimer);
+    context->packetTimer = m_timers->arm(PPBConstants::PACKET_TIMEOUT_MS,
+                                         [this, address]() { onPacketTimeout(address); });
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ АНАЛИЗ НА ЛЕТУ +++++++++++++++++++++++++++++++++++++
+void communicationengine::setStreamLimits(double maxBer, int maxMissingRun) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setStreamLimits", Qt::QueuedConnection,
+                                                                     Q_ARG(double, maxBer),
+                                                                     Q_ARG(int, maxMissingRun));
+                return;
+            }
+
+    m_streamLimits.maxBer = qMax(0.0, maxBer);
+    m_streamLimits.maxMissingRun = qMax(0, maxMissingRun);
+
+    LOG_CAT_INFO("Engine",QString("Досрочное прекращение приема: BER > %1, пропуск подряд > %2 (0 - выключено)")
+                 .arg(m_streamLimits.maxBer, 0, 'g', 4)
+                 .arg(m_streamLimits.maxMissingRun));
+}
+
+bool communicationengine::streamPacket(uint16_t address, PPBContext* context, const DataPacket& packet) {
+    context->stream.add(packet);
+
+    bool proceed = true;
+    if (m_commandInterface) {
+        m_callbackAddress = address;
+        try {
+            proceed = context->currentCommand->onPacket(m_commandInterface, packet.counter, packet, context->stream);
+        } catch (const std::exception& e) {
+            LOG_CAT_ERROR("Engine",QString("Исключение в onPacket: %1").arg(e.what()));
+        } catch (...) {
+            LOG_CAT_ERROR("Engine","Неизвестное исключение в onPacket");
+        }
+        m_callbackAddress = 0;
+    }
+
+    const StreamStats& stats = context->stream.stats();
+    if (context->packetsExpected >= STREAM_PROGRESS_STEP && stats.received % STREAM_PROGRESS_STEP == 0) {
+        emit streamProgress(address, context->currentCommand->commandId(), stats);
+    }
+
+    if (proceed) {
+        return true;
+    }
+
+    const QString reason = context->stream.failed() ? context->stream.failureReason()
+                                                    : QString("команда прервала прием");
+    LOG_CAT_WARNING("Engine",QString("0x%1: прием %2 прерван после %3 из %4 пакетов: %5")
+                    .arg(address, 4, 16, QChar('0'))
+                    .arg(context->currentCommand->name())
+                    .arg(stats.received)
+                    .arg(context->packetsExpected)
+                    .arg(reason));
+    endDataDialog(address);
+    completeOperation(address, false, QString("Прием прерван: %1").arg(reason));
+    return false;
+}
+
+bool communicationengine::tryGapRepair(uint16_t address, PPBContext* context) {
+    if (!context->gapRepair || context->packetsReceived == 0 ||
+        context->repairAttempts >= m_gapRepairMaxAttempts) {
+        return false;
+    }
+
+    ++context->repairAttempts;
+
+    // Команды дозапроса диапазона в протоколе нет: повторяем запрос, ППБ выдает ту же
+    // последовательность, из нее берутся только недостающие счетчики
+    LOG_CAT_WARNING("Engine",QString("0x%1: получено %2 из %3, дозапрос %4 (попытка %5 из %6): %7")
+                    .arg(address, 4, 16, QChar('0'))
+                    .arg(context->packetsReceived)
+                    .arg(context->packetsExpected)
+                    .arg(context->packetsExpected - context->packetsReceived)
+                    .arg(context->repairAttempts)
+                    .arg(m_gapRepairMaxAttempts)
+                    .arg(context->receivedData.missingRanges()));
+
+    m_timers->cancel(context->packetTimer);
+    context->packetTimer = 0;
+    context->waitingForOk = true;
+
+    // До OK повтора пакеты данных не ждем: иначе сам OK разобрался бы как пакет данных
+    reserveDataDialog(address);
+
+    sendToAddress(address, context->currentCommand->buildRequestRecord(address),
+                  commandLabel(context->currentCommand));
+    context->sentAtNs = m_lastSendNs;
+    context->okAtNs = 0;
+
+    armOperationTimer(address, context,
+                      phaseTimeoutMs(address, context->currentCommand, RtoEstimator::Phase::Ok));
+    return true;
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ КОНВЕЙЕР КОМАНД +++++++++++++++++++++++++++++++++++++
+void communicationengine::setPipelineWindow(int window) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setPipelineWindow", Qt::QueuedConnection,
+                                                                     Q_ARG(int, window));
+                return;
+            }
+
+    m_pipelineWindow = qMax(1, window);
+    LOG_CAT_INFO("Engine",QString("Окно конвейера по умолчанию: %1").arg(m_pipelineWindow));
+}
+
+void communicationengine::setAddressPipelineWindow(uint16_t address, int window) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setAddressPipelineWindow", Qt::QueuedConnection,
+                                                                     Q_ARG(uint16_t, address),
+                                                                     Q_ARG(int, window));
+                return;
+            }
+
+    if (window <= 0) {
+        m_pipelineWindows.remove(address);
+    } else {
+        m_pipelineWindows.insert(address, window);
+    }
+    LOG_CAT_INFO("Engine",QString("Окно конвейера для 0x%1: %2")
+                 .arg(address, 4, 16, QChar('0')).arg(pipelineWindow(address)));
+}
+
+void communicationengine::setAdaptiveTimeouts(bool enabled, int floorMs, int ceilingMs) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setAdaptiveTimeouts", Qt::QueuedConnection,
+                                                                     Q_ARG(bool, enabled),
+                                                                     Q_ARG(int, floorMs),
+                                                                     Q_ARG(int, ceilingMs));
+                return;
+            }
+
+    RtoEstimator::Config config;
+    config.enabled = enabled;
+    config.floorMs = floorMs;
+    config.ceilingMs = ceilingMs;
+    m_rto.setConfig(config);
+
+    LOG_CAT_INFO("Engine",QString("Адаптивные таймауты: %1, %2..%3 мс")
+                 .arg(enabled ? "включены" : "выключены")
+                 .arg(m_rto.config().floorMs).arg(m_rto.config().ceilingMs));
+}
+
+void communicationengine::setQueueAging(int agingMs) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setQueueAging", Qt::QueuedConnection,
+                                                                     Q_ARG(int, agingMs));
+                return;
+            }
+
+    m_commandQueue->setAgingMs(agingMs);
+    LOG_CAT_INFO("Engine",QString("Старение команд в очереди: %1")
+                 .arg(agingMs > 0 ? QString("%1 мс на класс").arg(agingMs) : QString("выключено")));
+}
+
+void communicationengine::setQueueLimit(int depth, QueueOverflowPolicy policy) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setQueueLimit", Qt::QueuedConnection,
+                                                                     Q_ARG(int, depth),
+                                                                     Q_ARG(QueueOverflowPolicy, policy));
+                return;
+            }
+
+    m_commandQueue->setDefaultLimit(depth, policy);
+    LOG_CAT_INFO("Engine",QString("Лимит очереди команд по умолчанию: %1, политика %2")
+                 .arg(depth > 0 ? QString::number(depth) : QString("нет"))
+                 .arg(static_cast<int>(policy)));
+}
+
+void communicationengine::setAddressQueueLimit(uint16_t address, int depth, QueueOverflowPolicy policy) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setAddressQueueLimit", Qt::QueuedConnection,
+                                                                     Q_ARG(uint16_t, address),
+                                                                     Q_ARG(int, depth),
+                                                                     Q_ARG(QueueOverflowPolicy, policy));
+                return;
+            }
+
+    m_commandQueue->setLimit(address, depth, policy);
+    LOG_CAT_INFO("Engine",QString("Лимит очереди команд для 0x%1: %2, политика %3")
+                 .arg(address, 4, 16, QChar('0'))
+                 .arg(depth > 0 ? QString::number(depth) : QString("нет"))
+                 .arg(static_cast<int>(policy)));
+}
+
+void communicationengine::setDialogPacketLimit(int packets) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setDialogPacketLimit", Qt::QueuedConnection,
+                                                                     Q_ARG(int, packets));
+                return;
+            }
+
+    m_dialogPacketLimit = packets > 0 ? packets : DEFAULT_DIALOG_PACKET_LIMIT;
+    LOG_CAT_INFO("Engine",QString("Буфер диалога с данными: до %1 пакетов").arg(m_dialogPacketLimit));
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ АВТООПРОС +++++++++++++++++++++++++++++++++++++
+void communicationengine::setAutoPoll(uint16_t address, int intervalMs) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setAutoPoll", Qt::QueuedConnection,
+                                                                     Q_ARG(uint16_t, address),
+                                                                     Q_ARG(int, intervalMs));
+                return;
+            }
+
+    if (TimerWheel::TimerId* timer = m_autoPolls.find(address)) {
+        m_timers->cancel(*timer);
+        m_autoPolls.erase(address);
+    }
+
+    if (intervalMs <= 0) {
+        LOG_CAT_INFO("Engine",QString("Автоопрос 0x%1 выключен").arg(address, 4, 16, QChar('0')));
+        return;
+    }
+
+    m_autoPolls[address] = m_timers->armPeriodic(intervalMs, [this, address]() { onAutoPoll(address); });
+    LOG_CAT_INFO("Engine",QString("Автоопрос 0x%1 каждые %2 мс").arg(address, 4, 16, QChar('0')).arg(intervalMs));
+}
+
+void communicationengine::onAutoPoll(uint16_t address) {
+    // Опрос не должен копиться: у подключенного ППБ в очереди не больше одного опроса.
+    // Класс Poll пропускает вперед команды оператора, старение не дает опросу голодать
+    if (m_stateManager->getState(address) == PPBState::Idle ||
+        m_commandQueue->count(address, CommandPriority::Poll) > 0) {
+        return;
+    }
+    // Из колеса таймеров можно отправлять сразу: отложенный вызов нужен только переходам
+    // внутри completeOperation
+    if (enqueueCommand(address, CommandFactory::get(TechCommand::TS), clockNs(),
+                       CommandPriority::Poll, 0)) {
+        processNextCommandForAddress(address);
+    }
+}
+
+int communicationengine::pipelineWindow(uint16_t address) const {
+    return m_pipelineWindows.value(address, m_pipelineWindow);
+}
+
+bool communicationengine::isPipelinable(uint16_t address, const PPBCommand* command) const {
+    if (!command || pipelineWindow(address) <= 1) {
+        return false;
+    }
+
+    // Только команды, которые завершаются самим OK: без пакетов ответа и без пакетной передачи
+    const CommandDescriptor* descriptor = CommandFactory::descriptor(command->commandId());
+    return descriptor && descriptor->direction == DataDirection::None;
+}
+
+void communicationengine::sendPipelined(uint16_t address) {
+    int64_t enqueuedAtNs = 0;
+    QVector<quint64> requestIds;
+    auto command = m_commandQueue->dequeue(address, &enqueuedAtNs, &requestIds);
+    if (!command) {
+        return;
+    }
+
+    std::deque<InFlight>& pipeline = m_pipelines[address];
+    if (pipeline.empty()) {
+        transitionState(address, PPBState::SendingCommand, "Конвейер");
+    }
+
+    sendToAddress(address, command->buildRequestRecord(address), commandLabel(command));
+
+    InFlight entry;
+    entry.requestedAtNs = enqueuedAtNs ? enqueuedAtNs : m_lastSendNs;
+    entry.sentAtNs = m_lastSendNs;
+    entry.deadlineNs = m_lastSendNs + int64_t(phaseTimeoutMs(address, command, RtoEstimator::Phase::Ok)) * 1000000;
+    m_metrics.count(address, command->commandId(), EngineMetrics::Counter::Sent);
+    m_metrics.record(address, command->commandId(), EngineMetrics::Stage::QueueWait,
+                     entry.sentAtNs - entry.requestedAtNs);
+
+    LOG_CAT_DEBUG("Engine",QString("Конвейер 0x%1: %2 отправлена, в полете %3")
+                  .arg(address, 4, 16, QChar('0'))
+                  .arg(command->name())
+                  .arg(pipeline.size() + 1));
+
+    entry.command = command;
+    entry.requestIds = std::move(requestIds);
+    pipeline.push_back(std::move(entry));
+    armPipelineTimer();
+}
+
+bool communicationengine::processPipelineResponse(const PPBResponse& response) {
+    std::deque<InFlight>* pipeline = m_pipelines.find(response.address);
+    if (!pipeline || pipeline->empty()) {
+        return false;
+    }
+
+    const uint16_t address = response.address;
+
+    // Номера запроса в OK нет: ответ относится к самому старому запросу в полете
+    InFlight entry = std::move(pipeline->front());
+    pipeline->pop_front();
+    const bool drained = pipeline->empty();
+
+    const bool success = response.status == 0x00;
+    const QString message = success ? QString("Команда выполнена")
+                                    : QString("Ошибка ППБ: 0x%1").arg(response.status, 2, 16, QChar('0'));
+
+    if (success) {
+        m_rto.sample(address, entry.command->commandId(), RtoEstimator::Phase::Ok,
+                     m_rxTimestampNs - entry.sentAtNs);
+        m_metrics.record(address, entry.command->commandId(), EngineMetrics::Stage::OkArrival,
+                         m_rxTimestampNs - entry.sentAtNs);
+    }
+    m_metrics.count(address, entry.command->commandId(),
+                    success ? EngineMetrics::Counter::Ok : EngineMetrics::Counter::Error);
+
+    LOG_CAT_INFO("Engine",QString("Конвейер 0x%1: %2 - %3")
+                 .arg(address, 4, 16, QChar('0'))
+                 .arg(entry.command->name())
+                 .arg(message));
+
+    emit commandCompleted(success, message, entry.command->commandId());
+    completeRequests(entry.requestIds, success, message, entry.command->commandId());
+
+    if (drained) {
+        transitionState(address, PPBState::Ready, "Конвейер пуст");
+    } else {
+        scheduleDispatch(address);   // освободилось место в окне
+    }
+    armPipelineTimer();
+    return true;
+}
+
+void communicationengine::checkPipelineTimeouts() {
+    const int64_t nowNs = clockNs();
+
+    std::vector<uint16_t> expired;
+    m_pipelines.forEach([&expired, nowNs](uint16_t address, const std::deque<InFlight>& pipeline) {
+        if (!pipeline.empty() && pipeline.front().deadlineNs <= nowNs) {
+            expired.push_back(address);
+        }
+    });
+
+    for (uint16_t address : expired) {
+        // OK самого старого запроса потерян: какому запросу принадлежат следующие OK,
+        // уже не определить - завершаем с ошибкой все окно, по порядку
+        std::deque<InFlight> pipeline = std::move(m_pipelines[address]);
+        m_pipelines.erase(address);
+
+        LOG_CAT_WARNING("Engine",QString("Конвейер 0x%1: таймаут %2, сброшено команд: %3")
+                        .arg(address, 4, 16, QChar('0'))
+                        .arg(pipeline.front().command->name())
+                        .arg(pipeline.size()));
+        m_rto.timedOut(address, pipeline.front().command->commandId(), RtoEstimator::Phase::Ok);
+
+        for (const InFlight& entry : pipeline) {
+            m_metrics.count(address, entry.command->commandId(), EngineMetrics::Counter::Timeout);
+            emit commandCompleted(false, "Таймаут операции (конвейер сброшен)", entry.command->commandId());
+            completeRequests(entry.requestIds, false, "Таймаут операции (конвейер сброшен)",
+                             entry.command->commandId());
         }
+        transitionState(address, PPBState::Ready, "Таймаут конвейера");
+    }
+
+    armPipelineTimer();
+}
+
+void communicationengine::armPipelineTimer() {
+    int64_t nearestNs = 0;
+    m_pipelines.forEach([&nearestNs](uint16_t, const std::deque<InFlight>& pipeline) {
+        if (!pipeline.empty() && (nearestNs == 0 || pipeline.front().deadlineNs < nearestNs)) {
+            nearestNs = pipeline.front().deadlineNs;
+        }
+    });
+
+    m_timers->cancel(m_pipelineTimer);
+    m_pipelineTimer = 0;
+    if (nearestNs == 0) {
+        return;
+    }
+
+    const int64_t waitNs = nearestNs - clockNs();
+    m_pipelineTimer = m_timers->arm(waitNs > 0 ? static_cast<int>(waitNs / 1000000) + 1 : 0, [this]() {
+        m_pipelineTimer = 0;
+        checkPipelineTimeouts();
+    });
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ ШИРОКОВЕЩАТЕЛЬНЫЕ КОМАНДЫ +++++++++++++++++++++++++++++++++++++
+bool communicationengine::processBroadcastResponse(const PPBResponse& response) {
+    if (!m_broadcast.active) {
+        return false;
+    }
+
+    // Ответ ППБ, у которого идет собственный запрос, принадлежит этому запросу
+    uint16_t bits = response.address & m_broadcast.pending;
+    for (int i = 0; i < 16 && bits; ++i) {
+        const uint16_t bit = static_cast<uint16_t>(1u << i);
+        const PPBContext* context = m_contexts.find(bit);
+        if ((bits & bit) && context && context->currentCommand &&
+            context->waitingForOk && !context->operationCompleted) {
+            bits &= ~bit;
+        }
+    }
+    if (bits == 0) {
+        return false;
+    }
+
+    const int expected = m_broadcast.command->expectedResponsePackets();
+
+    for (int i = 0; i < 16 && m_broadcast.active; ++i) {
+        const uint16_t bit = static_cast<uint16_t>(1u << i);
+        if (!(bits & bit)) {
+            continue;
+        }
+
+        BroadcastUnit& unit = m_broadcast.units[bit];
+        if (unit.responded) {
+            continue;   // повтор OK
+        }
+        unit.responded = true;
+
+        if (response.status != 0x00) {
+            finishBroadcastUnit(bit, false, QString("Ошибка ППБ: 0x%1").arg(response.status, 2, 16, QChar('0')));
+        } else if (expected > 0) {
+            unit.receivedData.reset(expected);
+            m_broadcast.dataOrder.push_back(bit);
+            LOG_CAT_DEBUG("Engine",QString("Широковещательно: OK от 0x%1, ожидание %2 пакетов")
+                          .arg(bit, 4, 16, QChar('0')).arg(expected));
+        } else {
+            finishBroadcastUnit(bit, true, "Команда выполнена");
+        }
+    }
+    return true;
+}
+
+bool communicationengine::processBroadcastData(const DataPacket& packet) {
+    if (!m_broadcast.active || m_broadcast.dataOrder.empty()) {
+        return false;
+    }
+
+    const uint16_t bit = m_broadcast.dataOrder.front();
+    BroadcastUnit& unit = m_broadcast.units[bit];
+    unit.receivedData.place(packet);   // повтор или лишний счетчик - отброшен
 
-        completeOperation(activeAddress, true,
-                          QString("Получены все %1 пакетов").arg(context->packetsExpected));
+    const int expected = m_broadcast.command->expectedResponsePackets();
+    if (!unit.receivedData.isComplete()) {
+        return true;
+    }
+
+    // Все пакеты ППБ получены - разбор той же логикой команды, что и для одиночного запроса
+    m_broadcastCallbackUnit = &unit;
+    m_callbackAddress = bit;
+    try {
+        m_broadcast.command->onDataReceived(m_commandInterface, unit.receivedData);
+    } catch (const std::exception& e) {
+        LOG_CAT_ERROR("Engine",QString("Исключение в onDataReceived: %1").arg(e.what()));
+    } catch (...) {
+        LOG_CAT_ERROR("Engine","Неизвестное исключение в onDataReceived");
+    }
+    m_callbackAddress = 0;
+    m_broadcastCallbackUnit = nullptr;
+
+    const bool success = unit.parsedSet ? unit.parsedSuccess : true;
+    const QString message = unit.message.isEmpty() ? QString("Получены все %1 пакетов").arg(expected)
+                                                   : unit.message;
+    finishBroadcastUnit(bit, success, message);
+    return true;
+}
+
+void communicationengine::finishBroadcastUnit(uint16_t bit, bool success, const QString& message) {
+    BroadcastUnit& unit = m_broadcast.units[bit];
+    unit.done = true;
+    unit.success = success;
+    unit.message = message;
+
+    m_broadcast.pending &= ~bit;
+    auto it = std::find(m_broadcast.dataOrder.begin(), m_broadcast.dataOrder.end(), bit);
+    if (it != m_broadcast.dataOrder.end()) {
+        m_broadcast.dataOrder.erase(it);
+    }
+
+    if (m_broadcast.pending == 0) {
+        finishBroadcast("ответили все");
+    }
+}
+
+void communicationengine::finishBroadcast(const QString& reason) {
+    if (!m_broadcast.active) {
+        return;
+    }
+    m_timers->cancel(m_broadcastTimer);
+    m_broadcastTimer = 0;
+
+    const int expected = m_broadcast.command->expectedResponsePackets();
+
+    BroadcastResult result;
+    result.command = m_broadcast.command->commandId();
+    result.requestedMask = m_broadcast.mask;
+    result.elapsedMs = (clockNs() - m_broadcast.startedAtNs) / 1000000;
+
+    for (auto& item : m_broadcast.units) {
+        const uint16_t bit = item.first;
+        BroadcastUnit& unit = item.second;
+
+        if (!unit.done) {
+            if (!unit.responded) {
+                unit.message = "Нет ответа";
+            } else {
+                unit.message = QString("Таймаут. Получено %1 из %2 пакетов")
+                                   .arg(unit.receivedData.received()).arg(expected);
+            }
+            unit.success = false;
+        }
+
+        if (unit.responded) {
+            result.respondedMask |= bit;
+        }
+        if (unit.success) {
+            result.okMask |= bit;
+        }
+        result.messages.insert(bit, unit.message);
+        if (unit.parsedData.isValid()) {
+            result.data.insert(bit, unit.parsedData);
+        }
     }
+
+    LOG_CAT_INFO("Engine",QString("Широковещательная %1 завершена (%2) за %3 мс: маска 0x%4, ответили 0x%5, успешно 0x%6")
+                 .arg(m_broadcast.command->name())
+                 .arg(reason)
+                 .arg(result.elapsedMs)
+                 .arg(result.requestedMask, 4, 16, QChar('0'))
+                 .arg(result.respondedMask, 4, 16, QChar('0'))
+                 .arg(result.okMask, 4, 16, QChar('0')));
+
+    m_broadcast = Broadcast();
+
+    // Команды, ждавшие освобождения бриджа для своих данных
+    m_blockedByDataDialog.take().forEach([this](uint16_t blocked) { scheduleDispatch(blocked); });
+
+    emit broadcastCompleted(result);
 }
 
 // +++++++++++++++++++++++++++++++++++++++++++++++++ МАШИНА СОСТОЯНИЯ +++++++++++++++++++++++++++++++++++++
@@ -747,38 +2044,47 @@ QString communicationengine::stateToString(PPBState state)  const {
     }
 }
 
-void communicationengine::transitionState(uint16_t address, PPBState newState, const QString& reason) {
+void communicationengine::transitionState(uint16_t address, PPBState newState, const char* reason,
+                                          const QString& detail) {
     // Получаем текущее состояние
     PPBState oldState = m_stateManager->getState(address);
 
     // Если состояние не изменилось - выходим
     if (oldState == newState) {
-        LOG_CAT_DEBUG("Engine",QString("Состояние не изменилось для 0x%1: %2 [%3]")
+        LOG_CAT_DEBUG("Engine",QString("Состояние не изменилось для 0x%1: %2 [%3%4]")
                       .arg(address, 4, 16, QChar('0'))
                       .arg(stateToString(oldState))
-                      .arg(reason));
+                      .arg(QString::fromUtf8(reason))
+                      .arg(detail.isEmpty() ? QString() : ": " + detail));
         return;
     }
 
     // Логируем переход
-    LOG_CAT_INFO("Engine",QString("Переход состояния для 0x%1: %2 -> %3 [%4]")
+    LOG_CAT_INFO("Engine",QString("Переход состояния для 0x%1: %2 -> %3 [%4%5]")
                  .arg(address, 4, 16, QChar('0'))
                  .arg(stateToString(oldState))
                  .arg(stateToString(newState))
-                 .arg(reason));
+                 .arg(QString::fromUtf8(reason))
+                 .arg(detail.isEmpty() ? QString() : ": " + detail));
 
-    // Дополнительные действия при определенных переходах
+    // Дополнительные действия при определенных переходах.
+    // Очередь проверяется, только если в ней что-то есть или ждет приостановленная передача:
+    // опрос без других команд завершается без отложенного вызова
+    const bool hasWork = !m_commandQueue->isEmpty(address) || (m_bulk.paused && m_bulk.address == address);
     switch (newState) {
     case PPBState::Idle:
         // При переходе в Idle очищаем контекст
         clearContext(address);
+        if (hasWork) {
+            scheduleDispatch(address);
+        }
         break;
 
     case PPBState::Ready:
         // При готовности проверяем очередь команд
-        QTimer::singleShot(0, this, [this, address]() {
-            processNextCommandForAddress(address);
-        });
+        if (hasWork) {
+            scheduleDispatch(address);
+        }
         break;
 
     default:
@@ -788,13 +2094,19 @@ void communicationengine::transitionState(uint16_t address, PPBState newState, c
     // Устанавливаем новое состояние
     m_stateManager->setState(address, newState);
 
+    // Адрес освободился - диалог с данными, если был его, закончен: будим ожидавших
+    if ((newState == PPBState::Ready || newState == PPBState::Idle) && !m_blockedByDataDialog.isEmpty()) {
+        m_blockedByDataDialog.take().forEach([this](uint16_t blocked) { scheduleDispatch(blocked); });
+    }
+
     // Отправляем сигнал (если нужно)
     if (address == m_currentAddress) {
         emit stateChanged(address, newState);
     }
 }
 
-void communicationengine::completeOperation(uint16_t address, bool success, const QString& message) {
+void communicationengine::completeOperation(uint16_t address, bool success, const QString& message,
+                                            bool timedOut) {
     // Получаем контекст
     PPBContext* context = getContext(address);
     if (!context) {
@@ -813,20 +2125,13 @@ void communicationengine::completeOperation(uint16_t address, bool success, cons
     // Устанавливаем флаг завершения
     context->operationCompleted = true;
 
-    // Останавливаем таймер
-    if (context->operationTimer) {
-        context->operationTimer->stop();
-    }
+    recordLatency(address, *context);
+
+    // Снимаем таймауты операции и пакетов
+    cancelTimers(context);
 
     // Сбрасываем активный диалог, если это наш адрес
-    {
-        QMutexLocker locker(&m_activeDataMutex);
-        if (address == m_activeDataAddress) {
-            m_activeDataAddress = 0;
-            m_waitingForData = false;
-            LOG_CAT_DEBUG("Engine",QString("Сброшен активный диалог для адреса 0x%1").arg(address, 4, 16, QChar('0')));
-        }
-    }
+    endDataDialog(address);
 
     // =====  ЛОГИКА: ИСПОЛЬЗОВАНИЕ РЕЗУЛЬТАТОВ ПАРСИНГА =====
     QString finalMessage = message;
@@ -842,6 +2147,16 @@ void communicationengine::completeOperation(uint16_t address, bool success, cons
                                     .arg(context->parsedMessage));
     }
 
+    // Разбор ответа мог заменить сообщение - причина досрочного прекращения приема не теряется
+    if (context->stream.failed() && !finalMessage.contains(context->stream.failureReason())) {
+        finalMessage += QString(" (прием прерван: %1)").arg(context->stream.failureReason());
+    }
+
+    // Итог анализа на лету - и для полного ответа, и для оборванного
+    if (context->currentCommand && context->packetsExpected >= STREAM_PROGRESS_STEP) {
+        emit streamProgress(address, context->currentCommand->commandId(), context->stream.stats());
+    }
+
     // Логируем завершение
     LOG_CAT_INFO("Engine",QString("Завершение операции для 0x%1: %2 - %3")
                                .arg(address, 4, 16, QChar('0'))
@@ -854,8 +2169,9 @@ void communicationengine::completeOperation(uint16_t address, bool success, cons
     // результаты парсинга через CommandInterface
     if (!context->receivedData.isEmpty() && context->currentCommand && m_commandInterface) {
         LOG_CAT_DEBUG("Engine",QString("Вызываем onDataReceived команды для обработки %1 пакетов")
-                                    .arg(context->receivedData.size()));
+                                    .arg(context->receivedData.received()));
         if (m_commandInterface) {
+            m_callbackAddress = address;
             try {
                 context->currentCommand->onDataReceived(m_commandInterface, context->receivedData);
             } catch (const std::exception& e) {
@@ -863,7 +2179,24 @@ void communicationengine::completeOperation(uint16_t address, bool success, cons
             } catch (...) {
                 LOG_CAT_ERROR("Engine","Неизвестное исключение в onDataReceived");
             }
+            m_callbackAddress = 0;
+        }
+    }
+
+    // Исход для метрик: таймаут с частью данных - частичный, даже если команда их приняла
+    if (context->currentCommand) {
+        const bool incomplete = context->packetsReceived < context->packetsExpected;
+        EngineMetrics::Counter outcome = EngineMetrics::Counter::Ok;
+        if (timedOut && incomplete && context->packetsReceived > 0) {
+            outcome = EngineMetrics::Counter::Partial;
+        } else if (timedOut && (incomplete || !finalSuccess)) {
+            outcome = EngineMetrics::Counter::Timeout;
+        } else if (!finalSuccess) {
+            outcome = EngineMetrics::Counter::Error;
+        } else if (incomplete) {
+            outcome = EngineMetrics::Counter::Partial;
         }
+        m_metrics.count(address, context->currentCommand->commandId(), outcome);
     }
 
     // ===== ОПРЕДЕЛЕНИЕ СЛЕДУЮЩЕГО СОСТОЯНИЯ =====
@@ -903,6 +2236,8 @@ void communicationengine::completeOperation(uint16_t address, bool success, cons
     // Отправляем сигнал о завершении команды
     if (context->currentCommand) {
         emit commandCompleted(finalSuccess, finalMessage, context->currentCommand->commandId());
+        completeRequests(context->requestIds, finalSuccess, finalMessage, context->currentCommand->commandId());
+        context->requestIds.clear();
     } else {
         emit commandCompleted(finalSuccess, finalMessage, TechCommand::TS);
     }
@@ -914,8 +2249,7 @@ void communicationengine::completeOperation(uint16_t address, bool success, cons
     }
 
     // ===== ПЕРЕХОД В НОВОЕ СОСТОЯНИЕ =====
-    transitionState(address, nextState,
-                    QString("Завершение операции: %1").arg(finalMessage));
+    transitionState(address, nextState, "Завершение операции", finalMessage);
 
     // ===== ОЧИСТКА КОНТЕКСТА =====
     // Не очищаем контекст полностью, только поля парсинга для следующей операции
@@ -923,18 +2257,65 @@ void communicationengine::completeOperation(uint16_t address, bool success, cons
 }
 
 void communicationengine::processNextCommandForAddress(uint16_t address) {
-    // Проверяем, что мы в состоянии Ready
-    if (m_stateManager->getState(address) != PPBState::Ready) {
-        return;
+    const int promoted = m_commandQueue->age(address, clockNs());
+    if (promoted > 0) {
+        LOG_CAT_DEBUG("Engine",QString("0x%1: %2 команд повышены в классе после %3 мс ожидания")
+                      .arg(address, 4, 16, QChar('0'))
+                      .arg(promoted)
+                      .arg(m_commandQueue->agingMs()));
     }
 
     // Проверяем, есть ли команды в очереди
-    if (m_commandQueue->isEmpty(address)) {
+    const PPBCommand* next = m_commandQueue->front(address);
+    const PPBState state = m_stateManager->getState(address);
+    const std::deque<InFlight>* pipeline = m_pipelines.find(address);
+    const bool pipelineBusy = pipeline && !pipeline->empty();
+
+    // Приостановленная передача продолжается, как только впереди не осталось команд выше классом.
+    // Пакетная команда, догнавшая их старением, тоже ждет: передача у движка одна
+    if (m_bulk.paused && m_bulk.address == address && !pipelineBusy &&
+        (state == PPBState::Ready || state == PPBState::Idle)) {
+        const CommandDescriptor* descriptor = next ? CommandFactory::descriptor(next->commandId()) : nullptr;
+        if (!next || m_commandQueue->frontPriority(address) > CommandPriority::Interactive ||
+            (descriptor && descriptor->direction == DataDirection::ToPPB)) {
+            resumeBulk(address);
+            return;
+        }
+    }
+
+    if (!next) {
+        return;
+    }
+
+    // Конвейер: команды без данных догоняют уже отправленные, пока есть место в окне
+    if (state == PPBState::Ready || pipelineBusy) {
+        while (next && isPipelinable(address, next) &&
+               int(m_pipelines[address].size()) < pipelineWindow(address)) {
+            sendPipelined(address);
+            next = m_commandQueue->front(address);
+        }
+        // find, а не []: конвейер не создается у адреса, который им не пользуется
+        const std::deque<InFlight>* sent = m_pipelines.find(address);
+        if (!next || pipelineBusy || (sent && !sent->empty())) {
+            return;   // остальное - когда конвейер опустеет
+        }
+    }
+
+    // Команды уходят из Ready, а также из Idle - подключение (TS) ставится в очередь до первого ответа
+    if (state != PPBState::Ready && state != PPBState::Idle) {
+        return;
+    }
+
+    // Идет чужой диалог с данными - команду не трогаем, проверим снова, когда он закончится
+    if (!canExecuteCommand(address, next)) {
+        m_blockedByDataDialog.insert(address);
         return;
     }
 
     // Берем следующую команду из очереди
-    auto command = m_commandQueue->dequeue(address);
+    int64_t enqueuedAtNs = 0;
+    QVector<quint64> requestIds;
+    auto command = m_commandQueue->dequeue(address, &enqueuedAtNs, &requestIds);
     if (!command) {
         return;
     }
@@ -944,28 +2325,501 @@ void communicationengine::processNextCommandForAddress(uint16_t address) {
                  .arg(command->name()));
 
     // Выполняем команду немедленно
-    executeCommandImmediately(address, std::move(command));
+    executeCommandImmediately(address, command, enqueuedAtNs, requestIds);
 }
 
-bool communicationengine::canExecuteCommand(uint16_t address, const PPBCommand* command) const {
-    QMutexLocker locker(&m_activeDataMutex);
+CommandPriority communicationengine::priorityOf(const PPBCommand* command) {
+    // Команды, без которых нет связи (TS при подключении и опросе оператором), - вне очереди
+    if (command->isConnectionCritical()) {
+        return CommandPriority::Control;
+    }
+    const CommandDescriptor* descriptor = CommandFactory::descriptor(command->commandId());
+    return descriptor ? descriptor->priority : CommandPriority::Interactive;
+}
 
+bool communicationengine::canExecuteCommand(uint16_t address, const PPBCommand* command) const {
     // Если команда НЕ ожидает данных — можно выполнять всегда
     if (command->expectedResponsePackets() == 0) {
         return true;
     }
 
-    // Если команда ожидает данных:
-    // 1. Не должно быть активного диалога с данными
-    // 2. Или если есть активный диалог, то это должен быть тот же адрес
-    //    (хотя это рискованно — данные могут перемешаться)
+    // Если команда ожидает данных: на ее конечной точке не должно быть другого диалога,
+    // иначе пакеты двух ППБ не различить. Диалоги с разными конечными точками - параллельно
+    const Endpoint endpoint = endpointFor(address);
+    const quint64 key = endpointKey(endpoint.host, endpoint.port);
+
+    // Широковещательная команда принимает данные через адрес подключения
+    if (m_broadcast.active && !m_broadcast.dataOrder.empty() &&
+        key == endpointKey(m_currentHost, m_currentPort)) {
+        return false;
+    }
+    return findDataDialog(key) == nullptr;
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ КОНЕЧНЫЕ ТОЧКИ И ДИАЛОГИ +++++++++++++++++++++++++++++++++++++
+void communicationengine::setPPBEndpoint(uint16_t address, const QString& ip, quint16 port) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setPPBEndpoint", Qt::QueuedConnection,
+                                                                     Q_ARG(uint16_t, address),
+                                                                     Q_ARG(QString, ip),
+                                                                     Q_ARG(quint16, port));
+                return;
+            }
+
+    if (ip.isEmpty()) {
+        m_endpoints.remove(address);
+        LOG_CAT_INFO("Engine",QString("0x%1: конечная точка - адрес подключения")
+                     .arg(address, 4, 16, QChar('0')));
+        return;
+    }
+
+    Endpoint endpoint;
+    endpoint.host = QHostAddress(ip);
+    endpoint.port = port;
+    m_endpoints.insert(address, endpoint);
+
+    LOG_CAT_INFO("Engine",QString("0x%1: собственная конечная точка %2:%3")
+                 .arg(address, 4, 16, QChar('0'))
+                 .arg(ip).arg(port));
+}
+
+communicationengine::Endpoint communicationengine::endpointFor(uint16_t address) const {
+    auto it = m_endpoints.constFind(address);
+    if (it != m_endpoints.constEnd()) {
+        return it.value();
+    }
+
+    Endpoint endpoint;
+    endpoint.host = m_currentHost;
+    endpoint.port = m_currentPort;
+    return endpoint;
+}
+
+quint64 communicationengine::endpointKey(const QHostAddress& host, quint16 port) {
+    bool isIPv4 = false;
+    const quint32 ipv4 = host.toIPv4Address(&isIPv4);
+    return endpointKey(isIPv4 ? ipv4 : 0u, port);
+}
+
+void communicationengine::sendToAddress(uint16_t address, const BaseRequest& request, const char* description) {
+    if (!m_udpClient) {
+        emit errorOccurred("UDPClient не инициализирован");
+        return;
+    }
+
+    // Широковещательное подключение - через sendBroadcast, это не путь опроса
+    const Endpoint endpoint = endpointFor(address);
+    if (endpoint.host.isNull() || endpoint.host == QHostAddress::Broadcast) {
+        sendPacketInternal(QByteArray(reinterpret_cast<const char*>(&request), sizeof(request)),
+                           QString::fromUtf8(description));
+        return;
+    }
+
+    m_udpClient->sendDatagrams(reinterpret_cast<const char*>(&request), int(sizeof(request)), 1,
+                               endpoint.host, endpoint.port);
+    m_lastSendNs = clockNs();
+
+    LOG_CAT_INFO("Engine",QString("Отправлен пакет: %1 -> %2:%3")
+                 .arg(QString::fromUtf8(description)).arg(endpoint.host.toString()).arg(endpoint.port));
+}
+
+const communicationengine::DataDialog* communicationengine::findDataDialog(quint64 endpoint) const {
+    for (const DataDialog& dialog : m_dataDialogs) {
+        if (dialog.endpoint == endpoint) {
+            return &dialog;
+        }
+    }
+    return nullptr;
+}
+
+void communicationengine::reserveDataDialog(uint16_t address) {
+    openDataDialog(address, false);
+}
+
+void communicationengine::beginDataDialog(uint16_t address) {
+    openDataDialog(address, true);
+}
+
+void communicationengine::openDataDialog(uint16_t address, bool receiving) {
+    const quint64 key = bridgeKey(address);
+
+    for (DataDialog& dialog : m_dataDialogs) {
+        if (dialog.endpoint == key) {
+            dialog.address = address;
+            dialog.receiving = receiving;
+            return;
+        }
+    }
+    m_dataDialogs.push_back(DataDialog{key, address, receiving});
+}
+
+void communicationengine::endDataDialog(uint16_t address) {
+    for (auto it = m_dataDialogs.begin(); it != m_dataDialogs.end(); ++it) {
+        if (it->address == address) {
+            m_dataDialogs.erase(it);
+            LOG_CAT_DEBUG("Engine",QString("Сброшен активный диалог для адреса 0x%1").arg(address, 4, 16, QChar('0')));
+            return;
+        }
+    }
+}
+
+uint16_t communicationengine::dataDialogAddress(quint64 senderKey) const {
+    if (m_dataDialogs.empty()) {
+        return 0;
+    }
 
-    if (!m_waitingForData) {
-        return true; // Нет активного диалога — можно
+    // Отправитель не совпал ни с одной точкой: подключение широковещательное или бридж
+    // отвечает с другого порта - данные относим к диалогу на адресе подключения
+    const DataDialog* dialog = findDataDialog(senderKey);
+    if (!dialog) {
+        dialog = findDataDialog(endpointKey(m_currentHost, m_currentPort));
+    }
+    if (!dialog && m_dataDialogs.size() == 1) {
+        dialog = &m_dataDialogs.front();
     }
 
-    // Есть активный диалог — можно только если тот же адрес
-    // (Но лучше запретить вообще, чтобы не перемешивать данные)
-    return false; // Пока запрещаем все параллельные диалоги с данными
+    // Диалог, ждущий OK, данных еще не принимает: датаграмма разбирается как ответ ППБ
+    return dialog && dialog->receiving ? dialog->address : 0;
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ ПАКЕТНАЯ ПЕРЕДАЧА +++++++++++++++++++++++++++++++++++++
+void communicationengine::setDataPacketInterval(int intervalMs) {
+    // Интервал - частный случай темпа: один пакет каждые intervalMs
+    setPacketRate(intervalMs > 0 ? 1000.0 / intervalMs : 0.0, 1);
+}
+
+void communicationengine::setPacketRate(double packetsPerSecond, int burst) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setPacketRate", Qt::QueuedConnection,
+                                                                     Q_ARG(double, packetsPerSecond),
+                                                                     Q_ARG(int, burst));
+                return;
+            }
+
+    m_pacer->setDefaultRate(packetsPerSecond, burst);
+    LOG_CAT_INFO("Engine",QString("Темп пакетов данных по умолчанию: %1 пак/с, пачка %2")
+                 .arg(packetsPerSecond).arg(burst));
+}
+
+void communicationengine::setBridgePacketRate(uint16_t address, double packetsPerSecond, int burst) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setBridgePacketRate", Qt::QueuedConnection,
+                                                                     Q_ARG(uint16_t, address),
+                                                                     Q_ARG(double, packetsPerSecond),
+                                                                     Q_ARG(int, burst));
+                return;
+            }
+
+    // Полоса делится между всеми ППБ этого бриджа
+    const Endpoint endpoint = endpointFor(address);
+    m_pacer->setRate(endpointKey(endpoint.host, endpoint.port), packetsPerSecond, burst);
+    LOG_CAT_INFO("Engine",QString("Темп пакетов данных бриджа %1:%2 (через 0x%3): %4 пак/с, пачка %5")
+                 .arg(endpoint.host.toString()).arg(endpoint.port)
+                 .arg(address, 4, 16, QChar('0'))
+                 .arg(packetsPerSecond).arg(burst));
 }
 
+void communicationengine::sendDataPackets(const QVector<DataPacket>& packets) {
+    if (packets.isEmpty()) {
+        return;
+    }
+
+    if (!m_udpClient) {
+        emit errorOccurred("UDPClient не инициализирован");
+        return;
+    }
+
+    if (m_bulk.active) {
+        LOG_CAT_WARNING("Engine",QString("Пакетная передача для 0x%1 уже идет, новая отклонена")
+                        .arg(m_bulk.address, 4, 16, QChar('0')));
+        emit errorOccurred("Пакетная передача уже выполняется");
+        return;
+    }
+
+    m_bulk.active = true;
+    m_bulk.address = m_callbackAddress;
+    m_bulk.packets = packets;
+    m_bulk.next = 0;
+
+    LOG_CAT_INFO("Engine",QString("Пакетная передача %1 пакетов для 0x%2 (темп %3 пак/с)")
+                 .arg(packets.size())
+                 .arg(m_bulk.address, 4, 16, QChar('0'))
+                 .arg(m_pacer->rate(bridgeKey(m_bulk.address))));
+
+    const quint64 bridge = bridgeKey(m_bulk.address);
+    if (m_pacer->isUnlimited(bridge)) {
+        sendBulkChunk(m_bulk.packets.size());
+    } else {
+        m_pacer->start(bridge, m_bulk.address);
+    }
+}
+
+void communicationengine::onPacerWindow(uint16_t address, int packets) {
+    if (!m_bulk.active || m_bulk.paused || m_bulk.address != address) {
+        m_pacer->stop();
+        return;
+    }
+    sendBulkChunk(packets);
+}
+
+void communicationengine::sendBulkChunk(int maxPackets) {
+    const int total = m_bulk.packets.size();
+    const int count = qMin(total - m_bulk.next, maxPackets);
+    const Endpoint endpoint = endpointFor(m_bulk.address);
+    const QHostAddress target = endpoint.host.isNull() ? QHostAddress(QHostAddress::Broadcast)
+                                                       : endpoint.host;
+
+    int sent = m_udpClient->sendDatagrams(reinterpret_cast<const char*>(m_bulk.packets.constData() + m_bulk.next),
+                                          sizeof(DataPacket), count, target, endpoint.port);
+    if (sent < 0) {
+        finishBulkTransfer(false);
+        return;
+    }
+
+    m_bulk.next += sent;
+    m_pacer->consume(sent);
+    emit commandProgress(m_bulk.next, total);
+
+    if (m_bulk.next >= total) {
+        finishBulkTransfer(true);
+        return;
+    }
+
+    // Без ограничения темпа: буфер сокета заполнен, досылаем остаток чуть позже.
+    // Под управлением планировщика недосланное уйдет в следующих окнах
+    if (!m_pacer->isActive()) {
+        m_timers->arm(1, [this]() {
+            if (m_bulk.active && !m_bulk.paused && !m_pacer->isActive()) {
+                sendBulkChunk(m_bulk.packets.size() - m_bulk.next);
+            }
+        });
+    }
+}
+
+void communicationengine::finishBulkTransfer(bool success) {
+    m_pacer->stop();   // итоговая статистика темпа уходит в pacerStatsUpdated
+
+    const uint16_t address = m_bulk.address;
+    const int sent = m_bulk.next;
+    const int total = m_bulk.packets.size();
+    m_bulk = BulkTransfer();
+
+    LOG_CAT_INFO("Engine",QString("Пакетная передача для 0x%1 завершена: %2 из %3 пакетов")
+                 .arg(address, 4, 16, QChar('0'))
+                 .arg(sent).arg(total));
+
+    emit bulkTransferFinished(address, sent, total);
+
+    // Команда без фазы данных ждала окончания передачи
+    PPBContext* context = m_contexts.find(address);
+    if (context && context->awaitingBulk && !context->operationCompleted) {
+        context->awaitingBulk = false;
+        completeOperation(address, success && sent == total,
+                          QString("Передано %1 из %2 пакетов").arg(sent).arg(total));
+    }
+}
+
+bool communicationengine::preemptBulk(uint16_t address) {
+    if (!m_bulkPreemption || !m_bulk.active || m_bulk.paused || m_bulk.address != address) {
+        return false;
+    }
+
+    // Уступаем только после OK на команду передачи: дальше между пакетами ППБ примет и запрос
+    PPBContext* context = m_contexts.find(address);
+    if (!context || !context->awaitingBulk || context->operationCompleted) {
+        return false;
+    }
+
+    m_pacer->stop();
+    m_bulk.paused = true;
+
+    // Операция передачи откладывается целиком, адрес свободен для следующей команды
+    cancelTimers(context);
+    m_bulk.suspended = std::move(*context);
+    *context = PPBContext();
+
+    LOG_CAT_INFO("Engine",QString("Пакетная передача для 0x%1 приостановлена на пакете %2 из %3")
+                 .arg(address, 4, 16, QChar('0'))
+                 .arg(m_bulk.next).arg(m_bulk.packets.size()));
+
+    transitionState(address, PPBState::Ready, "Пакетная передача уступила команде");
+    return true;
+}
+
+void communicationengine::resumeBulk(uint16_t address) {
+    PPBContext* context = getContext(address);
+    cancelTimers(context);
+    *context = std::move(m_bulk.suspended);
+    m_bulk.suspended = PPBContext();
+    m_bulk.paused = false;
+
+    LOG_CAT_INFO("Engine",QString("Пакетная передача для 0x%1 продолжена с пакета %2 из %3")
+                 .arg(address, 4, 16, QChar('0'))
+                 .arg(m_bulk.next).arg(m_bulk.packets.size()));
+
+    transitionState(address, PPBState::SendingCommand, "Продолжение пакетной передачи");
+    if (context->currentCommand) {
+        armOperationTimer(address, context,
+                          phaseTimeoutMs(address, context->currentCommand,
+                                         context->waitingForOk ? RtoEstimator::Phase::Ok
+                                                               : RtoEstimator::Phase::Data));
+    }
+
+    const quint64 bridge = bridgeKey(address);
+    if (m_pacer->isUnlimited(bridge)) {
+        sendBulkChunk(m_bulk.packets.size() - m_bulk.next);
+    } else {
+        m_pacer->start(bridge, address);
+    }
+}
+
+void communicationengine::setBulkPreemption(bool enabled) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "setBulkPreemption", Qt::QueuedConnection,
+                                                                     Q_ARG(bool, enabled));
+                return;
+            }
+
+    m_bulkPreemption = enabled;
+    LOG_CAT_INFO("Engine",QString("Вытеснение пакетной передачи: %1").arg(enabled ? "включено" : "выключено"));
+
+    // Выключили во время паузы - передача продолжится на ближайшей диспетчеризации адреса
+    if (!enabled && m_bulk.paused) {
+        scheduleDispatch(m_bulk.address);
+    }
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ ЗАДЕРЖКИ +++++++++++++++++++++++++++++++++++++
+void communicationengine::recordLatency(uint16_t address, const PPBContext& context) {
+    if (!context.currentCommand || context.sentAtNs == 0 || context.okAtNs == 0) {
+        return;   // OK не пришел - задержку не считаем (это таймаут)
+    }
+    if (context.repairAttempts > 0) {
+        return;   // запрос повторялся: неизвестно, на какой из них ответ
+    }
+
+    const TechCommand command = context.currentCommand->commandId();
+
+    m_rto.sample(address, command, RtoEstimator::Phase::Ok, context.okAtNs - context.sentAtNs);
+    m_metrics.record(address, command, EngineMetrics::Stage::OkArrival, context.okAtNs - context.sentAtNs);
+
+    // OK -> последний пакет - только для полностью принятых данных
+    if (context.packetsExpected > 0 && context.packetsReceived >= context.packetsExpected &&
+        context.lastDataAtNs != 0) {
+        m_rto.sample(address, command, RtoEstimator::Phase::Data, context.lastDataAtNs - context.okAtNs);
+        m_metrics.record(address, command, EngineMetrics::Stage::DataCompletion,
+                         context.lastDataAtNs - context.okAtNs);
+    }
+
+    LOG_CAT_DEBUG("Engine",QString("Задержка %1 для 0x%2: запрос->OK %3 мкс")
+                  .arg(context.currentCommand->name())
+                  .arg(address, 4, 16, QChar('0'))
+                  .arg((context.okAtNs - context.sentAtNs) / 1000));
+}
+
+void communicationengine::requestLatencyReport() {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "requestLatencyReport", Qt::QueuedConnection);
+                return;
+            }
+
+    const TimerWheelStats timers = m_timers->stats();
+    const EngineMetrics::Snapshot metrics = m_metrics.snapshot();
+    emit latencyReportReady(metrics.latencyReport() + "\n" + m_rto.report() +
+                            QString("\nТаймеры: взведено %1 (пик %2), сработало %3, отменено %4, "
+                                    "опоздание ср. %5 мкс, макс. %6 мкс, >5 мс: %7")
+                                .arg(timers.armed).arg(timers.armedPeak)
+                                .arg(timers.fired).arg(timers.cancelled)
+                                .arg(timers.lateAvgUs).arg(timers.lateMaxUs)
+                                .arg(timers.lateOver5ms) +
+                            QString("\nДозапрос пропусков: %1, дозапрошено пакетов: %2")
+                                .arg(m_gapRepair ? "включен" : "выключен")
+                                .arg(m_repairedPackets) +
+                            QString("\nСлито одинаковых запросов в очереди: %1")
+                                .arg(m_commandQueue->coalescedCount()) +
+                            QString("\nСобытий перегрузки: %1").arg(m_overloadEvents) +
+                            "\n" + metrics.toText());
+}
+
+void communicationengine::resetLatencyStats() {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "resetLatencyStats", Qt::QueuedConnection);
+                return;
+            }
+
+    m_metrics.reset();
+    m_timers->resetStats();
+    m_repairedPackets = 0;
+    m_overloadEvents = 0;
+    LOG_CAT_INFO("Engine","Статистика задержек сброшена");
+}
+
+// +++++++++++++++++++++++++++++++++++++++++++++++++ ЗАХВАТ И ВОСПРОИЗВЕДЕНИЕ +++++++++++++++++++++++++++++++++++++
+void communicationengine::startCapture(const QString& path) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "startCapture", Qt::QueuedConnection,
+                                                                     Q_ARG(QString, path));
+                return;
+            }
+
+    if (!m_udpClient) {
+        emit errorOccurred("UDPClient не инициализирован");
+        return;
+    }
+    m_udpClient->startCapture(path);
+}
+
+void communicationengine::stopCapture() {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "stopCapture", Qt::QueuedConnection);
+                return;
+            }
+
+    if (m_udpClient) {
+        m_udpClient->stopCapture();
+    }
+}
+
+void communicationengine::replayCapture(const QString& path, double speed) {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "replayCapture", Qt::QueuedConnection,
+                                                                     Q_ARG(QString, path),
+                                                                     Q_ARG(double, speed));
+                return;
+            }
+
+    if (!m_replay) {
+        m_replay = new TrafficReplay(this);
+        connect(m_replay, &TrafficReplay::datagramReplayed,
+                this, &communicationengine::onDataReceived, Qt::DirectConnection);
+        connect(m_replay, &TrafficReplay::finished,
+                this, &communicationengine::replayFinished);
+    }
+
+    if (!m_replay->load(path)) {
+        emit errorOccurred(QString("Не удалось загрузить запись: %1").arg(m_replay->errorString()));
+        return;
+    }
+    m_replay->start(speed);
+}
+
+void communicationengine::stopReplay() {
+
+    if (QThread::currentThread() != this->thread()) {
+                QMetaObject::invokeMethod(this, "stopReplay", Qt::QueuedConnection);
+                return;
+            }
+
+    if (m_replay) {
+        m_replay->stop();
+    }
+}
@@ -2,17 +2,69 @@
 #define COMMUNICATIONENGINE_H
 
 #include <QObject>
-#include <QTimer>
-#include <QMutex>
 #include <QMap>
+#include <QSet>
+#include <QHash>
 #include <deque>
+#include <array>
+#include <vector>
 #include <list>
 #include <memory>
 #include <QVariant>
+#include <QElapsedTimer>
+#include <map>
+#include <utility>
 #include "udpclient.h"
 #include "packetbuilder.h"
 #include "commandandoperation.h"
+#include "packetpacer.h"
+#include "addressslots.h"
+#include "timerwheel.h"
+#include "rtoestimator.h"
+#include "enginemetrics.h"
+
+class TrafficReplay;
+
+// ===== ИТОГ ШИРОКОВЕЩАТЕЛЬНОЙ КОМАНДЫ =====
+// Один ТУ-запрос на битовую маску; результаты - по каждому ППБ (ключ - бит адреса)
+struct BroadcastResult {
+    TechCommand command = TechCommand::TS;
+    uint16_t requestedMask = 0;   // кому адресован запрос
+    uint16_t respondedMask = 0;   // кто ответил (OK или ошибка)
+    uint16_t okMask = 0;          // кто выполнил команду успешно
+    QMap<uint16_t, QString> messages;
+    QMap<uint16_t, QVariant> data;
+    qint64 elapsedMs = 0;
+};
+Q_DECLARE_METATYPE(BroadcastResult)
+
+// ===== ПЕРЕГРУЗКА =====
+// Что делать с новой командой, когда очередь адреса заполнена
+enum class QueueOverflowPolicy : uint8_t {
+    Reject,         // новая команда отклоняется
+    DropOldest,     // вытесняется самая старая команда младшего непустого класса
+    Coalesce        // новая сливается с такой же командой в очереди, иначе отклоняется
+};
+Q_DECLARE_METATYPE(QueueOverflowPolicy)
+
+// Очередь адреса или буфер диалога заполнены: GUI и сценарии снижают темп запросов
+struct OverloadEvent {
+    enum class Kind : uint8_t {
+        QueueRejected,      // команда не принята
+        QueueDropped,       // вытеснена ожидавшая команда (command - она)
+        QueueCoalesced,     // команда слита с такой же ради места в очереди
+        DialogBufferFull    // диалог прислал больше пакетов, чем можно буферизовать
+    };
+    Kind kind = Kind::QueueRejected;
+    uint16_t address = 0;
+    TechCommand command = TechCommand::TS;
+    int queueDepth = 0;           // команд в очереди адреса после события
+    quint64 total = 0;            // событий перегрузки с последнего сброса статистики
+};
+Q_DECLARE_METATYPE(OverloadEvent)
 
+// Состояние, очереди и контексты адресов живут в AddressSlots и используются только
+// из потока движка (внешние вызовы маршалятся в него), поэтому без мьютексов
 namespace Internal {
 class StateManager : public QObject {       //управляет состоянием для каждого адреса
     Q_OBJECT
@@ -28,28 +80,70 @@ public:
     void clear();
 
     QMap<uint16_t, PPBState> states() const {
-        QMutexLocker locker(&m_mutex);
-        return m_states;
+        QMap<uint16_t, PPBState> result;
+        m_states.forEach([&result](uint16_t address, PPBState state) { result.insert(address, state); });
+        return result;
     }
 
 signals:
     void stateChanged(uint16_t address, PPBState state);
 
 private:
-    mutable QMutex m_mutex;
-    QMap<uint16_t, PPBState> m_states;
+    AddressSlots<PPBState> m_states;
 };
 
+// Очередь адреса - по классам CommandPriority: следующей уходит первая команда
+// непустого класса с наименьшим номером, внутри класса - по порядку постановки
 class CommandQueue : public QObject {           // управляет очередями комад для каждого адреса
     Q_OBJECT
 public:
     explicit CommandQueue(QObject* parent = nullptr);
     ~CommandQueue();
 
-    void enqueue(uint16_t address, std::unique_ptr<PPBCommand> cmd);
-    std::unique_ptr<PPBCommand> dequeue(uint16_t address);
+    struct QueuedCommand {
+        const PPBCommand* command = nullptr;
+        int64_t enqueuedAtNs = 0;
+        int64_t classSinceNs = 0;      // когда попала в текущий класс
+        QVector<quint64> requestIds;   // пусто у анонимных запросов (executeCommand)
+    };
+
+    enum class EnqueueResult {
+        Queued,
+        Coalesced,           // слита с такой же идемпотентной командой
+        CoalescedOverflow,   // очередь полна, слита по политике Coalesce
+        DroppedOldest,       // очередь полна, ради нее вытеснена команда (dropped)
+        Rejected             // очередь полна, команда не принята
+    };
+
+    // Лимит глубины очереди адреса; команды Control принимаются сверх лимита
+    static constexpr int DEFAULT_DEPTH = 64;
+    void setDefaultLimit(int depth, QueueOverflowPolicy policy);   // depth <= 0 - без лимита
+    void setLimit(uint16_t address, int depth, QueueOverflowPolicy policy);
+
+    // enqueuedAtNs - когда команда принята движком (wallClockNs), для задержки команда->провод.
+    // Идемпотентная команда (CommandDescriptor::idempotent), уже ждущая в очереди адреса,
+    // второй раз не ставится: requestId присоединяется к ней, класс - старший из двух
+    EnqueueResult enqueue(uint16_t address, const PPBCommand* cmd, int64_t enqueuedAtNs = 0,
+                          CommandPriority priority = CommandPriority::Interactive, quint64 requestId = 0,
+                          QueuedCommand* dropped = nullptr);
+    // requestIds - все ожидающие результата этой команды (без нулевых)
+    const PPBCommand* dequeue(uint16_t address, int64_t* enqueuedAtNs = nullptr,
+                              QVector<quint64>* requestIds = nullptr);
+    const PPBCommand* front(uint16_t address) const;   // следующая команда без извлечения
+    CommandPriority frontPriority(uint16_t address) const;   // Count - очередь пуста
+    int count(uint16_t address, CommandPriority priority) const;
     bool isEmpty(uint16_t address) const;
-    void clear();
+    int size(uint16_t address) const;
+    void clear(QVector<quint64>* requestIds = nullptr);   // requestIds - брошенные ожидающие
+    quint64 coalescedCount() const { return m_coalesced; }
+
+    // Старение против голодания: команда, прождавшая agingMs в своем классе, переходит
+    // в класс выше (и так до Control). 0 - без старения.
+    // age применяется при диспетчеризации адреса, front и dequeue от времени не зависят
+    static constexpr int DEFAULT_AGING_MS = 2000;
+    void setAgingMs(int agingMs);
+    int agingMs() const { return static_cast<int>(m_agingNs / 1000000); }
+    int age(uint16_t address, int64_t nowNs);   // сколько команд повышено
 
 
 
@@ -60,10 +154,44 @@ signals:
     void queueChanged(uint16_t address, int size);
 
 private:
-    mutable QMutex m_mutex;
-
-    // Используем std::unordered_map
-    std::unordered_map<uint16_t, std::deque<std::unique_ptr<PPBCommand>>> m_queues;
+    struct Limit {
+        int depth = DEFAULT_DEPTH;
+        QueueOverflowPolicy policy = QueueOverflowPolicy::Reject;
+    };
+    // Очередь одного класса - кольцо на векторе. Емкость после роста сохраняется, поэтому
+    // постановка и извлечение в установившемся режиме не выделяют память (std::deque
+    // выделяет и освобождает блоки по мере продвижения головы)
+    class ClassQueue {
+    public:
+        bool empty() const { return m_size == 0; }
+        size_t size() const { return m_size; }
+        QueuedCommand& operator[](size_t index) { return m_items[(m_head + index) % m_items.size()]; }
+        const QueuedCommand& operator[](size_t index) const { return m_items[(m_head + index) % m_items.size()]; }
+        QueuedCommand& front() { return m_items[m_head]; }
+        const QueuedCommand& front() const { return m_items[m_head]; }
+
+        void push_back(QueuedCommand&& item);
+        void pop_front();
+        void erase(size_t index);   // хвост сдвигается, порядок сохраняется
+
+    private:
+        std::vector<QueuedCommand> m_items;   // освобожденные позиции сброшены в QueuedCommand()
+        size_t m_head = 0;
+        size_t m_size = 0;
+    };
+    using ClassQueues = std::array<ClassQueue, size_t(CommandPriority::Count)>;
+
+    static int firstClass(const ClassQueues& queues);   // -1 - все классы пусты
+    static int totalSize(const ClassQueues& queues);
+    // Присоединить запрос к ожидающей команде cmd; false - такой в очереди нет
+    static bool attach(ClassQueues& queues, const PPBCommand* cmd, CommandPriority priority,
+                       int64_t enqueuedAtNs, quint64 requestId);
+
+    AddressSlots<ClassQueues> m_queues;
+    int64_t m_agingNs = int64_t(DEFAULT_AGING_MS) * 1000000;
+    quint64 m_coalesced = 0;           // запросов, слитых с уже ожидающими
+    Limit m_defaultLimit;
+    QHash<uint16_t, Limit> m_limits;   // лимиты отдельных ППБ
 };
 
 } // namespace Internal, хранение и управление очередями и состояниями по каждому адресу, используется движком
@@ -74,17 +202,34 @@ class communicationengine : public QObject
 
 private:
 
+    // Id таймера колеса, которым владеет контекст: при перемещении у источника обнуляется,
+    // чтобы перемещенный контекст не отменил чужой дедлайн
+    struct OwnedTimer {
+        TimerWheel::TimerId id = 0;
+
+        OwnedTimer() = default;
+        OwnedTimer(TimerWheel::TimerId value) : id(value) {}
+        OwnedTimer(OwnedTimer&& other) noexcept : id(std::exchange(other.id, 0)) {}
+        OwnedTimer& operator=(OwnedTimer&& other) noexcept {
+            id = std::exchange(other.id, 0);
+            return *this;
+        }
+        operator TimerWheel::TimerId() const { return id; }
+    };
+
     struct PPBContext {
-        std::unique_ptr<PPBCommand> currentCommand;
-        QVector<QByteArray> receivedData;
+        const PPBCommand* currentCommand = nullptr;   // общий экземпляр CommandFactory::get
+        DialogBuffer receivedData;                    // пакеты ответа по счетчикам
+        StreamingAnalyzer stream;                     // статистика ответа по мере приема
         QVector<DataPacket> generatedPackets;
         QVector<DataPacket> receivedPackets;
         int packetsExpected = 0;
         int packetsReceived = 0;
         bool waitingForOk = false;
         bool operationCompleted = false;
-        // В PPBContext
-        std::unique_ptr<QTimer> operationTimer;
+        // Дедлайны в колесе таймеров движка
+        OwnedTimer operationTimer;       // таймаут операции
+        OwnedTimer packetTimer;          // таймаут между пакетами данных
         //результаты парсинга от командды
 
         QString parsedMessage;           // Сообщение от команды
@@ -93,44 +238,28 @@ private:
         QVector<DataPacket> parsedPackets; // Для команд с пакетами (PRBS_S2M)
 
          PPBState stateBeforeCommand = PPBState::Idle;  // Состояние перед началом команды
+        bool awaitingBulk = false;       // OK получен, ждем окончания пакетной передачи
 
-        // Конструкторы и операторы
-        PPBContext() = default;
-        PPBContext(const PPBContext&) = delete;
-        PPBContext& operator=(const PPBContext&) = delete;
-        PPBContext(PPBContext&& other) noexcept
-            : currentCommand(std::move(other.currentCommand))
-            , receivedData(std::move(other.receivedData))
-            , generatedPackets(std::move(other.generatedPackets))
-            , receivedPackets(std::move(other.receivedPackets))
-            , packetsExpected(other.packetsExpected)
-            , packetsReceived(other.packetsReceived)
-            , waitingForOk(other.waitingForOk)
-            //, operationTimer(other.operationTimer)
-        {
-            other.operationTimer = nullptr;
-        }
+        // Метки времени диалога (нс, часы wallClockNs) для гистограмм задержек
+        int64_t sentAtNs = 0;            // запрос ушел в сокет
+        int64_t okAtNs = 0;              // принят OK
+        int64_t lastDataAtNs = 0;        // принят последний пакет данных
 
-        PPBContext& operator=(PPBContext&& other) noexcept {
-            if (this != &other) {
+        quint64 hostDrops = 0;           // датаграмм, отброшенных ядром хоста во время диалога
+        int64_t requestedAtNs = 0;       // команда принята движком (executeCommand/очередь)
 
+        // Дозапрос пропусков недостающих счетчиков receivedData
+        bool gapRepair = false;
+        int repairAttempts = 0;          // повторов запроса в этой операции
 
-                currentCommand = std::move(other.currentCommand);
-                receivedData = std::move(other.receivedData);
-                generatedPackets = std::move(other.generatedPackets);
-                receivedPackets = std::move(other.receivedPackets);
-                packetsExpected = other.packetsExpected;
-                packetsReceived = other.packetsReceived;
-                waitingForOk = other.waitingForOk;
-              //  operationTimer = other.operationTimer;
-                other.operationTimer = nullptr;
-            }
-            return *this;
-        }
+        QVector<quint64> requestIds;     // кто ждет итог (submitCommand и слитые с ним)
 
-        ~PPBContext() {
-            if (operationTimer) operationTimer->stop();
-        }
+        // Конструкторы и операторы: перемещаются все поля, id таймеров остаются только у нового владельца
+        PPBContext() = default;
+        PPBContext(const PPBContext&) = delete;
+        PPBContext& operator=(const PPBContext&) = delete;
+        PPBContext(PPBContext&&) = default;
+        PPBContext& operator=(PPBContext&&) = default;
 
         // Метод для сброса результатов парсинга
         void clearParseResults() {
@@ -148,11 +277,31 @@ public:
     void setCommandInterface(CommandInterface* cmdInterface) {
         m_commandInterface = cmdInterface;
     }
+
+    // Дедлайны колеса таймеров: сколько взведено, насколько опаздывают (только из потока движка)
+    TimerWheelStats timerStats() const { return m_timers->stats(); }
+    // Счетчики исходов и гистограммы задержек по адресам и командам (очередь, OK, данные) - из любого потока
+    const EngineMetrics& metrics() const { return m_metrics; }
+
+    // Часы таймаутов, автоопроса и меток времени (nullptr - системные). Вызывать из потока
+    // движка до подключения: пока взведен хоть один таймер, часы не меняются (false).
+    // С VirtualClock и UDPClient в режиме петли движок работает в виртуальном времени;
+    // темп пакетной передачи (PacketPacer) остается в настоящем
+    bool setClock(EngineClock* clock);
+    EngineClock* clock() const { return m_timers->clock(); }
 public slots:
     // Основные методы
     bool connectToPPB(uint16_t address, const QString& ip, quint16 port);
     void disconnect();
     void executeCommand(TechCommand cmd, uint16_t address);
+    // То же с номером запроса (не 0): итог придет сигналом requestCompleted с этим номером,
+    // в том числе если запрос слит с такой же идемпотентной командой в очереди
+    void submitCommand(TechCommand cmd, uint16_t address, quint64 requestId);
+
+    // Одна команда на битовую маску ППБ (0xFFFF - все): ответы собираются по битам,
+    // итог - сигналом broadcastCompleted, когда ответят все или истечет таймаут.
+    // Команды с передачей данных в ППБ (PRBS_M2S, VOLUME) так не выполняются
+    void executeBroadcast(TechCommand cmd, uint16_t mask);
 
 
     // ФУ команды
@@ -162,9 +311,79 @@ public slots:
 
     void sendPacketInternal(const QByteArray& packet, const QString& description);
 
+    // Собственная конечная точка ППБ (свой IP/порт вместо общего бриджа). Диалоги с данными
+    // с разными конечными точками идут параллельно; пустой ip - вернуть адрес подключения
+    void setPPBEndpoint(uint16_t address, const QString& ip, quint16 port);
+
     void setCommandParseResult(uint16_t address, bool success, const QString& message);
     void setCommandParseData(uint16_t address, const QVariant& data);
 
+    // Пакетная передача последовательности пакетов данных (PRBS_M2S, VOLUME).
+    // Вызывается из колбэков команд в потоке движка
+    void sendDataPackets(const QVector<DataPacket>& packets);
+
+    // Интервал между пакетами данных, мс (0 - без паузы, ограничено только каналом).
+    // Обертка над setPacketRate(1000 / intervalMs, 1)
+    void setDataPacketInterval(int intervalMs);
+
+    // Темп пакетов данных (пакетов/с, <= 0 - без ограничения) и допустимая пачка:
+    // по умолчанию и для бриджа, через который сейчас работает address (общий на все его ППБ)
+    void setPacketRate(double packetsPerSecond, int burst = 1);
+    void setBridgePacketRate(uint16_t address, double packetsPerSecond, int burst = 1);
+
+    // Окно конвейера: сколько команд без фазы данных (TC, CLEAN, ...) может одновременно
+    // ждать OK от одного ППБ. 1 - строго по одной (по умолчанию). OK относятся к запросам
+    // по порядку отправки, команды завершаются в том же порядке
+    void setPipelineWindow(int window);
+    void setAddressPipelineWindow(uint16_t address, int window);
+
+    // Автоопрос состояния (TS) адреса с периодом intervalMs; <= 0 - выключить.
+    // Запрос уходит, только если ППБ готов и для него нет команд в очереди
+    void setAutoPoll(uint16_t address, int intervalMs);
+
+    // Таймауты OK и фазы данных по сглаженному времени ответа адреса и команды
+    // (RFC 6298) в пределах [floorMs, ceilingMs]; выключено (по умолчанию) - табличные таймауты команд
+    void setAdaptiveTimeouts(bool enabled, int floorMs = 100, int ceilingMs = 10000);
+
+    // Дозапрос пропущенных пакетов (PRBS_S2M): в конце пачки или по таймауту между пакетами
+    // запрос повторяется до maxAttempts раз, принимаются только недостающие счетчики.
+    // По умолчанию выключено - потери в PRBS сами являются результатом измерения
+    void setGapRepair(bool enabled, int maxAttempts = 2);
+
+    // Старение команд в очереди адреса: через agingMs ожидания команда переходит
+    // в класс выше (автоопрос и пакетные не голодают). 0 - строгие приоритеты,
+    // по умолчанию - CommandQueue::DEFAULT_AGING_MS
+    void setQueueAging(int agingMs);
+    // Пакетная передача в ППБ уступает команде оператора или управления для того же ППБ
+    // между пакетами и продолжается после нее
+    void setBulkPreemption(bool enabled);
+
+    // Лимит очереди команд (по умолчанию и для отдельного ППБ) и что делать при переполнении.
+    // depth <= 0 - без лимита. Каждое переполнение - сигнал overloaded
+    void setQueueLimit(int depth, QueueOverflowPolicy policy = QueueOverflowPolicy::Reject);
+    void setAddressQueueLimit(uint16_t address, int depth,
+                              QueueOverflowPolicy policy = QueueOverflowPolicy::Reject);
+    // Сколько пакетов данных (с повторами и лишними счетчиками) принимается в одном диалоге;
+    // дальше - перегрузка, операция с ошибкой
+    void setDialogPacketLimit(int packets);
+
+    // Досрочное прекращение приема длинного ответа: BER выше maxBer (после достаточной
+    // выборки) или пропуск больше maxMissingRun пакетов подряд. 0 - порог выключен (по умолчанию)
+    void setStreamLimits(double maxBer, int maxMissingRun);
+
+    // Захват трафика UDPClient в pcap-ng
+    void startCapture(const QString& path);
+    void stopCapture();
+
+    // Воспроизведение записи вместо сокета: датаграммы идут в onDataReceived.
+    // speed: 1.0 - как записано, 0 - максимально быстро
+    void replayCapture(const QString& path, double speed = 1.0);
+    void stopReplay();
+
+    // Отчет по задержкам приходит сигналом latencyReportReady
+    void requestLatencyReport();
+    void resetLatencyStats();
+
 
 
 signals:
@@ -172,6 +391,7 @@ signals:
     void connected();
     void disconnected();
     void commandCompleted(bool success, const QString& report, TechCommand command);
+    void requestCompleted(quint64 requestId, bool success, const QString& report, TechCommand command);
 
     void errorOccurred(const QString& error);
    // void logMessage(const QString& message);
@@ -182,48 +402,223 @@ signals:
 
     void commandDataParsed(uint16_t address, const QVariant& data, TechCommand command);
 
+    void bulkTransferFinished(uint16_t address, int sent, int total);
+    void pacerStatsUpdated(const PacerStats& stats);   // темп, джиттер, опоздания
+    void latencyReportReady(const QString& report);
+    void replayFinished(int datagrams);
+    void broadcastCompleted(const BroadcastResult& result);
+    void overloaded(const OverloadEvent& event);
+    // Ход приема длинного ответа: каждые STREAM_PROGRESS_STEP пакетов и по завершении
+    void streamProgress(uint16_t address, TechCommand command, const StreamStats& stats);
+
 private slots:
     void onDataReceived(const QByteArray& data, const QHostAddress& sender, quint16 port);
+    void onDatagramsReceived(const RxBatch& batch);
     void onNetworkError(const QString& error);
+    void onReceiveOverflow(quint64 newDrops, quint64 totalDrops);
     void onOperationTimeout(uint16_t address);
-    void processCommandQueue();
+    void dispatchPending();   // отправка команд из очередей адресов, отмеченных scheduleDispatch
     void sendFUReceiveImpl(uint16_t address, uint8_t period, const QByteArray& fuData = QByteArray());
+    void onPacerWindow(uint16_t address, int packets);
 private:
-    void executeCommandImmediately(uint16_t address, std::unique_ptr<PPBCommand> command);
+    void executeCommandImmediately(uint16_t address, const PPBCommand* command,
+                                   int64_t requestedAtNs = 0,
+                                   const QVector<quint64>& requestIds = QVector<quint64>());
+    void completeRequests(const QVector<quint64>& requestIds, bool success,
+                          const QString& report, TechCommand command);
+    // Постановка в очередь с учетом лимита; false - новой записи нет (слита или отклонена).
+    // rejected - команда не принята совсем (слитая с ожидающей принятой считается)
+    bool enqueueCommand(uint16_t address, const PPBCommand* command, int64_t requestedAtNs,
+                        CommandPriority priority, quint64 requestId, bool* rejected = nullptr);
+    void reportOverload(OverloadEvent::Kind kind, uint16_t address, TechCommand command);
+    void processDatagram(const uint8_t* data, int size, int64_t rxTimestampNs,
+                         quint64 senderKey);   // разбор одной датаграммы (общий для обоих режимов приема)
+    void finishReceive();   // конец разбора принятого: отложенные в нем проверки очередей
+    void recordLatency(uint16_t address, const PPBContext& context);
     void processPPBResponse(const PPBResponse& response);
     void processBridgeResponse(const BridgeResponse& response);
-    void processDataPacket(const DataPacket& packet);
+    void processDataPacket(const DataPacket& packet, quint64 senderKey);
+    const QString& allPacketsMessage(int packets);   // итог полного ответа, строка одна на число пакетов
     void clearContext(uint16_t address);
     PPBContext* getContext(uint16_t address);
+    void armOperationTimer(uint16_t address, PPBContext* context, int timeoutMs);   // (пере)взвод таймаута операции
+    int phaseTimeoutMs(uint16_t address, const PPBCommand* command, RtoEstimator::Phase phase) const;
+    int64_t clockNs() const { return m_timers->clock()->wallNs(); }   // метка времени по часам движка
+    void cancelTimers(PPBContext* context);
+    void onPacketTimeout(uint16_t address);
+    void processCountedPacket(uint16_t address, PPBContext* context, const DataPacket& packet);
+    bool tryGapRepair(uint16_t address, PPBContext* context);   // true - запрос повторен, ждем пакеты
+    bool streamPacket(uint16_t address, PPBContext* context, const DataPacket& packet);   // false - прием прерван
+    void onAutoPoll(uint16_t address);
 
     //машина состояний
-    void transitionState(uint16_t addres, PPBState newState, const QString& reason); //явная смена состояния
-    void completeOperation(uint16_t address, bool success, const QString& message);  // Универсальное завершение операции (успешное или с ошибкой)
+    // явная смена состояния; reason - постоянная строка (UTF-8), detail - подробности, если есть
+    void transitionState(uint16_t addres, PPBState newState, const char* reason,
+                         const QString& detail = QString());
+    void completeOperation(uint16_t address, bool success, const QString& message,
+                           bool timedOut = false);  // Универсальное завершение операции (успешное или с ошибкой)
     QString stateToString(PPBState state) const;// Вспомогательная функция для логирования состояний
     void processNextCommandForAddress(uint16_t address); // Обработка следующей команды для указанного адреса
+    void scheduleDispatch(uint16_t address);             // Проверить очередь адреса на ближайшем проходе цикла событий
 
     bool canExecuteCommand(uint16_t address, const PPBCommand* command) const;
-private:
-
-    UDPClient* m_udpClient;
-    QTimer* m_queueTimer;
-    QTimer* m_timeoutTimer;
-  std::unordered_map<uint16_t, PPBContext> m_contexts;
+    static CommandPriority priorityOf(const PPBCommand* command);
 
+    // Конечные точки и диалоги с данными
+    struct Endpoint {
+        QHostAddress host;
+        quint16 port = 0;
+    };
+    Endpoint endpointFor(uint16_t address) const;
+    static quint64 endpointKey(const QHostAddress& host, quint16 port);
+    static quint64 endpointKey(quint32 ipv4, quint16 port) { return (quint64(ipv4) << 16) | port; }
+    quint64 bridgeKey(uint16_t address) const {
+        const Endpoint endpoint = endpointFor(address);
+        return endpointKey(endpoint.host, endpoint.port);
+    }
+    // Запрос - записью на стеке, description - имя команды (UTF-8): отправка без QByteArray и QString
+    void sendToAddress(uint16_t address, const BaseRequest& request, const char* description);
+    void reserveDataDialog(uint16_t address);   // запрос с данными отправлен, ждем OK
+    void beginDataDialog(uint16_t address);     // OK получен, идут пакеты данных
+    void endDataDialog(uint16_t address);
+    void openDataDialog(uint16_t address, bool receiving);
+    uint16_t dataDialogAddress(quint64 senderKey) const;   // 0 - пакеты данных сейчас не ждем
+    bool isAwaitingOk(uint16_t address) const;   // команда или конвейер адреса ждут OK
+
+    // Конвейер команд без данных
+    int pipelineWindow(uint16_t address) const;
+    bool isPipelinable(uint16_t address, const PPBCommand* command) const;
+    void sendPipelined(uint16_t address);                            // следующая команда очереди - в конвейер
+    bool processPipelineResponse(const PPBResponse& response);      // true - OK относился к конвейеру
+    void checkPipelineTimeouts();
+    void armPipelineTimer();
+
+    // Широковещательная команда
+    bool processBroadcastResponse(const PPBResponse& response);   // true - ответ относился к ней
+    bool processBroadcastData(const DataPacket& packet);
+    void finishBroadcastUnit(uint16_t bit, bool success, const QString& message);
+    void finishBroadcast(const QString& reason);
+
+    // Пакетная передача
+    void sendBulkChunk(int maxPackets);
+    void finishBulkTransfer(bool success);
+    bool preemptBulk(uint16_t address);    // true - передача приостановлена ради команды выше классом
+    void resumeBulk(uint16_t address);
+private:
 
+    // Текущая пакетная передача данных в ППБ
+    struct BulkTransfer {
+        bool active = false;
+        uint16_t address = 0;
+        QVector<DataPacket> packets;
+        int next = 0;                  // индекс следующего пакета
+        bool paused = false;           // уступила команде выше классом
+        PPBContext suspended;          // операция, начавшая передачу, на время паузы
+    };
 
-    //QMutex m_contextsMutex;
+    UDPClient* m_udpClient;
+    AddressSlots<PPBContext> m_contexts;
     uint16_t m_currentAddress;
     QString m_currentIP;
+    QHostAddress m_currentHost;        // m_currentIP, разобранный один раз при подключении
     quint16 m_currentPort;
-    mutable QMutex m_mutex;
     Internal::StateManager* m_stateManager;
     Internal::CommandQueue* m_commandQueue;
     CommandInterface* m_commandInterface;
 
-    uint16_t m_activeDataAddress = 0;  // Какой ППБ сейчас отправляет данные
-    bool m_waitingForData = false;     // Ожидаем ли данные вообще
-    mutable QMutex m_activeDataMutex;              // Мьютекс для защиты глобальных переменных
+    // Пакет данных не несет адреса ППБ: источник определяется по конечной точке отправителя,
+    // поэтому на одну конечную точку (например, общий бридж) - не больше одного диалога.
+    // Диалог занимает точку с отправки запроса: вторая команда с данными ждет, даже пока
+    // OK первой еще не пришел
+    QHash<uint16_t, Endpoint> m_endpoints;   // ППБ с собственной конечной точкой
+    struct DataDialog {
+        quint64 endpoint;                    // endpointKey отправителя
+        uint16_t address;                    // ППБ, от которого ждем данные
+        bool receiving;                      // false - ждем OK, пакеты данных еще не идут
+    };
+    std::vector<DataDialog> m_dataDialogs;   // не больше 16 - линейный поиск без хеширования
+    const DataDialog* findDataDialog(quint64 endpoint) const;
+
+    uint16_t m_callbackAddress = 0;    // Адрес, чей колбэк команды сейчас выполняется
+
+    // Диспетчеризация по событиям (постановка в очередь, переход в Ready/Idle) вместо опроса очередей
+    QHash<int, QString> m_allPacketsMessages;   // allPacketsMessage: опрос не форматирует итог заново
+    AddressSet m_dispatchPending;          // адреса, чьи очереди надо проверить
+    AddressSet m_blockedByDataDialog;      // ждут окончания чужого диалога с данными
+    bool m_dispatchScheduled = false;      // dispatchPending уже поставлен в цикл событий
+    int m_receiveDepth = 0;                // идет разбор принятых датаграмм - очереди проверяются в его конце
+
+    BulkTransfer m_bulk;
+    PacketPacer* m_pacer = nullptr;
+    bool m_bulkPreemption = false;
+
+    // Текущая широковещательная команда. Пакеты данных без адреса относятся к ППБ,
+    // чей OK пришел раньше остальных ожидающих (бридж пересылает ответы ППБ по очереди)
+    struct BroadcastUnit {
+        bool responded = false;               // пришел OK или ошибка
+        bool done = false;
+        bool success = false;
+        DialogBuffer receivedData;
+        QString message;
+        QVariant parsedData;
+        bool parsedSet = false;
+        bool parsedSuccess = false;
+    };
+    struct Broadcast {
+        bool active = false;
+        const PPBCommand* command = nullptr;
+        uint16_t mask = 0;
+        uint16_t pending = 0;                 // биты, от которых ждем OK или данные
+        std::map<uint16_t, BroadcastUnit> units;
+        std::deque<uint16_t> dataOrder;       // ответившие OK, ждущие данных, в порядке OK
+        int64_t startedAtNs = 0;              // по часам движка
+    };
+    Broadcast m_broadcast;
+
+    // Команды в полете по конвейеру адреса (в порядке отправки)
+    struct InFlight {
+        const PPBCommand* command = nullptr;
+        int64_t requestedAtNs = 0;
+        int64_t sentAtNs = 0;
+        int64_t deadlineNs = 0;
+        QVector<quint64> requestIds;
+    };
+    AddressSlots<std::deque<InFlight>> m_pipelines;
+    int m_pipelineWindow = 1;
+    QHash<uint16_t, int> m_pipelineWindows;   // окна отдельных ППБ
+    TimerWheel::TimerId m_pipelineTimer = 0;   // ближайший таймаут среди всех конвейеров
+    TimerWheel::TimerId m_broadcastTimer = 0;
+    BroadcastUnit* m_broadcastCallbackUnit = nullptr;   // куда пишут setCommandParse* из колбэка
+
+    // Буфер приема растет при потерях на хосте во время диалогов с данными
+    static constexpr int MIN_RX_BUFFER_GROW_BYTES = 128 * 1024;
+    static constexpr int MAX_RX_BUFFER_BYTES = 4 * 1024 * 1024;
+
+    TrafficReplay* m_replay = nullptr;
+
+    // Все дедлайны движка: таймауты операций и пакетов, конвейер, широковещание, автоопрос
+    TimerWheel* m_timers = nullptr;
+    AddressSlots<TimerWheel::TimerId> m_autoPolls;
+
+    // Задержки (в метриках) и адаптивные таймауты по ним
+    RtoEstimator m_rto;
+    EngineMetrics m_metrics;
+
+    // Дозапрос пропусков пакетов данных
+    bool m_gapRepair = false;
+    int m_gapRepairMaxAttempts = 2;
+    quint64 m_repairedPackets = 0;     // пакетов, принятых повторными запросами
+
+    // Перегрузка
+    static constexpr int DEFAULT_DIALOG_PACKET_LIMIT = 4096;
+    int m_dialogPacketLimit = DEFAULT_DIALOG_PACKET_LIMIT;
+    quint64 m_overloadEvents = 0;
+
+    // Анализ ответа на лету
+    static constexpr int STREAM_PROGRESS_STEP = 16;
+    StreamingAnalyzer::Limits m_streamLimits;
+    int64_t m_lastSendNs = 0;          // метка последней отправки sendPacketInternal
+    int64_t m_rxTimestampNs = 0;       // метка приема разбираемой датаграммы
 
 
 };
@@ -0,0 +1,80 @@
+#include "dialogbuffer.h"
+#include <QStringList>
+#include <algorithm>
+
+void DialogBuffer::reset(int expected)
+{
+    m_present.reset();
+    m_expected = std::clamp(expected, 0, CAPACITY);
+    m_received = 0;
+    m_duplicates = 0;
+    m_outOfRange = 0;
+}
+
+DialogBuffer::Placement DialogBuffer::place(const DataPacket& packet)
+{
+    const int counter = packet.counter;
+    if (counter >= m_expected) {
+        ++m_outOfRange;
+        return Placement::OutOfRange;
+    }
+    if (m_present.test(counter)) {
+        ++m_duplicates;
+        return Placement::Duplicate;
+    }
+
+    m_packets[counter] = packet;
+    m_present.set(counter);
+    ++m_received;
+    return Placement::Stored;
+}
+
+bool DialogBuffer::hasLeading(int count) const
+{
+    if (count > m_expected) {
+        return false;
+    }
+    for (int counter = 0; counter < count; ++counter) {
+        if (!m_present.test(counter)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString DialogBuffer::missingRanges() const
+{
+    QStringList ranges;
+    int counter = 0;
+    while (counter < m_expected) {
+        if (m_present.test(counter)) {
+            ++counter;
+            continue;
+        }
+        const int first = counter;
+        while (counter < m_expected && !m_present.test(counter)) {
+            ++counter;
+        }
+        ranges << (counter - 1 == first ? QString::number(first)
+                                        : QString("%1-%2").arg(first).arg(counter - 1));
+    }
+    return ranges.join(", ");
+}
+
+QVector<DataPacket> DialogBuffer::packets() const
+{
+    QVector<DataPacket> result;
+    result.reserve(m_received);
+    forEach([&result](const DataPacket& packet) { result.append(packet); });
+    return result;
+}
+
+QVector<QByteArray> DialogBuffer::toByteArrays() const
+{
+    QVector<QByteArray> result;
+    result.reserve(m_received);
+    forEach([&result](const DataPacket& packet) {
+        result.append(QByteArray(reinterpret_cast<const char*>(&packet), sizeof(DataPacket)));
+    });
+    return result;
+}
@@ -0,0 +1,69 @@
+#ifndef DIALOGBUFFER_H
+#define DIALOGBUFFER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <array>
+#include <bitset>
+#include "ppbprotocol.h"
+
+// ===== БУФЕР ПАКЕТОВ ОТВЕТА =====
+// Пакеты данных одного ответа ППБ лежат на позиции своего счетчика в массиве фиксированного
+// размера (счетчик - 1 байт, ответ не длиннее 256 пакетов) - буфер живет внутри контекста,
+// диалог не выделяет память. CRC проверяется один раз при разборе датаграммы; здесь
+// отсекаются повторы и счетчики за пределами ответа. Команды разбирают ответ прямо отсюда.
+class DialogBuffer
+{
+public:
+    static constexpr int CAPACITY = 256;
+
+    enum class Placement : uint8_t {
+        Stored,      // новый счетчик
+        Duplicate,   // счетчик уже принят - пакет отброшен
+        OutOfRange   // счетчик не меньше ожидаемого числа пакетов - пакет отброшен
+    };
+
+    // Новый ответ из expected пакетов (не больше CAPACITY); счетчики повторов и лишних обнуляются
+    void reset(int expected = 0);
+    Placement place(const DataPacket& packet);
+
+    int expected() const { return m_expected; }
+    int received() const { return m_received; }
+    bool isEmpty() const { return m_received == 0; }
+    bool isComplete() const { return m_received >= m_expected; }
+    int duplicates() const { return m_duplicates; }
+    int outOfRange() const { return m_outOfRange; }
+    int arrivals() const { return m_received + m_duplicates + m_outOfRange; }
+
+    bool contains(int counter) const { return counter >= 0 && counter < CAPACITY && m_present.test(counter); }
+    // Пакет со счетчиком counter; читать только после contains(counter)
+    const DataPacket& at(int counter) const { return m_packets[counter]; }
+    // Приняты пакеты 0..count-1
+    bool hasLeading(int count) const;
+
+    // Принятые пакеты по возрастанию счетчика: function(const DataPacket&)
+    template <typename Function>
+    void forEach(Function function) const
+    {
+        for (int counter = 0; counter < m_expected; ++counter) {
+            if (m_present.test(counter)) {
+                function(m_packets[counter]);
+            }
+        }
+    }
+
+    QString missingRanges() const;            // "3-5, 17"
+    QVector<DataPacket> packets() const;      // копия принятых пакетов (анализатор)
+    QVector<QByteArray> toByteArrays() const; // сырые пакеты для сигналов GUI
+
+private:
+    std::array<DataPacket, CAPACITY> m_packets;   // читаются только позиции из m_present
+    std::bitset<CAPACITY> m_present;
+    int m_expected = 0;
+    int m_received = 0;
+    int m_duplicates = 0;
+    int m_outOfRange = 0;
+};
+
+#endif // DIALOGBUFFER_H
@@ -0,0 +1,98 @@
+#include "engineclock.h"
+#include "rxdatagram.h"
+#include <QCoreApplication>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+constexpr int64_t NS_PER_MS = 1000000;
+}
+
+// ===== SystemClock =====
+
+SystemClock::SystemClock(QObject* parent)
+    : QObject(parent)
+{
+    m_clock.start();
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, [this]() { wake(); });
+}
+
+int64_t SystemClock::wallNs() const
+{
+    return wallClockNs();
+}
+
+void SystemClock::wakeAt(int64_t deadlineNs)
+{
+    const int64_t waitNs = deadlineNs - nowNs();
+    m_timer->start(waitNs <= 0 ? 0 : static_cast<int>((waitNs + NS_PER_MS - 1) / NS_PER_MS));
+}
+
+void SystemClock::cancelWake()
+{
+    m_timer->stop();
+}
+
+// ===== VirtualClock =====
+
+VirtualClock::VirtualClock(int64_t wallStartNs)
+    : m_wallStartNs(wallStartNs != 0 ? wallStartNs : wallClockNs())
+{
+}
+
+void VirtualClock::wakeAt(int64_t deadlineNs)
+{
+    cancelWake();
+    const EventId id = callAt(deadlineNs, [this]() {
+        m_wake = Key(-1, 0);
+        wake();
+    });
+    m_wake = Key(std::max(deadlineNs, m_nowNs), id);
+}
+
+void VirtualClock::cancelWake()
+{
+    if (m_wake.second != 0) {
+        m_events.erase(m_wake);
+        m_wake = Key(-1, 0);
+    }
+}
+
+VirtualClock::EventId VirtualClock::callAt(int64_t atNs, Callback callback)
+{
+    const EventId id = m_nextId++;
+    m_events.emplace(Key(std::max(atNs, m_nowNs), id), std::move(callback));
+    return id;
+}
+
+quint64 VirtualClock::runUntil(int64_t untilNs)
+{
+    const quint64 before = m_eventsRun;
+
+    // Отложенное до запуска (подключение, настройки) - в текущий момент
+    deliverPosted();
+
+    while (!m_events.empty() && m_events.begin()->first.first <= untilNs) {
+        auto first = m_events.begin();
+        m_nowNs = first->first.first;
+        Callback callback = std::move(first->second);
+        m_events.erase(first);
+
+        callback();
+        ++m_eventsRun;
+        deliverPosted();
+    }
+
+    m_nowNs = std::max(m_nowNs, untilNs);
+    return m_eventsRun - before;
+}
+
+void VirtualClock::deliverPosted()
+{
+    // Отложенное удаление объектов сюда не входит - оно остается циклу событий
+    QCoreApplication::sendPostedEvents(nullptr, 0);
+}
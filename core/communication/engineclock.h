@@ -0,0 +1,109 @@
+#ifndef ENGINECLOCK_H
+#define ENGINECLOCK_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <utility>
+
+class QTimer;
+
+// ===== ЧАСЫ ДВИЖКА =====
+// Источник времени движка и будильник его колеса таймеров (один будильник на часы).
+// SystemClock - настоящее время и QTimer. VirtualClock - время, которое двигает владелец:
+// между событиями оно сразу перескакивает к следующему, поэтому многочасовой прогон
+// с имитатором ППБ идет секунды, а порядок событий от запуска к запуску один и тот же.
+// Все вызовы - из потока движка.
+class EngineClock
+{
+public:
+    using Callback = std::function<void()>;
+
+    virtual ~EngineClock() = default;
+
+    // Монотонное время для дедлайнов, нс
+    virtual int64_t nowNs() const = 0;
+    // Метки отправки/приема, нс от эпохи (у системных часов - wallClockNs, как SO_TIMESTAMPNS)
+    virtual int64_t wallNs() const = 0;
+    // Метки ядра на датаграммах в виртуальном времени не годятся - движок ставит свои
+    virtual bool isVirtual() const { return false; }
+
+    // Будильник: обработчик сработает не раньше deadlineNs (по nowNs); новый вызов заменяет прежний
+    void setWakeHandler(Callback handler) { m_wakeHandler = std::move(handler); }
+    virtual void wakeAt(int64_t deadlineNs) = 0;
+    virtual void cancelWake() = 0;
+
+protected:
+    void wake() { if (m_wakeHandler) m_wakeHandler(); }
+
+private:
+    Callback m_wakeHandler;
+};
+
+// Настоящее время: QElapsedTimer для дедлайнов, точный QTimer для будильника
+class SystemClock : public QObject, public EngineClock
+{
+    Q_OBJECT
+
+public:
+    explicit SystemClock(QObject* parent = nullptr);
+
+    int64_t nowNs() const override { return m_clock.nsecsElapsed(); }
+    int64_t wallNs() const override;
+
+    void wakeAt(int64_t deadlineNs) override;
+    void cancelWake() override;
+
+private:
+    QElapsedTimer m_clock;
+    QTimer* m_timer = nullptr;
+};
+
+// Виртуальное время: стоит на месте, пока его не сдвинет runUntil/runFor.
+// Кроме будильника колеса таймеров держит события сценария (ответы имитатора ППБ и т.п.);
+// события одного момента выполняются в порядке постановки
+class VirtualClock : public EngineClock
+{
+public:
+    using EventId = quint64;
+
+    // wallStartNs - метка времени, соответствующая нулю виртуальных часов (0 - текущий момент)
+    explicit VirtualClock(int64_t wallStartNs = 0);
+
+    int64_t nowNs() const override { return m_nowNs; }
+    int64_t wallNs() const override { return m_wallStartNs + m_nowNs; }
+    bool isVirtual() const override { return true; }
+
+    void wakeAt(int64_t deadlineNs) override;
+    void cancelWake() override;
+
+    // Событие в момент atNs (не раньше текущего); из события можно ставить новые
+    EventId callAt(int64_t atNs, Callback callback);
+    EventId callAfter(int64_t delayNs, Callback callback) { return callAt(m_nowNs + delayNs, std::move(callback)); }
+
+    // Выполняет события до момента untilNs включительно и оставляет время на untilNs.
+    // После каждого события доставляются отложенные вызовы Qt потока (QueuedConnection) -
+    // они происходят в тот же виртуальный момент. Возвращает число выполненных событий
+    quint64 runUntil(int64_t untilNs);
+    quint64 runFor(int64_t durationNs) { return runUntil(m_nowNs + durationNs); }
+
+    bool hasPending() const { return !m_events.empty(); }
+    int64_t nextEventNs() const { return m_events.empty() ? -1 : m_events.begin()->first.first; }
+    quint64 eventsRun() const { return m_eventsRun; }
+
+private:
+    using Key = std::pair<int64_t, EventId>;   // момент, порядок постановки
+
+    static void deliverPosted();
+
+    std::map<Key, Callback> m_events;
+    int64_t m_nowNs = 0;
+    int64_t m_wallStartNs = 0;
+    EventId m_nextId = 1;
+    Key m_wake{-1, 0};                         // событие будильника, id 0 - не взведен
+    quint64 m_eventsRun = 0;
+};
+
+#endif // ENGINECLOCK_H
@@ -0,0 +1,303 @@
+#include "enginemetrics.h"
+#include "commandandoperation.h"
+#include <QDateTime>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <map>
+
+EngineMetrics::EngineMetrics()
+    : m_cells(new Cells)
+{
+    reset();
+}
+
+int EngineMetrics::addressSlot(uint16_t address)
+{
+    if (address == 0 || (address & (address - 1)) != 0) {
+        return ADDRESS_SLOTS - 1;
+    }
+    return int(qCountTrailingZeroBits(address));
+}
+
+int EngineMetrics::bucketIndex(uint64_t valueUs)
+{
+    // Линейная часть: 0..15 мкс
+    if (valueUs < uint64_t(2 * SUB_BUCKETS)) {
+        return int(valueUs);
+    }
+
+    // Оставляем 4 значащих бита (8..15), shift >= 1
+    const int msb = 63 - int(qCountLeadingZeroBits(quint64(valueUs)));
+    const int shift = msb - SUB_BUCKET_BITS;
+    if (shift > MAX_SHIFT) {
+        return BUCKET_COUNT - 1;
+    }
+    return shift * SUB_BUCKETS + int(valueUs >> shift);
+}
+
+int64_t EngineMetrics::bucketUpperBoundUs(int index)
+{
+    if (index < 2 * SUB_BUCKETS) {
+        return index;
+    }
+    const int shift = index / SUB_BUCKETS - 1;
+    const int64_t top = index % SUB_BUCKETS + SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+void EngineMetrics::record(uint16_t address, TechCommand command, Stage stage, int64_t latencyNs)
+{
+    // Часы отправки и приема могли разойтись на доли микросекунды
+    const uint64_t valueUs = latencyNs > 0 ? uint64_t(latencyNs / 1000) : 0;
+
+    Histogram& histogram = cell(address, command).latency[int(stage)];
+    bump(histogram.buckets[bucketIndex(valueUs)]);
+    bump(histogram.sumUs, valueUs);
+    if (valueUs > histogram.maxUs.load(std::memory_order_relaxed)) {
+        histogram.maxUs.store(valueUs, std::memory_order_relaxed);
+    }
+    // Счетчик последним: читатель, увидевший count, почти всегда видит и корзину
+    bump(histogram.count);
+}
+
+void EngineMetrics::reset()
+{
+    for (Cell& cell : *m_cells) {
+        for (auto& counter : cell.counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (Histogram& histogram : cell.latency) {
+            for (auto& bucket : histogram.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sumUs.store(0, std::memory_order_relaxed);
+            histogram.maxUs.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+EngineMetrics::Snapshot EngineMetrics::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.takenAtMs = QDateTime::currentMSecsSinceEpoch();
+
+    for (int index = 0; index < int(m_cells->size()); ++index) {
+        const Cell& cell = (*m_cells)[index];
+
+        Snapshot::Row row;
+        bool used = false;
+        for (int counter = 0; counter < COUNTER_COUNT; ++counter) {
+            row.counters[counter] = cell.counters[counter].load(std::memory_order_relaxed);
+            used = used || row.counters[counter] != 0;
+        }
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            const Histogram& source = cell.latency[stage];
+            Snapshot::Histogram& target = row.latency[stage];
+            target.count = source.count.load(std::memory_order_relaxed);
+            if (target.count == 0) {
+                continue;
+            }
+            for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+                target.buckets[bucket] = source.buckets[bucket].load(std::memory_order_relaxed);
+            }
+            target.sumUs = source.sumUs.load(std::memory_order_relaxed);
+            target.maxUs = source.maxUs.load(std::memory_order_relaxed);
+            used = true;
+        }
+        if (!used) {
+            continue;
+        }
+
+        const int slot = index / COMMAND_SLOTS;
+        row.address = slot < ADDRESS_SLOTS - 1 ? uint16_t(1u << slot) : 0;
+        row.command = static_cast<TechCommand>(index % COMMAND_SLOTS);
+        snapshot.rows.append(row);
+    }
+    return snapshot;
+}
+
+// ===== Snapshot =====
+
+qint64 EngineMetrics::Snapshot::Histogram::percentileUs(double p) const
+{
+    // Корзины могли быть прочитаны чуть позже count - считаем по их собственной сумме
+    quint64 total = 0;
+    for (quint64 bucket : buckets) {
+        total += bucket;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const quint64 rank = std::max<quint64>(1, quint64(std::clamp(p, 0.0, 1.0) * total + 0.5));
+    quint64 seen = 0;
+    for (int index = 0; index < BUCKET_COUNT; ++index) {
+        seen += buckets[index];
+        if (seen >= rank) {
+            return std::min<qint64>(bucketUpperBoundUs(index), qint64(maxUs));
+        }
+    }
+    return qint64(maxUs);
+}
+
+void EngineMetrics::Snapshot::Histogram::merge(const Histogram& other)
+{
+    for (int index = 0; index < BUCKET_COUNT; ++index) {
+        buckets[index] += other.buckets[index];
+    }
+    count += other.count;
+    sumUs += other.sumUs;
+    maxUs = std::max(maxUs, other.maxUs);
+}
+
+QString EngineMetrics::Snapshot::Histogram::summary() const
+{
+    auto ms = [](qint64 us) { return QString::number(us / 1000.0, 'f', 3); };
+
+    return QString("n=%1 p50=%2 p90=%3 p99=%4 max=%5 мс")
+        .arg(count)
+        .arg(ms(percentileUs(0.50)))
+        .arg(ms(percentileUs(0.90)))
+        .arg(ms(percentileUs(0.99)))
+        .arg(ms(qint64(maxUs)));
+}
+
+QString EngineMetrics::Snapshot::toText() const
+{
+    if (rows.isEmpty()) {
+        return "Метрики движка: нет данных";
+    }
+
+    QStringList lines;
+    lines << "Метрики движка (отправлено/OK/ошибка/таймаут/частично; p50/p99 мс):";
+    for (const Row& row : rows) {
+        QString line = QString("  0x%1 %2 %3/%4/%5/%6/%7")
+                           .arg(row.address, 4, 16, QChar('0'))
+                           .arg(CommandFactory::commandName(row.command), -10)
+                           .arg(row.counter(Counter::Sent))
+                           .arg(row.counter(Counter::Ok))
+                           .arg(row.counter(Counter::Error))
+                           .arg(row.counter(Counter::Timeout))
+                           .arg(row.counter(Counter::Partial));
+
+        static const char* const stageNames[STAGE_COUNT] = {"очередь", "OK", "данные"};
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            const Histogram& histogram = row.latency[stage];
+            if (histogram.count == 0) {
+                continue;
+            }
+            line += QString(", %1 %2/%3")
+                        .arg(stageNames[stage])
+                        .arg(histogram.percentileUs(0.50) / 1000.0, 0, 'f', 3)
+                        .arg(histogram.percentileUs(0.99) / 1000.0, 0, 'f', 3);
+        }
+        lines << line;
+    }
+    return lines.join('\n');
+}
+
+QString EngineMetrics::Snapshot::toCsv() const
+{
+    QStringList lines;
+    QString header = "timestamp_ms,address,command,sent,ok,error,timeout,partial";
+    for (const char* stage : {"queue", "ok", "data"}) {
+        header += QString(",%1_n,%1_p50_us,%1_p99_us,%1_max_us").arg(stage);
+    }
+    lines << header;
+
+    for (const Row& row : rows) {
+        QString line = QString("%1,0x%2,%3")
+                           .arg(takenAtMs)
+                           .arg(row.address, 4, 16, QChar('0'))
+                           .arg(CommandFactory::commandName(row.command));
+        for (quint64 counter : row.counters) {
+            line += QString(",%1").arg(counter);
+        }
+        for (const Histogram& histogram : row.latency) {
+            line += QString(",%1,%2,%3,%4")
+                        .arg(histogram.count)
+                        .arg(histogram.percentileUs(0.50))
+                        .arg(histogram.percentileUs(0.99))
+                        .arg(histogram.maxUs);
+        }
+        lines << line;
+    }
+    return lines.join('\n') + '\n';
+}
+
+bool EngineMetrics::Snapshot::hasLatency() const
+{
+    for (const Row& row : rows) {
+        for (const Histogram& histogram : row.latency) {
+            if (histogram.count > 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+QString EngineMetrics::Snapshot::latencyReport() const
+{
+    if (!hasLatency()) {
+        return "Задержки: нет данных";
+    }
+
+    const int queueWait = int(Stage::QueueWait);
+    const int okArrival = int(Stage::OkArrival);
+    const int dataCompletion = int(Stage::DataCompletion);
+
+    QStringList lines;
+    lines << "Задержки по адресам (запрос->OK | OK->последний пакет):";
+
+    // Сводка по командам для всех адресов; упорядочено - отчет стабилен
+    std::map<uint8_t, std::array<Histogram, STAGE_COUNT>> commands;
+    for (const Row& row : rows) {
+        std::array<Histogram, STAGE_COUNT>& total = commands[static_cast<uint8_t>(row.command)];
+        for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+            total[stage].merge(row.latency[stage]);
+        }
+
+        if (row.latency[okArrival].count == 0 && row.latency[dataCompletion].count == 0) {
+            continue;
+        }
+        QString line = QString("  0x%1 %2: %3")
+                           .arg(row.address, 4, 16, QChar('0'))
+                           .arg(CommandFactory::commandName(row.command), -10)
+                           .arg(row.latency[okArrival].summary());
+        if (row.latency[dataCompletion].count > 0) {
+            line += QString(" | %1").arg(row.latency[dataCompletion].summary());
+        }
+        lines << line;
+    }
+
+    lines << "Сводка по командам:";
+    for (const auto& command : commands) {
+        const std::array<Histogram, STAGE_COUNT>& total = command.second;
+        if (total[okArrival].count == 0 && total[dataCompletion].count == 0) {
+            continue;
+        }
+        QString line = QString("  %1: %2")
+                           .arg(CommandFactory::commandName(static_cast<TechCommand>(command.first)), -10)
+                           .arg(total[okArrival].summary());
+        if (total[dataCompletion].count > 0) {
+            line += QString(" | %1").arg(total[dataCompletion].summary());
+        }
+        lines << line;
+    }
+
+    // Ожидание в очереди движка: от executeCommand до отправки запроса
+    lines << "Команда->провод (очередь движка):";
+    for (const auto& command : commands) {
+        const Histogram& queued = command.second[queueWait];
+        if (queued.count > 0) {
+            lines << QString("  %1: %2")
+                         .arg(CommandFactory::commandName(static_cast<TechCommand>(command.first)), -10)
+                         .arg(queued.summary());
+        }
+    }
+
+    return lines.join('\n');
+}
@@ -0,0 +1,135 @@
+#ifndef ENGINEMETRICS_H
+#define ENGINEMETRICS_H
+
+#include <QString>
+#include <QVector>
+#include <QMetaType>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "ppbprotocol.h"
+
+// ===== МЕТРИКИ ДВИЖКА =====
+// Счетчики исходов и гистограммы задержек по каждому адресу и команде - единственное
+// место, куда движок пишет задержки; отчет по задержкам строится из снимка.
+// Пишет только поток движка, читать можно из любого потока без блокировок (снимок).
+// Все ячейки - атомики с relaxed-порядком в заранее выделенном массиве: запись -
+// несколько загрузок и сохранений без lock-префикса, без поиска и аллокаций.
+// Снимок не атомарен как целое: счетчики одной строки могут разойтись на единицы.
+class EngineMetrics
+{
+public:
+    enum class Counter : uint8_t {
+        Sent,       // запрос ушел в линию
+        Ok,         // выполнена полностью
+        Error,      // ошибка ППБ, разбора или перегрузка
+        Timeout,    // нет ни OK, ни данных
+        Partial,    // таймаут после части данных
+        Count
+    };
+
+    enum class Stage : uint8_t {
+        QueueWait,       // постановка в очередь -> отправка
+        OkArrival,       // отправка -> OK
+        DataCompletion,  // OK -> последний пакет данных
+        Count
+    };
+
+    // Логарифмически-линейные корзины: до 16 мкс - по 1 мкс, дальше каждая степень двойки
+    // делится на 8 корзин (погрешность перцентиля не хуже ~6%); последняя - от 2^32 мкс
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_SHIFT = 28;
+    static constexpr int BUCKET_COUNT = SUB_BUCKETS * (MAX_SHIFT + 2);
+    static constexpr int ADDRESS_SLOTS = 17;     // 16 одиночных адресов + прочие (маски)
+    static constexpr int COMMAND_SLOTS = 16;
+    static constexpr int COUNTER_COUNT = int(Counter::Count);
+    static constexpr int STAGE_COUNT = int(Stage::Count);
+
+    EngineMetrics();
+    EngineMetrics(const EngineMetrics&) = delete;
+    EngineMetrics& operator=(const EngineMetrics&) = delete;
+
+    // Только из потока движка
+    void count(uint16_t address, TechCommand command, Counter counter)
+    {
+        bump(cell(address, command).counters[int(counter)]);
+    }
+    void record(uint16_t address, TechCommand command, Stage stage, int64_t latencyNs);
+    void reset();
+
+    static int bucketIndex(uint64_t valueUs);
+    static int64_t bucketUpperBoundUs(int index);
+
+    struct Snapshot;
+    Snapshot snapshot() const;   // из любого потока
+
+private:
+    struct Histogram {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets;
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sumUs;
+        std::atomic<uint64_t> maxUs;
+    };
+
+    struct Cell {
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters;
+        std::array<Histogram, STAGE_COUNT> latency;
+    };
+
+    // Писатель один - атомарное приращение (lock xadd) не нужно
+    static void bump(std::atomic<uint64_t>& value, uint64_t delta = 1)
+    {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static int addressSlot(uint16_t address);
+    Cell& cell(uint16_t address, TechCommand command)
+    {
+        return (*m_cells)[addressSlot(address) * COMMAND_SLOTS + (static_cast<uint8_t>(command) & 0x0F)];
+    }
+
+    // ~1.6 МБ - в куче: движок бывает и на стеке
+    using Cells = std::array<Cell, ADDRESS_SLOTS * COMMAND_SLOTS>;
+    std::unique_ptr<Cells> m_cells;
+};
+
+// Снимок метрик: только строки, где что-то было. Адрес 0 - широковещательные и маски
+struct EngineMetrics::Snapshot {
+    struct Histogram {
+        std::array<quint64, EngineMetrics::BUCKET_COUNT> buckets{};
+        quint64 count = 0;
+        quint64 sumUs = 0;
+        quint64 maxUs = 0;
+
+        qint64 percentileUs(double p) const;   // верхняя граница корзины
+        qint64 meanUs() const { return count ? qint64(sumUs / count) : 0; }
+        void merge(const Histogram& other);
+        QString summary() const;               // "n=.. p50=.. p90=.. p99=.. max=.. мс"
+    };
+
+    struct Row {
+        uint16_t address = 0;
+        TechCommand command = TechCommand::TS;
+        std::array<quint64, EngineMetrics::COUNTER_COUNT> counters{};
+        std::array<Histogram, EngineMetrics::STAGE_COUNT> latency;
+
+        quint64 counter(EngineMetrics::Counter which) const { return counters[int(which)]; }
+    };
+
+    QVector<Row> rows;
+    qint64 takenAtMs = 0;      // QDateTime::currentMSecsSinceEpoch()
+
+    QString toText() const;    // таблица для отчета
+    QString toCsv() const;     // строка на адрес и команду, задержки - p50/p99/max в мкс
+
+    // Отчет по задержкам: строка на адрес/команду, сводка по командам, очередь движка
+    bool hasLatency() const;
+    QString latencyReport() const;
+};
+
+using EngineMetricsSnapshot = EngineMetrics::Snapshot;
+Q_DECLARE_METATYPE(EngineMetricsSnapshot)
+
+#endif // ENGINEMETRICS_H
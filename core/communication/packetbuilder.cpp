@@ -1,6 +1,7 @@
 #include "packetbuilder.h"
-#include <QDebug>
 #include <QRandomGenerator>
+#include <QtAlgorithms>
+#include <utility>
 
 QByteArray PacketBuilder::createTURequest(uint16_t address, TechCommand command)
 {
@@ -8,6 +9,11 @@ QByteArray PacketBuilder::createTURequest(uint16_t address, TechCommand command)
                          Sign::TU, 0, nullptr);
 }
 
+BaseRequest PacketBuilder::makeTURequest(uint16_t address, TechCommand command)
+{
+    return makeRequest(address, static_cast<uint8_t>(command), Sign::TU, 0, nullptr);
+}
+
 QByteArray PacketBuilder::createFURequest(uint16_t address, uint8_t period,
                                           const uint8_t fuData[3])
 {
@@ -60,72 +66,61 @@ QByteArray PacketBuilder::createFUReceiveRequest(uint16_t address, uint8_t perio
 // === парсинг ТУ ОК пакета ===
 bool PacketBuilder::parsePPBResponse(const QByteArray& data, PPBResponse& response)
 {
-    if (data.size() != 4) {
-        qDebug() << "Неверный размер ответа ППБ:" << data.size() << "ожидается 4";
+    return parsePPBResponse(reinterpret_cast<const uint8_t*>(data.constData()), data.size(), response);
+}
+
+bool PacketBuilder::parsePPBResponse(const uint8_t* data, int size, PPBResponse& response)
+{
+    // Разбор вызывается на каждую датаграмму (в диалоге - и на пакеты данных, см. processDatagram),
+    // поэтому молча: об ошибке разбора пишет вызывающий, через журнал с уровнем
+    if (size != 4) {
         return false;
     }
 
     // Копируем данные
-    memcpy(&response, data.constData(), sizeof(PPBResponse));
-
-
+    memcpy(&response, data, sizeof(PPBResponse));
 
     // Проверяем CRC
-    uint8_t calculatedCrc = calculateCRC8((uint8_t*)data.constData(), 3);
-    if (calculatedCrc != response.crc) {
-        qDebug() << "Ошибка CRC в ответе ППБ: рассчитано" << calculatedCrc
-                 << "получено" << response.crc;
+    if (calculateCRC8(data, 3) != response.crc) {
         return false;
     }
 
     response.address= (((uint16_t)data[0]<<8) | data[1]);
-    qDebug() << "Ответ от адреса: 0x" << QString::number(response.address, 16).right(4).toUpper()
-             << " (битовая маска)";
-    if (response.address & 0x0001) qDebug() << "  - ППБ1";
-    if (response.address & 0x0002) qDebug() << "  - ППБ2";
-    if (response.address & 0x0004) qDebug() << "  - ППБ3";
-    if (response.address & 0x0008) qDebug() << "  - ППБ4";
-    if (response.address & 0x0010) qDebug() << "  - ППБ5";
-    if (response.address & 0x0020) qDebug() << "  - ППБ6";
-    if (response.address & 0x0040) qDebug() << "  - ППБ7";
-    if (response.address & 0x0080) qDebug() << "  - ППБ8";
-
     return true;
 }
 // === парсинг ФУ ОК пакета
 bool PacketBuilder::parseBridgeResponse(const QByteArray& data, BridgeResponse& response)
 {
-    if (data.size() != 4) {
-        qDebug() << "Неверный размер ответа бриджа:" << data.size() << "ожидается 4";
+    return parseBridgeResponse(reinterpret_cast<const uint8_t*>(data.constData()), data.size(), response);
+}
+
+bool PacketBuilder::parseBridgeResponse(const uint8_t* data, int size, BridgeResponse& response)
+{
+    if (size != 4) {
         return false;
     }
 
-    memcpy(&response, data.constData(), sizeof(BridgeResponse));
-
-    qDebug() << "Ответ бриджа: адрес=" << response.address
-             << ", команда=0x" << QString::number(response.command, 16)
-             << ", статус=" << (int)response.status;
-
+    memcpy(&response, data, sizeof(BridgeResponse));
     return true;
 }
 
 
 bool PacketBuilder::parseDataPacket(const QByteArray& data, DataPacket& packet) {
-    if (data.size() != static_cast<int>(sizeof(DataPacket))) {
-        qDebug() << "Неверный размер пакета данных:" << data.size()
-                 << "ожидается:" << sizeof(DataPacket);
+    return parseDataPacket(reinterpret_cast<const uint8_t*>(data.constData()), data.size(), packet);
+}
+
+bool PacketBuilder::parseDataPacket(const uint8_t* data, int size, DataPacket& packet) {
+    if (size != static_cast<int>(sizeof(DataPacket))) {
         return false;
     }
 
-    memcpy(&packet, data.constData(), sizeof(DataPacket));
+    memcpy(&packet, data, sizeof(DataPacket));
 
     // Проверяем CRC
     uint8_t dataForCRC[3] = {packet.data[0], packet.data[1], packet.counter};
     uint8_t calculatedCrc = calculateCRC8(dataForCRC, 3);
 
     if (calculatedCrc != packet.crc) {
-        qDebug() << "Ошибка CRC в пакете данных: рассчитано" << calculatedCrc
-                 << "получено" << packet.crc;
         return false;
     }
 
@@ -147,6 +142,62 @@ DataPacket PacketBuilder::createTestDataPacket(uint8_t data1, uint8_t data2, uin
     return packet;
 }
 
+// ===== ОТВЕТЫ ППБ =====
+
+QByteArray PacketBuilder::encodePPBResponse(uint16_t address, uint8_t status)
+{
+    uint8_t logical[4];
+    logical[0] = static_cast<uint8_t>(address >> 8);
+    logical[1] = static_cast<uint8_t>(address);
+    logical[2] = status;
+    logical[3] = calculateCRC8(logical, 3);
+
+    std::swap(logical[0], logical[1]);
+    return QByteArray(reinterpret_cast<const char*>(logical), sizeof(logical));
+}
+
+QByteArray PacketBuilder::encodeBridgeResponse(uint16_t address, uint8_t command, uint8_t status)
+{
+    BridgeResponse response;
+    response.address = address;
+    response.command = command;
+    response.status = status;
+
+    QByteArray data(reinterpret_cast<const char*>(&response), sizeof(response));
+    std::swap(data[0], data[1]);
+    return data;
+}
+
+// Тестер переставляет байты 0/1 каждой принятой датаграммы - заранее переставляем обратно
+QByteArray PacketBuilder::encodeDataPacket(const DataPacket& packet)
+{
+    QByteArray data(reinterpret_cast<const char*>(&packet), sizeof(packet));
+    std::swap(data[0], data[1]);
+    return data;
+}
+
+QVector<DataPacket> PacketBuilder::createStatusPackets(uint16_t address, const StatusChannel& channel1,
+                                                       const StatusChannel& channel2, uint8_t flags)
+{
+    QVector<DataPacket> packets;
+    packets.reserve(9);
+
+    const uint8_t index = static_cast<uint8_t>(qCountTrailingZeroBits(address));
+    packets.append(createTestDataPacket(index, 0x01, 0));                       // адрес, питание в норме
+
+    const StatusChannel* channels[2] = {&channel1, &channel2};
+    for (int channel = 0; channel < 2; ++channel) {
+        const StatusChannel& values = *channels[channel];
+        const uint8_t base = static_cast<uint8_t>(1 + channel * 3);
+        packets.append(createTestDataPacket(values.powerW & 0xFF, values.powerW >> 8, base));
+        packets.append(createTestDataPacket(values.temperature, values.vswr10, base + 1));
+        packets.append(createTestDataPacket(0x01, 0x00, base + 2));             // канал исправен
+    }
+    packets.append(createTestDataPacket(0x10, 0x00, 7));                        // длительность импульса
+    packets.append(createTestDataPacket(0x02, flags, 8));                       // скважность, флаги
+    return packets;
+}
+
 
 
 
@@ -155,6 +206,13 @@ DataPacket PacketBuilder::createTestDataPacket(uint8_t data1, uint8_t data2, uin
 QByteArray PacketBuilder::createRequest(uint16_t address, uint8_t command,
                                         Sign sign, uint8_t period,
                                         const uint8_t fuData[3])
+{
+    const BaseRequest request = makeRequest(address, command, sign, period, fuData);
+    return QByteArray(reinterpret_cast<const char*>(&request), sizeof(request));
+}
+
+BaseRequest PacketBuilder::makeRequest(uint16_t address, uint8_t command,
+                                       Sign sign, uint8_t period, const uint8_t fuData[3])
 {
     BaseRequest request;
 
@@ -169,5 +227,5 @@ QByteArray PacketBuilder::createRequest(uint16_t address, uint8_t command,
         memset(request.fu_data, 0, 3);
     }
 
-    return QByteArray(reinterpret_cast<const char*>(&request), sizeof(request));
+    return request;
 }
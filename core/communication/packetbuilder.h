@@ -33,6 +33,9 @@ public:
     static QByteArray createFURequest(uint16_t address, uint8_t period,
                                       const uint8_t fuData[3] = nullptr);
 
+    // Тот же TU-запрос без QByteArray - запись для UDPClient::sendDatagrams
+    static BaseRequest makeTURequest(uint16_t address, TechCommand command);
+
     // === КОНКРЕТНЫЕ КОМАНДЫ  ===
 
     // Команда TS (опрос состояния)
@@ -74,6 +77,11 @@ public:
     // Распарсить пакет данных (4 байта с CRC)
     static bool parseDataPacket(const QByteArray& data, DataPacket& packet);
 
+    // Те же разборы по сырому буферу - для пакетного приема без QByteArray
+    static bool parsePPBResponse(const uint8_t* data, int size, PPBResponse& response);
+    static bool parseBridgeResponse(const uint8_t* data, int size, BridgeResponse& response);
+    static bool parseDataPacket(const uint8_t* data, int size, DataPacket& packet);
+
     // Проверить CRC пакета данных
     static bool checkDataPacketCRC(const DataPacket& packet);
 
@@ -84,6 +92,29 @@ public:
     // Создать пакет данных для тестовой последовательности (с CRC)
     static DataPacket createTestDataPacket(uint8_t data1, uint8_t data2, uint8_t data3);
 
+    // === ОТВЕТЫ ППБ (сторона бриджа - для имитаторов) ===
+    // Байты 0/1 датаграммы переставлены так же, как их передает ППБ
+
+    // OK ППБ с CRC8: на проводе [мл, ст, статус, CRC], CRC - по [ст, мл, статус]
+    static QByteArray encodePPBResponse(uint16_t address, uint8_t status);
+
+    // Ответ бриджа на ФУ (без CRC)
+    static QByteArray encodeBridgeResponse(uint16_t address, uint8_t command, uint8_t status);
+
+    // Пакет данных ответа
+    static QByteArray encodeDataPacket(const DataPacket& packet);
+
+    // Значения канала в тех. состоянии
+    struct StatusChannel {
+        uint16_t powerW = 500;
+        uint8_t temperature = 36;
+        uint8_t vswr10 = 12;         // КСВН * 10
+    };
+
+    // Тех. состояние (ответ на TS): адрес и питание, по три пакета на канал, длительность, скважность и флаги
+    static QVector<DataPacket> createStatusPackets(uint16_t address, const StatusChannel& channel1,
+                                                   const StatusChannel& channel2, uint8_t flags = 0);
+
 
 
     // Проверить последовательность пакетов (сравнить отправленные и полученные)
@@ -109,6 +140,8 @@ private:
     static QByteArray createRequest(uint16_t address, uint8_t command,
                                     Sign sign, uint8_t period = 0,
                                     const uint8_t fuData[3] = nullptr);
+    static BaseRequest makeRequest(uint16_t address, uint8_t command,
+                                   Sign sign, uint8_t period, const uint8_t fuData[3]);
 };
 
 #endif // PACKETBUILDER_H
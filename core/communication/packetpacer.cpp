@@ -0,0 +1,282 @@
+#include "packetpacer.h"
+#include <QTimer>
+#include <QSocketNotifier>
+#include <algorithm>
+#include <cmath>
+
+#ifdef Q_OS_LINUX
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+#include "../logging/logging_unified.h"
+
+PacketPacer::PacketPacer(QObject* parent)
+    : QObject(parent)
+{
+    m_jitterNs.reserve(JITTER_WINDOW);
+    m_clock.start();
+
+#ifdef Q_OS_LINUX
+    m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timerFd >= 0) {
+        m_timerNotifier = new QSocketNotifier(m_timerFd, QSocketNotifier::Read, this);
+        connect(m_timerNotifier, &QSocketNotifier::activated, this, &PacketPacer::onTimerFired);
+        return;
+    }
+    LOG_CAT_WARNING("Engine", "timerfd недоступен, используется QTimer");
+#endif
+
+    m_fallbackTimer = new QTimer(this);
+    m_fallbackTimer->setSingleShot(true);
+    m_fallbackTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_fallbackTimer, &QTimer::timeout, this, &PacketPacer::onTimerFired);
+}
+
+PacketPacer::~PacketPacer()
+{
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        delete m_timerNotifier;
+        m_timerNotifier = nullptr;
+        ::close(m_timerFd);
+        m_timerFd = -1;
+    }
+#endif
+}
+
+void PacketPacer::setDefaultRate(double packetsPerSecond, int burst)
+{
+    m_defaultBucket.rate = qMax(0.0, packetsPerSecond);
+    m_defaultBucket.burst = qMax(1, burst);
+}
+
+void PacketPacer::setRate(quint64 bridge, double packetsPerSecond, int burst)
+{
+    Bucket& bucket = m_buckets[bridge];
+    bucket.rate = qMax(0.0, packetsPerSecond);
+    bucket.burst = qMax(1, burst);
+}
+
+double PacketPacer::rate(quint64 bridge) const
+{
+    auto it = m_buckets.find(bridge);
+    return it != m_buckets.end() ? it->second.rate : m_defaultBucket.rate;
+}
+
+PacketPacer::Bucket& PacketPacer::bucketFor(quint64 bridge)
+{
+    auto it = m_buckets.find(bridge);
+    if (it == m_buckets.end()) {
+        it = m_buckets.emplace(bridge, m_defaultBucket).first;
+    }
+    return it->second;
+}
+
+qint64 PacketPacer::monotonicNs() const
+{
+#ifdef Q_OS_LINUX
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+#else
+    return m_clock.nsecsElapsed();
+#endif
+}
+
+void PacketPacer::start(quint64 bridge, uint16_t address)
+{
+    Bucket& bucket = bucketFor(bridge);
+    if (bucket.rate <= 0.0) {
+        LOG_CAT_WARNING("Engine", QString("Темп для 0x%1 не задан").arg(address, 4, 16, QChar('0')));
+        return;
+    }
+
+    const qint64 now = monotonicNs();
+
+    m_active = true;
+    m_address = address;
+    m_bridge = bridge;
+    m_periodNs = qMax<qint64>(1, qint64(1e9 / bucket.rate));
+    m_startNs = now;
+    m_slot = 0;
+    m_nextDeadlineNs = now;
+    m_lastStatsNs = now;
+
+    // Ведро полное: первая пачка уходит сразу
+    bucket.tokens = bucket.burst;
+    bucket.lastRefillNs = now;
+
+    m_sent = 0;
+    m_lateSends = 0;
+    m_firstSendNs = 0;
+    m_lastSendNs = 0;
+    m_jitterNs.clear();
+    m_jitterPos = 0;
+    m_jitterMaxNs = 0;
+
+    LOG_CAT_DEBUG("Engine", QString("Старт для 0x%1: %2 пак/с, пачка %3, период %4 мкс")
+                  .arg(address, 4, 16, QChar('0'))
+                  .arg(bucket.rate)
+                  .arg(bucket.burst)
+                  .arg(m_periodNs / 1000.0, 0, 'f', 1));
+
+    armTimer(m_nextDeadlineNs);
+}
+
+void PacketPacer::stop()
+{
+    if (!m_active) {
+        return;
+    }
+
+    m_active = false;
+
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        itimerspec disarm = {};
+        timerfd_settime(m_timerFd, 0, &disarm, nullptr);
+    }
+#endif
+    if (m_fallbackTimer) {
+        m_fallbackTimer->stop();
+    }
+
+    emit statsUpdated(stats());
+}
+
+void PacketPacer::consume(int packets)
+{
+    if (!m_active || packets <= 0) {
+        return;
+    }
+
+    Bucket& bucket = bucketFor(m_bridge);
+    bucket.tokens = qMax(0.0, bucket.tokens - packets);
+
+    const qint64 now = monotonicNs();
+    if (m_sent == 0) {
+        m_firstSendNs = now;
+    }
+    m_lastSendNs = now;
+    m_sent += packets;
+}
+
+void PacketPacer::armTimer(qint64 deadlineNs)
+{
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        // Нулевое значение выключает таймер - дедлайн не раньше 1 нс
+        deadlineNs = qMax<qint64>(1, deadlineNs);
+        itimerspec spec = {};
+        spec.it_value.tv_sec = deadlineNs / 1000000000LL;
+        spec.it_value.tv_nsec = deadlineNs % 1000000000LL;
+        if (timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+            LOG_CAT_ERROR("Engine", "Не удалось взвести timerfd");
+        }
+        return;
+    }
+#endif
+    const qint64 waitNs = deadlineNs - monotonicNs();
+    const int waitMs = waitNs > 0 ? int((waitNs + 999999) / 1000000) : 0;
+    m_fallbackTimer->start(waitMs);
+}
+
+void PacketPacer::onTimerFired()
+{
+#ifdef Q_OS_LINUX
+    if (m_timerFd >= 0) {
+        uint64_t expirations = 0;
+        if (::read(m_timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            return;   // ложное пробуждение
+        }
+    }
+#endif
+
+    if (!m_active) {
+        return;
+    }
+
+    const qint64 now = monotonicNs();
+    const qint64 lateness = now - m_nextDeadlineNs;
+    recordJitter(lateness);
+
+    // Проспали следующий слот - отправка опоздала
+    if (lateness >= m_periodNs) {
+        ++m_lateSends;
+    }
+
+    // Пополнение ведра
+    Bucket& bucket = bucketFor(m_bridge);
+    bucket.tokens = qMin<double>(bucket.burst,
+                                 bucket.tokens + (now - bucket.lastRefillNs) * bucket.rate / 1e9);
+    bucket.lastRefillNs = now;
+
+    // Допуск на погрешность double: токен, накопленный ровно к дедлайну, считаем целым
+    const int window = int(bucket.tokens + 1e-6);
+    const uint16_t address = m_address;
+    if (window > 0) {
+        emit sendWindow(address, window);
+    }
+
+    // Обработчик мог остановить планировщик (передача завершена)
+    if (!m_active) {
+        return;
+    }
+
+    if (now - m_lastStatsNs >= STATS_INTERVAL_NS) {
+        m_lastStatsNs = now;
+        emit statsUpdated(stats());
+    }
+
+    // Следующий абсолютный дедлайн; пропущенные слоты не догоняем - это делает ведро
+    ++m_slot;
+    m_nextDeadlineNs = m_startNs + m_slot * m_periodNs;
+    if (m_nextDeadlineNs <= now) {
+        m_slot = (now - m_startNs) / m_periodNs + 1;
+        m_nextDeadlineNs = m_startNs + m_slot * m_periodNs;
+    }
+    armTimer(m_nextDeadlineNs);
+}
+
+void PacketPacer::recordJitter(qint64 latenessNs)
+{
+    latenessNs = qAbs(latenessNs);
+
+    if (int(m_jitterNs.size()) < JITTER_WINDOW) {
+        m_jitterNs.push_back(latenessNs);
+    } else {
+        m_jitterNs[m_jitterPos] = latenessNs;
+        m_jitterPos = (m_jitterPos + 1) % JITTER_WINDOW;
+    }
+
+    m_jitterMaxNs = qMax(m_jitterMaxNs, latenessNs);
+}
+
+PacerStats PacketPacer::stats() const
+{
+    PacerStats result;
+    result.address = m_address;
+    result.targetRate = rate(m_bridge);
+    result.sent = m_sent;
+    result.lateSends = m_lateSends;
+    result.jitterMaxUs = m_jitterMaxNs / 1000;
+
+    if (m_sent > 1 && m_lastSendNs > m_firstSendNs) {
+        result.achievedRate = double(m_sent - 1) * 1e9 / double(m_lastSendNs - m_firstSendNs);
+    }
+
+    if (!m_jitterNs.empty()) {
+        std::vector<qint64> samples = m_jitterNs;
+        auto percentile = [&samples](double p) {
+            const size_t index = std::min(samples.size() - 1, size_t(std::ceil(p * samples.size())) - 1);
+            std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+            return samples[index];
+        };
+        result.jitterP50Us = percentile(0.50) / 1000;
+        result.jitterP99Us = percentile(0.99) / 1000;
+    }
+
+    return result;
+}
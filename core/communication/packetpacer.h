@@ -0,0 +1,112 @@
+#ifndef PACKETPACER_H
+#define PACKETPACER_H
+
+#include <QObject>
+#include <QMetaType>
+#include <QElapsedTimer>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+class QTimer;
+class QSocketNotifier;
+
+// Статистика темпа передачи за текущий (последний) сеанс
+struct PacerStats {
+    uint16_t address = 0;
+    double targetRate = 0.0;      // заданный темп, пакетов/с
+    double achievedRate = 0.0;    // фактический темп, пакетов/с
+    quint64 sent = 0;             // отправлено пакетов
+    quint64 lateSends = 0;        // срабатываний позже следующего слота (пропущенный слот)
+    qint64 jitterP50Us = 0;       // отклонение срабатывания от дедлайна, мкс
+    qint64 jitterP99Us = 0;
+    qint64 jitterMaxUs = 0;
+};
+Q_DECLARE_METATYPE(PacerStats)
+
+// Планировщик темпа отправки пакетов данных.
+// Дедлайны абсолютные (start + k * period), поэтому ошибка не накапливается;
+// на Linux - timerfd с TFD_TIMER_ABSTIME, иначе - точный QTimer.
+// "Ведро токенов" (темп и допустимая пачка, burst) - на бридж, то есть на конечную точку
+// host:port: ППБ одного бриджа делят его полосу, а не получают каждый свою.
+// Живет в потоке движка, все вызовы - из этого потока.
+class PacketPacer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PacketPacer(QObject* parent = nullptr);
+    ~PacketPacer() override;
+
+    // Темп по умолчанию и для отдельного бриджа (packetsPerSecond <= 0 - без ограничения).
+    // bridge - ключ конечной точки бриджа (communicationengine::endpointKey)
+    void setDefaultRate(double packetsPerSecond, int burst = 1);
+    void setRate(quint64 bridge, double packetsPerSecond, int burst = 1);
+    double rate(quint64 bridge) const;
+    bool isUnlimited(quint64 bridge) const { return rate(bridge) <= 0.0; }
+
+    // Сеанс передачи для address через бридж bridge; окна выдаются сигналом sendWindow(address)
+    void start(quint64 bridge, uint16_t address);
+    void stop();
+    bool isActive() const { return m_active; }
+
+    // Движок сообщает, сколько пакетов реально ушло из выданного окна
+    void consume(int packets);
+
+    PacerStats stats() const;
+
+    static constexpr int JITTER_WINDOW = 4096;          // последних отсчетов для процентилей
+    static constexpr qint64 STATS_INTERVAL_NS = 1000000000LL;
+
+signals:
+    // Можно отправить до packets пакетов для address (вызывать consume в обработчике)
+    void sendWindow(uint16_t address, int packets);
+    // Периодически во время сеанса и при остановке
+    void statsUpdated(const PacerStats& stats);
+
+private slots:
+    void onTimerFired();
+
+private:
+    struct Bucket {
+        double rate = 0.0;       // токенов (пакетов) в секунду
+        int burst = 1;           // емкость ведра
+        double tokens = 0.0;
+        qint64 lastRefillNs = 0;
+    };
+
+    Bucket& bucketFor(quint64 bridge);
+    void armTimer(qint64 deadlineNs);
+    void recordJitter(qint64 latenessNs);
+    qint64 monotonicNs() const;
+
+    std::unordered_map<quint64, Bucket> m_buckets;   // по бриджам
+    Bucket m_defaultBucket;
+
+    bool m_active = false;
+    uint16_t m_address = 0;
+    quint64 m_bridge = 0;
+    qint64 m_startNs = 0;
+    qint64 m_periodNs = 0;
+    qint64 m_slot = 0;                 // номер текущего слота
+    qint64 m_nextDeadlineNs = 0;
+    qint64 m_lastStatsNs = 0;
+
+    // Статистика сеанса
+    quint64 m_sent = 0;
+    quint64 m_lateSends = 0;
+    qint64 m_firstSendNs = 0;
+    qint64 m_lastSendNs = 0;
+    std::vector<qint64> m_jitterNs;    // кольцевой буфер отклонений
+    int m_jitterPos = 0;
+    qint64 m_jitterMaxNs = 0;
+
+    QElapsedTimer m_clock;             // часы для платформ без timerfd
+#ifdef Q_OS_LINUX
+    int m_timerFd = -1;
+    QSocketNotifier* m_timerNotifier = nullptr;
+#endif
+    QTimer* m_fallbackTimer = nullptr;
+};
+
+#endif // PACKETPACER_H
@@ -0,0 +1,321 @@
+#include "pcapng.h"
+#include <cstring>
+
+namespace PcapNg {
+
+namespace {
+
+template <typename T>
+void put(QByteArray& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T get(const QByteArray& in, int offset)
+{
+    T value;
+    memcpy(&value, in.constData() + offset, sizeof(T));
+    return value;
+}
+
+void pad4(QByteArray& out)
+{
+    while (out.size() % 4) {
+        out.append('\0');
+    }
+}
+
+void putOption(QByteArray& out, uint16_t code, const QByteArray& value)
+{
+    put<uint16_t>(out, code);
+    put<uint16_t>(out, static_cast<uint16_t>(value.size()));
+    out.append(value);
+    pad4(out);
+}
+
+void putEndOfOptions(QByteArray& out)
+{
+    put<uint16_t>(out, OPT_END);
+    put<uint16_t>(out, 0);
+}
+
+// Обрамление блока: тип, полная длина, тело, полная длина
+QByteArray block(uint32_t type, const QByteArray& body)
+{
+    const uint32_t total = static_cast<uint32_t>(body.size()) + 12;
+    QByteArray out;
+    out.reserve(total);
+    put<uint32_t>(out, type);
+    put<uint32_t>(out, total);
+    out.append(body);
+    put<uint32_t>(out, total);
+    return out;
+}
+
+void putBigEndian16(uint8_t* out, uint16_t value)
+{
+    out[0] = static_cast<uint8_t>(value >> 8);
+    out[1] = static_cast<uint8_t>(value);
+}
+
+void putBigEndian32(uint8_t* out, uint32_t value)
+{
+    putBigEndian16(out, static_cast<uint16_t>(value >> 16));
+    putBigEndian16(out + 2, static_cast<uint16_t>(value));
+}
+
+uint16_t getBigEndian16(const uint8_t* in)
+{
+    return static_cast<uint16_t>((in[0] << 8) | in[1]);
+}
+
+uint32_t getBigEndian32(const uint8_t* in)
+{
+    return (uint32_t(getBigEndian16(in)) << 16) | getBigEndian16(in + 2);
+}
+
+} // namespace
+
+// ===== Запись =====
+
+QByteArray sectionHeaderBlock(const QString& application)
+{
+    QByteArray body;
+    put<uint32_t>(body, BYTE_ORDER_MAGIC);
+    put<uint16_t>(body, 1);        // major
+    put<uint16_t>(body, 0);        // minor
+    put<int64_t>(body, -1);        // длина секции не известна
+    putOption(body, OPT_SHB_USERAPPL, application.toUtf8());
+    putEndOfOptions(body);
+    return block(BLOCK_SHB, body);
+}
+
+QByteArray interfaceDescriptionBlock(uint16_t linkType, uint32_t snapLength)
+{
+    QByteArray body;
+    put<uint16_t>(body, linkType);
+    put<uint16_t>(body, 0);        // reserved
+    put<uint32_t>(body, snapLength);
+    putOption(body, OPT_IF_TSRESOL, QByteArray(1, char(9)));   // 10^-9 c
+    putEndOfOptions(body);
+    return block(BLOCK_IDB, body);
+}
+
+QByteArray enhancedPacketBlock(int64_t timestampNs, const QByteArray& packet,
+                               uint32_t originalLength, uint32_t flags)
+{
+    const uint64_t timestamp = static_cast<uint64_t>(timestampNs);
+
+    QByteArray body;
+    body.reserve(20 + packet.size() + 16);
+    put<uint32_t>(body, 0);                                   // interface id
+    put<uint32_t>(body, static_cast<uint32_t>(timestamp >> 32));
+    put<uint32_t>(body, static_cast<uint32_t>(timestamp));
+    put<uint32_t>(body, static_cast<uint32_t>(packet.size()));
+    put<uint32_t>(body, originalLength);
+    body.append(packet);
+    pad4(body);
+
+    QByteArray flagValue;
+    put<uint32_t>(flagValue, flags);
+    putOption(body, OPT_EPB_FLAGS, flagValue);
+    putEndOfOptions(body);
+
+    return block(BLOCK_EPB, body);
+}
+
+QByteArray ipv4UdpPacket(const UdpEndpoints& endpoints, uint16_t ipId,
+                         const uint8_t* payload, int payloadSize, int originalPayloadSize)
+{
+    QByteArray packet(IPV4_UDP_HEADER_SIZE + payloadSize, '\0');
+    uint8_t* ip = reinterpret_cast<uint8_t*>(packet.data());
+    uint8_t* udp = ip + 20;
+
+    // IPv4
+    ip[0] = 0x45;                                                       // версия 4, IHL 5
+    putBigEndian16(ip + 2, static_cast<uint16_t>(IPV4_UDP_HEADER_SIZE + originalPayloadSize));
+    putBigEndian16(ip + 4, ipId);
+    ip[8] = 64;                                                         // TTL
+    ip[9] = 17;                                                         // UDP
+    putBigEndian32(ip + 12, endpoints.srcIPv4);
+    putBigEndian32(ip + 16, endpoints.dstIPv4);
+
+    uint32_t sum = 0;
+    for (int i = 0; i < 20; i += 2) {
+        sum += getBigEndian16(ip + i);
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    putBigEndian16(ip + 10, static_cast<uint16_t>(~sum));
+
+    // UDP (контрольная сумма 0 - не вычислялась)
+    putBigEndian16(udp + 0, endpoints.srcPort);
+    putBigEndian16(udp + 2, endpoints.dstPort);
+    putBigEndian16(udp + 4, static_cast<uint16_t>(8 + originalPayloadSize));
+
+    if (payloadSize > 0) {
+        memcpy(udp + 8, payload, payloadSize);
+    }
+    return packet;
+}
+
+// ===== Чтение =====
+
+bool parseIpv4Udp(const QByteArray& packet, UdpEndpoints& endpoints, QByteArray& payload)
+{
+    if (packet.size() < IPV4_UDP_HEADER_SIZE) {
+        return false;
+    }
+
+    const uint8_t* ip = reinterpret_cast<const uint8_t*>(packet.constData());
+    if ((ip[0] >> 4) != 4 || ip[9] != 17) {
+        return false;
+    }
+
+    const int ipHeaderSize = (ip[0] & 0x0F) * 4;
+    if (ipHeaderSize < 20 || packet.size() < ipHeaderSize + 8) {
+        return false;
+    }
+
+    const uint8_t* udp = ip + ipHeaderSize;
+    endpoints.srcIPv4 = getBigEndian32(ip + 12);
+    endpoints.dstIPv4 = getBigEndian32(ip + 16);
+    endpoints.srcPort = getBigEndian16(udp);
+    endpoints.dstPort = getBigEndian16(udp + 2);
+
+    const int udpLength = getBigEndian16(udp + 4) - 8;
+    const int available = packet.size() - ipHeaderSize - 8;
+    payload = packet.mid(ipHeaderSize + 8, qMax(0, qMin(udpLength, available)));
+    return true;
+}
+
+bool Reader::open(const QString& path)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return false;
+    }
+
+    uint32_t type = 0;
+    QByteArray body;
+    if (!readBlock(type, body) || type != BLOCK_SHB || body.size() < 16) {
+        m_error = "Файл не является pcap-ng";
+        m_file.close();
+        return false;
+    }
+
+    if (get<uint32_t>(body, 0) != BYTE_ORDER_MAGIC) {
+        m_error = "Файл записан с другим порядком байт - не поддерживается";
+        m_file.close();
+        return false;
+    }
+
+    m_error.clear();
+    return true;
+}
+
+bool Reader::readBlock(uint32_t& type, QByteArray& body)
+{
+    char head[8];
+    if (m_file.read(head, 8) != 8) {
+        return false;
+    }
+
+    uint32_t total = 0;
+    memcpy(&type, head, 4);
+    memcpy(&total, head + 4, 4);
+    if (total < 12 || total % 4) {
+        m_error = "Поврежденный блок pcap-ng";
+        return false;
+    }
+
+    body = m_file.read(total - 12);
+    char tail[4];
+    if (body.size() != int(total - 12) || m_file.read(tail, 4) != 4) {
+        m_error = "Файл pcap-ng обрезан";
+        return false;
+    }
+    return true;
+}
+
+void Reader::parseInterface(const QByteArray& body)
+{
+    if (body.size() < 8) {
+        return;
+    }
+    m_linkType = get<uint16_t>(body, 0);
+    m_tsUnitsPerSecond = 1000000;
+
+    int offset = 8;
+    while (offset + 4 <= body.size()) {
+        const uint16_t code = get<uint16_t>(body, offset);
+        const uint16_t length = get<uint16_t>(body, offset + 2);
+        if (code == OPT_END || offset + 4 + length > body.size()) {
+            break;
+        }
+        if (code == OPT_IF_TSRESOL && length >= 1) {
+            const uint8_t resolution = static_cast<uint8_t>(body[offset + 4]);
+            const int exponent = resolution & 0x7F;
+            const int64_t base = (resolution & 0x80) ? 2 : 10;
+            m_tsUnitsPerSecond = 1;
+            for (int i = 0; i < exponent && m_tsUnitsPerSecond < 1000000000000LL; ++i) {
+                m_tsUnitsPerSecond *= base;
+            }
+        }
+        offset += 4 + ((length + 3) & ~3);
+    }
+}
+
+bool Reader::next(PacketRecord& record)
+{
+    uint32_t type = 0;
+    QByteArray body;
+
+    while (readBlock(type, body)) {
+        if (type == BLOCK_IDB) {
+            parseInterface(body);
+            continue;
+        }
+        if (type != BLOCK_EPB || body.size() < 20 || m_linkType != LINKTYPE_IPV4) {
+            continue;
+        }
+
+        const uint64_t timestamp = (uint64_t(get<uint32_t>(body, 4)) << 32) | get<uint32_t>(body, 8);
+        const int capturedLength = static_cast<int>(get<uint32_t>(body, 12));
+        if (20 + capturedLength > body.size()) {
+            m_error = "Поврежденный блок EPB";
+            return false;
+        }
+
+        // Метка времени в наносекундах
+        if (m_tsUnitsPerSecond == 1000000000) {
+            record.timestampNs = static_cast<int64_t>(timestamp);
+        } else {
+            record.timestampNs = static_cast<int64_t>(double(timestamp) * 1e9 / double(m_tsUnitsPerSecond));
+        }
+        record.packet = body.mid(20, capturedLength);
+        record.hasFlags = false;
+        record.flags = 0;
+
+        int offset = 20 + ((capturedLength + 3) & ~3);
+        while (offset + 4 <= body.size()) {
+            const uint16_t code = get<uint16_t>(body, offset);
+            const uint16_t length = get<uint16_t>(body, offset + 2);
+            if (code == OPT_END || offset + 4 + length > body.size()) {
+                break;
+            }
+            if (code == OPT_EPB_FLAGS && length == 4) {
+                record.flags = get<uint32_t>(body, offset + 4);
+                record.hasFlags = true;
+            }
+            offset += 4 + ((length + 3) & ~3);
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace PcapNg
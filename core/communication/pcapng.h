@@ -0,0 +1,82 @@
+#ifndef PCAPNG_H
+#define PCAPNG_H
+
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+#include <cstdint>
+
+// ===== ФОРМАТ PCAP-NG (минимум для захвата UDP ППБ) =====
+// Блоки пишутся в порядке байт хоста - это допускает формат (порядок задает SHB).
+// Канальный уровень - LINKTYPE_IPV4: в каждом пакете синтетический заголовок IPv4 + UDP,
+// так что файл открывается Wireshark/tcpdump как обычный UDP-трафик.
+namespace PcapNg {
+
+constexpr uint32_t BLOCK_SHB = 0x0A0D0D0A;
+constexpr uint32_t BLOCK_IDB = 0x00000001;
+constexpr uint32_t BLOCK_EPB = 0x00000006;
+constexpr uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+
+constexpr uint16_t LINKTYPE_IPV4 = 228;
+
+constexpr uint16_t OPT_END = 0;
+constexpr uint16_t OPT_SHB_USERAPPL = 4;
+constexpr uint16_t OPT_IF_TSRESOL = 9;
+constexpr uint16_t OPT_EPB_FLAGS = 2;
+
+// epb_flags, биты 0-1: направление
+constexpr uint32_t EPB_FLAG_INBOUND = 0x1;
+constexpr uint32_t EPB_FLAG_OUTBOUND = 0x2;
+
+constexpr int IPV4_UDP_HEADER_SIZE = 20 + 8;
+
+struct UdpEndpoints {
+    uint32_t srcIPv4 = 0;    // host order
+    uint16_t srcPort = 0;
+    uint32_t dstIPv4 = 0;
+    uint16_t dstPort = 0;
+};
+
+// ===== Запись =====
+QByteArray sectionHeaderBlock(const QString& application);
+QByteArray interfaceDescriptionBlock(uint16_t linkType, uint32_t snapLength);   // разрешение меток - наносекунды
+QByteArray enhancedPacketBlock(int64_t timestampNs, const QByteArray& packet,
+                               uint32_t originalLength, uint32_t flags);
+
+// IPv4 + UDP заголовки и payloadSize байт данных (originalPayloadSize - длина на проводе)
+QByteArray ipv4UdpPacket(const UdpEndpoints& endpoints, uint16_t ipId,
+                         const uint8_t* payload, int payloadSize, int originalPayloadSize);
+
+// ===== Чтение =====
+struct PacketRecord {
+    int64_t timestampNs = 0;
+    uint32_t flags = 0;
+    bool hasFlags = false;
+    QByteArray packet;       // данные канального уровня (IPv4)
+};
+
+bool parseIpv4Udp(const QByteArray& packet, UdpEndpoints& endpoints, QByteArray& payload);
+
+// Последовательное чтение EPB из файла; поддерживается одна секция,
+// интерфейсы LINKTYPE_IPV4 с любым if_tsresol (по умолчанию - микросекунды)
+class Reader
+{
+public:
+    bool open(const QString& path);
+    void close() { m_file.close(); }
+    bool next(PacketRecord& record);     // false - конец файла или ошибка (см. errorString)
+    QString errorString() const { return m_error; }
+
+private:
+    bool readBlock(uint32_t& type, QByteArray& body);
+    void parseInterface(const QByteArray& body);
+
+    QFile m_file;
+    QString m_error;
+    int64_t m_tsUnitsPerSecond = 1000000;
+    uint16_t m_linkType = 0;
+};
+
+} // namespace PcapNg
+
+#endif // PCAPNG_H
@@ -4,6 +4,7 @@
 #include "../utilits/crc.h"
 #include "commandandoperation.h"
 #include <QThread>
+#include <QFile>
 
 
 #include "../logging/logging_unified.h"
@@ -14,14 +15,8 @@ PPBCommunication::PPBCommunication(QObject* parent)
     , m_udpClient(nullptr)
     , m_currentAddress(0)
     , m_currentPort(0)
-    , m_processingTask(false)
 {
     LOG_CAT_INFO("PPBcom","PPBCommunication конструктор вызван");
-
-    // Таймер для обработки очереди (для обратной совместимости)
-    m_taskTimer = new QTimer(this);
-    m_taskTimer->setInterval(100);
-    connect(m_taskTimer, &QTimer::timeout, this, &PPBCommunication::processNextTask);
 }
 
 PPBCommunication::~PPBCommunication()
@@ -72,9 +67,27 @@ void PPBCommunication::initialize(UDPClient* udpClient)
             connect(m_engine.get(), &communicationengine::commandCompleted,
                     this, &PPBCommunication::onEngineCommandCompleted);
 
+            connect(m_engine.get(), &communicationengine::overloaded,
+                    this, &PPBCommunication::overloaded);
+
+            connect(m_engine.get(), &communicationengine::requestCompleted,
+                    this, &PPBCommunication::requestCompleted);
+
             connect(m_engine.get(), &communicationengine::errorOccurred,
                     this, &PPBCommunication::onEngineErrorOccurred);
 
+            connect(m_engine.get(), &communicationengine::pacerStatsUpdated,
+                    this, &PPBCommunication::pacerStatsUpdated);
+
+            connect(m_engine.get(), &communicationengine::latencyReportReady,
+                    this, &PPBCommunication::latencyReportReady);
+
+            connect(m_engine.get(), &communicationengine::broadcastCompleted,
+                    this, &PPBCommunication::broadcastCompleted);
+
+            connect(m_engine.get(), &communicationengine::streamProgress,
+                    this, &PPBCommunication::onEngineStreamProgress);
+
            /* connect(m_engine.get(), &communicationengine::logMessage,
                     this, &PPBCommunication::onEngineLogMessage); */
         }
@@ -141,6 +154,20 @@ void PPBCommunication::executeCommand(TechCommand cmd, uint16_t address)
     }
 }
 
+quint64 PPBCommunication::submitCommand(TechCommand cmd, uint16_t address)
+{
+    const quint64 requestId = m_nextRequestId.fetchAndAddRelaxed(1) + 1;
+
+    if (m_engine) {
+        m_engine->submitCommand(cmd, address, requestId);
+    } else {
+        LOG_CAT_ERROR("PPBcom","communicationengine не инициализирован");
+        emit errorOccurred("Движок обработки команд не инициализирован");
+        emit requestCompleted(requestId, false, "Движок обработки команд не инициализирован", cmd);
+    }
+    return requestId;
+}
+
 void PPBCommunication::sendFUTransmit(uint16_t address)
 {
     LOG_CAT_INFO("PPBcom",QString("PPBCommunication::sendFUTransmit (фасад): address=0x%1")
@@ -206,16 +233,124 @@ void PPBCommunication::sendDataPackets(const QVector<DataPacket>& packets) {
     // Сохраняем для возможного сравнения
     m_generatedPackets = packets;
 
-    // Отправляем через движок
+    // Отправляем через движок одной пакетной передачей
     if (m_engine) {
-        // Пока отправляем по одному
-        for (const DataPacket& packet : packets) {
-            QByteArray data(reinterpret_cast<const char*>(&packet), sizeof(DataPacket));
-            sendPacket(data, "Data packet");
-        }
+        m_engine->sendDataPackets(packets);
+    }
+}
+
+void PPBCommunication::setDataPacketInterval(int intervalMs) {
+    if (m_engine) {
+        m_engine->setDataPacketInterval(intervalMs);
+    }
+}
+
+void PPBCommunication::setPacketRate(double packetsPerSecond, int burst) {
+    if (m_engine) {
+        m_engine->setPacketRate(packetsPerSecond, burst);
+    }
+}
+
+void PPBCommunication::setPipelineWindow(int window) {
+    if (m_engine) {
+        m_engine->setPipelineWindow(window);
+    }
+}
+
+void PPBCommunication::setAutoPoll(uint16_t address, int intervalMs) {
+    if (m_engine) {
+        m_engine->setAutoPoll(address, intervalMs);
+    }
+}
+
+void PPBCommunication::setAdaptiveTimeouts(bool enabled, int floorMs, int ceilingMs) {
+    if (m_engine) {
+        m_engine->setAdaptiveTimeouts(enabled, floorMs, ceilingMs);
+    }
+}
+
+void PPBCommunication::setGapRepair(bool enabled, int maxAttempts) {
+    if (m_engine) {
+        m_engine->setGapRepair(enabled, maxAttempts);
+    }
+}
+
+void PPBCommunication::setQueueAging(int agingMs) {
+    if (m_engine) {
+        m_engine->setQueueAging(agingMs);
+    }
+}
+
+void PPBCommunication::setBulkPreemption(bool enabled) {
+    if (m_engine) {
+        m_engine->setBulkPreemption(enabled);
+    }
+}
+
+void PPBCommunication::setQueueLimit(int depth, QueueOverflowPolicy policy) {
+    if (m_engine) {
+        m_engine->setQueueLimit(depth, policy);
     }
 }
 
+void PPBCommunication::setAddressQueueLimit(uint16_t address, int depth, QueueOverflowPolicy policy) {
+    if (m_engine) {
+        m_engine->setAddressQueueLimit(address, depth, policy);
+    }
+}
+
+void PPBCommunication::setDialogPacketLimit(int packets) {
+    if (m_engine) {
+        m_engine->setDialogPacketLimit(packets);
+    }
+}
+
+void PPBCommunication::setStreamLimits(double maxBer, int maxMissingRun) {
+    if (m_engine) {
+        m_engine->setStreamLimits(maxBer, maxMissingRun);
+    }
+}
+
+void PPBCommunication::setPPBEndpoint(uint16_t address, const QString& ip, quint16 port) {
+    if (m_engine) {
+        m_engine->setPPBEndpoint(address, ip, port);
+    }
+}
+
+void PPBCommunication::executeBroadcast(TechCommand cmd, uint16_t mask) {
+    if (m_engine) {
+        m_engine->executeBroadcast(cmd, mask);
+    } else {
+        LOG_CAT_ERROR("PPBcom","communicationengine не инициализирован");
+        emit errorOccurred("Движок обработки команд не инициализирован");
+    }
+}
+
+void PPBCommunication::requestLatencyReport() {
+    if (m_engine) {
+        m_engine->requestLatencyReport();
+    }
+}
+
+EngineMetricsSnapshot PPBCommunication::metricsSnapshot() const {
+    return m_engine ? m_engine->metrics().snapshot() : EngineMetricsSnapshot();
+}
+
+bool PPBCommunication::exportMetrics(const QString& path) const {
+    if (!m_engine) {
+        return false;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        LOG_CAT_WARNING("PPBcom", QString("Не удалось записать метрики в %1: %2")
+                                      .arg(path, file.errorString()));
+        return false;
+    }
+    file.write(m_engine->metrics().snapshot().toCsv().toUtf8());
+    return true;
+}
+
 QVector<DataPacket> PPBCommunication::getGeneratedPackets() const {
     return m_generatedPackets;
 }
@@ -258,6 +393,12 @@ void PPBCommunication::onEngineStateChanged(uint16_t address, PPBState state)
     }
 }
 
+void PPBCommunication::onEngineStreamProgress(uint16_t address, TechCommand command, const StreamStats& stats)
+{
+    emit commandProgress(stats.received, stats.expected, command);
+    emit streamProgress(address, command, stats);
+}
+
 void PPBCommunication::onEngineCommandCompleted(bool success, const QString& report, TechCommand command)
 {
     emit commandCompleted(success, report, command);
@@ -306,37 +447,9 @@ void PPBCommunication::setError(const QString& error)
 
 void PPBCommunication::enqueueCommand(TechCommand cmd, uint16_t address)
 {
-    CommandTask task{cmd, address, QDateTime::currentDateTime()};
-    {
-        QMutexLocker locker(&m_taskMutex);
-
-    m_taskQueue.enqueue(task);
-
-    if (!m_processingTask) {
-        m_taskTimer->start();
-    }
-    }
-}
-
-void PPBCommunication::processNextTask()
-{
-    CommandTask task;
-    {
-        QMutexLocker locker(&m_taskMutex);
-
-    if (m_taskQueue.isEmpty()) {
-        m_processingTask = false;
-        m_taskTimer->stop();
-        emit busyChange(false);
-        return;
-    }
-
-    m_processingTask = true;
-    emit busyChange(true);
-
-     task = m_taskQueue.dequeue();
-    }
-    executeCommand(task.cmd, task.address);
+    // Своей очереди нет: движок сам ставит команду в очередь адреса и отправляет ее,
+    // как только ППБ освободится (без опроса по таймеру)
+    executeCommand(cmd, address);
 }
 
 void PPBCommunication::setParseResult(bool success, const QString& message) {
@@ -374,15 +487,6 @@ void PPBCommunication::stop()
         QMetaObject::invokeMethod(m_engine.get(), "disconnect", Qt::QueuedConnection);
     }
 
-    // Останавливаем таймер
-    if (m_taskTimer) {
-        m_taskTimer->stop();
-    }
-
-    // Очищаем очередь
-    m_taskQueue.clear();
-    m_processingTask = false;
-
     // Сбрасываем состояние
     setStateInternal(PPBState::Idle);
 
@@ -11,6 +11,7 @@
 #include <QQueue>
 #include <QSharedPointer>
 #include <QWeakPointer>
+#include <QAtomicInteger>
 #include "communicationengine.h"
 
 class PPBCommand;
@@ -30,6 +31,10 @@ public:
 
     // Выполнение команды ТУ
     void executeCommand(TechCommand cmd, uint16_t address);
+    // То же с номером запроса: итог - сигналом requestCompleted с этим номером.
+    // Одинаковые запросы только на чтение (TS, VERS, ...) в очереди движка сливаются
+    // в один диалог, requestCompleted приходит каждому
+    quint64 submitCommand(TechCommand cmd, uint16_t address);
 
     // ФУ команды
     void sendFUTransmit(uint16_t address);
@@ -47,6 +52,11 @@ public:
                m_state == PPBState::WaitingData;
     }
 
+    // Метрики движка (исходы и задержки по адресам и командам) - без блокировок, из любого потока
+    EngineMetricsSnapshot metricsSnapshot() const;
+    // Снимок метрик в CSV; false - движок не создан или файл не записан
+    bool exportMetrics(const QString& path) const;
+
     // Реализация интерфейса команд (упрощённая - делегирует движку)
     void setState(PPBState state) override;
     void startTimeoutTimer(int ms) override;
@@ -66,13 +76,44 @@ public slots:
     // Остановка всех операций
     void stop();
 
-    // Постановка команды в очередь (для асинхронного выполнения)
+    // Постановка команды в очередь движка (для совместимости; очередь и диспетчеризация - в движке)
     void enqueueCommand(TechCommand cmd, uint16_t address);
 
     // Реализация интерфейса CommandInterface
     void sendDataPackets(const QVector<DataPacket>& packets) override;
     QVector<DataPacket> getGeneratedPackets() const override;
 
+    // Интервал между пакетами данных при пакетной передаче, мс (0 - без паузы)
+    void setDataPacketInterval(int intervalMs);
+    // Темп пакетов данных, пакетов/с (<= 0 - без ограничения)
+    void setPacketRate(double packetsPerSecond, int burst = 1);
+    // Сколько команд без данных (TC, CLEAN, ...) может ждать OK от одного ППБ одновременно
+    void setPipelineWindow(int window);
+    // Автоопрос состояния адреса таймером движка (intervalMs <= 0 - выключить)
+    void setAutoPoll(uint16_t address, int intervalMs);
+    // Таймауты по измеренному времени ответа ППБ (выключено, по умолчанию - табличные)
+    void setAdaptiveTimeouts(bool enabled, int floorMs = 100, int ceilingMs = 10000);
+    // Дозапрос пропущенных пакетов PRBS_S2M вместо завершения с частичными данными
+    void setGapRepair(bool enabled, int maxAttempts = 2);
+    // Приоритеты очереди: старение (0 - строгие классы) и вытеснение пакетной передачи
+    void setQueueAging(int agingMs);
+    void setBulkPreemption(bool enabled);
+    // Лимит очереди команд ППБ и политика переполнения; перегрузка - сигналом overloaded
+    void setQueueLimit(int depth, QueueOverflowPolicy policy = QueueOverflowPolicy::Reject);
+    void setAddressQueueLimit(uint16_t address, int depth,
+                              QueueOverflowPolicy policy = QueueOverflowPolicy::Reject);
+    void setDialogPacketLimit(int packets);
+    // Пороги досрочного прекращения приема длинного ответа (0 - выключен)
+    void setStreamLimits(double maxBer, int maxMissingRun);
+    // Собственный IP/порт ППБ: диалоги с данными разных конечных точек идут параллельно
+    void setPPBEndpoint(uint16_t address, const QString& ip, quint16 port);
+
+    // Одна команда на маску ППБ, итог по каждому блоку - сигналом broadcastCompleted
+    void executeBroadcast(TechCommand cmd, uint16_t mask);
+
+    // Отчет по задержкам ответа ППБ (придет сигналом latencyReportReady)
+    void requestLatencyReport();
+
     //АНАЛИЗ
     void notifySentPackets(const QVector<DataPacket>& packets) override;
     void notifyReceivedPackets(const QVector<DataPacket>& packets) override;
@@ -88,6 +129,7 @@ signals:
     void statusReceived(uint16_t address, const QVector<QByteArray>& data);
     void commandProgress(int current, int total, TechCommand command);
     void commandCompleted(bool success, const QString& report, TechCommand command);
+    void requestCompleted(quint64 requestId, bool success, const QString& report, TechCommand command);
 
     // Сигналы ошибок
     void errorOccurred(const QString& error);
@@ -95,6 +137,21 @@ signals:
     //сигнал для распарсенных данных
     void commandDataParsed(uint16_t address, const QVariant& data, TechCommand command);
 
+    // Статистика темпа пакетной передачи (фактический темп, джиттер, опоздания)
+    void pacerStatsUpdated(const PacerStats& stats);
+
+    // Гистограммы задержек запрос->OK и OK->последний пакет по адресам и командам
+    void latencyReportReady(const QString& report);
+
+    // Итог широковещательной команды по каждому ППБ маски
+    void broadcastCompleted(const BroadcastResult& result);
+
+    // Очередь команд или буфер диалога переполнены - источнику запросов пора снизить темп
+    void overloaded(const OverloadEvent& event);
+
+    // Ход приема длинного ответа (пропуски, частичный BER) - до конца пачки
+    void streamProgress(uint16_t address, TechCommand command, const StreamStats& stats);
+
 
     // Сигналы для логов
     //void logMessage(const QString& message);
@@ -114,13 +171,11 @@ private slots:
     // Слоты для обработки событий от движка
     void onEngineStateChanged(uint16_t address, PPBState state);
     void onEngineCommandCompleted(bool success, const QString& report, TechCommand command);
+    void onEngineStreamProgress(uint16_t address, TechCommand command, const StreamStats& stats);
     //void onEngineCommandProgress(int current, int total, TechCommand command);
     void onEngineErrorOccurred(const QString& error);
     void onEngineLogMessage(const QString& message);
 
-    // Обработка очереди команд (устаревшее, но оставляем для совместимости)
-    void processNextTask();
-
 private:
     // Установка состояния (с синхронизацией)
     void setStateInternal(PPBState state);
@@ -128,13 +183,6 @@ private:
     // Установка ошибки
     void setError(const QString& error);
 
-    // Структура для задачи в очереди (для совместимости)
-    struct CommandTask {
-        TechCommand cmd;
-        uint16_t address;
-        QDateTime timestamp;
-    };
-
     // Основной движок обработки команд
     std::unique_ptr<communicationengine> m_engine;
 
@@ -150,19 +198,14 @@ private:
     QString m_currentIP;
     quint16 m_currentPort;
 
-    // Очередь команд (для обратной совместимости)
-    QQueue<CommandTask> m_taskQueue;
-    bool m_processingTask;
-    mutable QMutex m_taskMutex;   // для защиты очереди
-
-    // Таймер для обработки очереди (устаревшее)
-    QTimer* m_taskTimer;
-
     // Сгенерированные пакеты (для тестовых последовательностей)
     QVector<DataPacket> m_generatedPackets;
 
     // Последняя ошибка
     QString m_lastError;
+
+    // Номера запросов submitCommand (вызывается из любого потока)
+    QAtomicInteger<quint64> m_nextRequestId{0};
 };
 
 #endif // PPBCOMMUNICATION_H
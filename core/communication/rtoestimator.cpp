@@ -0,0 +1,112 @@
+#include "rtoestimator.h"
+#include "commandandoperation.h"
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+
+void RtoEstimator::Estimate::update(double rttUs)
+{
+    if (samples == 0) {
+        srttUs = rttUs;
+        rttvarUs = rttUs / 2;
+    } else {
+        rttvarUs = (1 - BETA) * rttvarUs + BETA * std::fabs(srttUs - rttUs);
+        srttUs = (1 - ALPHA) * srttUs + ALPHA * rttUs;
+    }
+    ++samples;
+    backoff = 0;
+}
+
+int64_t RtoEstimator::Estimate::rtoUs() const
+{
+    return static_cast<int64_t>(srttUs + std::max<double>(GRANULARITY_US, K * rttvarUs));
+}
+
+RtoEstimator::Key RtoEstimator::key(uint16_t address, TechCommand command, Phase phase)
+{
+    return (Key(address) << 16) | (Key(static_cast<uint8_t>(command)) << 8) | Key(phase);
+}
+
+void RtoEstimator::setConfig(const Config& config)
+{
+    m_config = config;
+    m_config.floorMs = std::max(1, m_config.floorMs);
+    m_config.ceilingMs = std::max(m_config.floorMs, m_config.ceilingMs);
+}
+
+void RtoEstimator::sample(uint16_t address, TechCommand command, Phase phase, int64_t rttNs)
+{
+    if (rttNs < 0) {
+        return;
+    }
+    const double rttUs = rttNs / 1000.0;
+    m_perAddress[key(address, command, phase)].update(rttUs);
+    m_perCommand[key(0, command, phase)].update(rttUs);
+}
+
+void RtoEstimator::timedOut(uint16_t address, TechCommand command, Phase phase)
+{
+    // Оценка команды по всем адресам не трогается: молчит один блок, а не линия
+    Estimate& estimate = m_perAddress[key(address, command, phase)];
+    estimate.backoff = std::min(MAX_BACKOFF, estimate.backoff + 1);
+}
+
+int RtoEstimator::clampMs(int64_t rtoUs, int backoff) const
+{
+    const int64_t ms = ((rtoUs + 999) / 1000) << backoff;
+    return static_cast<int>(std::clamp<int64_t>(ms, m_config.floorMs, m_config.ceilingMs));
+}
+
+int RtoEstimator::timeoutMs(uint16_t address, TechCommand command, Phase phase, int fallbackMs) const
+{
+    if (!m_config.enabled) {
+        return fallbackMs;
+    }
+
+    int backoff = 0;
+    auto own = m_perAddress.find(key(address, command, phase));
+    if (own != m_perAddress.end()) {
+        if (own->second.samples > 0) {
+            return clampMs(own->second.rtoUs(), own->second.backoff);
+        }
+        backoff = own->second.backoff;
+    }
+
+    auto common = m_perCommand.find(key(0, command, phase));
+    if (common != m_perCommand.end() && common->second.samples > 0) {
+        return clampMs(common->second.rtoUs(), backoff);
+    }
+    return fallbackMs;
+}
+
+void RtoEstimator::clear()
+{
+    m_perAddress.clear();
+    m_perCommand.clear();
+}
+
+QString RtoEstimator::report() const
+{
+    if (m_perCommand.empty()) {
+        return "Адаптивные таймауты: нет данных";
+    }
+
+    QStringList lines;
+    lines << QString("Адаптивные таймауты (%1, %2..%3 мс):")
+                 .arg(m_config.enabled ? "включены" : "выключены")
+                 .arg(m_config.floorMs).arg(m_config.ceilingMs);
+
+    for (const auto& item : m_perCommand) {
+        const TechCommand command = static_cast<TechCommand>((item.first >> 8) & 0xFF);
+        const Phase phase = static_cast<Phase>(item.first & 0xFF);
+        const Estimate& estimate = item.second;
+        lines << QString("  %1 %2: SRTT %3 мс, RTTVAR %4 мс, RTO %5 мс (n=%6)")
+                     .arg(CommandFactory::commandName(command), -10)
+                     .arg(phase == Phase::Ok ? "OK" : "данные")
+                     .arg(estimate.srttUs / 1000.0, 0, 'f', 3)
+                     .arg(estimate.rttvarUs / 1000.0, 0, 'f', 3)
+                     .arg(clampMs(estimate.rtoUs(), 0))
+                     .arg(estimate.samples);
+    }
+    return lines.join('\n');
+}
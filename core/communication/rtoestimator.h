@@ -0,0 +1,68 @@
+#ifndef RTOESTIMATOR_H
+#define RTOESTIMATOR_H
+
+#include <QString>
+#include <map>
+#include <cstdint>
+#include "ppbprotocol.h"
+
+// ===== АДАПТИВНЫЕ ТАЙМАУТЫ (RTO по RFC 6298) =====
+// Для каждого адреса и команды - сглаженное время ответа (SRTT) и его разброс (RTTVAR),
+// отдельно для ожидания OK и для фазы данных. Таймаут = SRTT + max(G, 4 * RTTVAR)
+// в пределах [floor, ceiling]; после таймаута удваивается до следующего отсчета.
+// Адрес без своих отсчетов берет оценку команды по всем адресам, а ее нет -
+// табличный таймаут команды. Используется только из потока движка.
+class RtoEstimator
+{
+public:
+    enum class Phase {
+        Ok,      // запрос -> OK
+        Data     // OK -> последний пакет данных
+    };
+
+    struct Config {
+        bool enabled = false;      // по умолчанию - табличные таймауты, включается setAdaptiveTimeouts
+        int floorMs = 100;
+        int ceilingMs = 10000;
+    };
+
+    void setConfig(const Config& config);
+    const Config& config() const { return m_config; }
+
+    void sample(uint16_t address, TechCommand command, Phase phase, int64_t rttNs);
+    void timedOut(uint16_t address, TechCommand command, Phase phase);
+
+    // Таймаут фазы, мс; fallbackMs - табличный, если оценок нет или адаптация выключена
+    int timeoutMs(uint16_t address, TechCommand command, Phase phase, int fallbackMs) const;
+
+    void clear();
+    QString report() const;
+
+    static constexpr double ALPHA = 1.0 / 8;
+    static constexpr double BETA = 1.0 / 4;
+    static constexpr int K = 4;
+    static constexpr int64_t GRANULARITY_US = 1000;   // шаг колеса таймеров
+    static constexpr int MAX_BACKOFF = 6;
+
+private:
+    struct Estimate {
+        double srttUs = 0.0;
+        double rttvarUs = 0.0;
+        uint32_t samples = 0;
+        int backoff = 0;           // удвоений после таймаутов подряд
+
+        void update(double rttUs);
+        int64_t rtoUs() const;
+    };
+
+    using Key = uint32_t;          // адрес << 16 | команда << 8 | фаза
+    static Key key(uint16_t address, TechCommand command, Phase phase);
+
+    int clampMs(int64_t rtoUs, int backoff) const;
+
+    Config m_config;
+    std::map<Key, Estimate> m_perAddress;
+    std::map<Key, Estimate> m_perCommand;   // адрес в ключе - 0
+};
+
+#endif // RTOESTIMATOR_H
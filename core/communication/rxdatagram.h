@@ -0,0 +1,61 @@
+#ifndef RXDATAGRAM_H
+#define RXDATAGRAM_H
+
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+
+// ===== ЗАПИСЬ ПРИНЯТОЙ ДАТАГРАММЫ (фиксированный размер, без аллокаций) =====
+// Все ответы протокола - 4 байта, запас до размера BaseRequest на случай чужих пакетов.
+constexpr int RX_DATAGRAM_MAX_SIZE = 8;
+
+struct RxDatagram {
+    uint8_t data[RX_DATAGRAM_MAX_SIZE];  // байты 0/1 уже переставлены, как в UDPClient::dataReceived
+    uint8_t size;                        // фактический размер (не больше RX_DATAGRAM_MAX_SIZE)
+    bool truncated;                      // датаграмма была длиннее буфера
+    uint32_t senderIPv4;                 // адрес отправителя (host order)
+    uint16_t senderPort;                 // порт отправителя
+    int64_t rxTimestampNs;               // время приема, нс от эпохи (ядро - SO_TIMESTAMPNS, иначе - при чтении)
+};
+
+// Пачка датаграмм, принятых за одно пробуждение сокета.
+// Указывает на слэб UDPClient и действительна только внутри обработчика сигнала.
+struct RxBatch {
+    const RxDatagram* records = nullptr;
+    int count = 0;
+
+    const RxDatagram* begin() const { return records; }
+    const RxDatagram* end() const { return records + count; }
+};
+
+// Счетчики приемного тракта
+struct RxStats {
+    uint64_t datagrams = 0;   // принято датаграмм
+    uint64_t batches = 0;     // пробуждений сокета (пачек)
+    uint64_t truncated = 0;   // обрезанных датаграмм
+    uint64_t kernelDrops = 0; // отброшено ядром при переполненном буфере приема (SO_RXQ_OVFL)
+
+    // Кольцо потока приема (заполнены, только если поток приема запущен)
+    uint64_t ringCapacity = 0;
+    uint64_t ringOccupancy = 0;   // записей в кольце сейчас
+    uint64_t ringHighWater = 0;   // максимум записей за время работы
+    uint64_t ringDropped = 0;     // отброшено при переполненном кольце
+};
+
+// Часы меток отправки/приема: те же, что у SO_TIMESTAMPNS (CLOCK_REALTIME), нс от эпохи
+inline int64_t wallClockNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Перестановка байтов адреса (ППБ передает их в обратном порядке)
+inline void swapAddressBytes(uint8_t* data)
+{
+    const uint8_t tmp = data[0];
+    data[0] = data[1];
+    data[1] = tmp;
+}
+
+#endif // RXDATAGRAM_H
@@ -0,0 +1,331 @@
+#include "timerwheel.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int64_t NS_PER_TICK = 1000000;   // шаг колеса - 1 мс
+
+int64_t ceilTick(int64_t ns)
+{
+    return ns <= 0 ? 0 : (ns + NS_PER_TICK - 1) / NS_PER_TICK;
+}
+}
+
+TimerWheel::TimerWheel(QObject* parent)
+    : QObject(parent)
+{
+    m_buckets.fill(-1);
+    m_systemClock = new SystemClock(this);
+    setClock(nullptr);
+}
+
+TimerWheel::~TimerWheel()
+{
+    if (m_clock) {
+        m_clock->cancelWake();
+        m_clock->setWakeHandler(nullptr);
+    }
+}
+
+bool TimerWheel::setClock(EngineClock* clock)
+{
+    if (!clock) {
+        clock = m_systemClock;
+    }
+    if (clock == m_clock) {
+        return true;
+    }
+    if (m_armed > 0) {
+        return false;
+    }
+
+    if (m_clock) {
+        m_clock->cancelWake();
+        m_clock->setWakeHandler(nullptr);
+    }
+    m_clock = clock;
+    m_clock->setWakeHandler([this]() { onWake(); });
+    m_wakeTick = -1;
+    m_currentTick = nowNs() / NS_PER_TICK;
+    return true;
+}
+
+TimerWheel::TimerId TimerWheel::arm(int delayMs, Callback callback)
+{
+    return armNode(int64_t(qMax(0, delayMs)) * NS_PER_TICK, 0, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::armPeriodic(int intervalMs, Callback callback)
+{
+    const int64_t intervalNs = int64_t(qMax(1, intervalMs)) * NS_PER_TICK;
+    return armNode(intervalNs, intervalNs, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::armNode(int64_t delayNs, int64_t intervalNs, Callback callback)
+{
+    const int64_t now = nowNs();
+
+    // Колесо было пустым: подтягиваем его к текущему времени, обрабатывать нечего
+    if (m_armed == 0 && !m_advancing) {
+        m_currentTick = now / NS_PER_TICK;
+    }
+
+    int32_t index;
+    if (!m_freeNodes.empty()) {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    } else {
+        index = static_cast<int32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    Node& node = m_nodes[index];
+    node.callback = std::move(callback);
+    node.deadlineNs = now + delayNs;
+    node.deadlineTick = ceilTick(node.deadlineNs);
+    node.intervalNs = intervalNs;
+    place(index, m_currentTick + 1);
+
+    ++m_armed;
+    m_armedPeak = qMax(m_armedPeak, m_armed);
+
+    // Новый дедлайн раньше ближайшего пробуждения - он в нулевом уровне, будим точно к нему
+    if (!m_advancing && (m_wakeTick < 0 || node.deadlineTick < m_wakeTick)) {
+        m_wakeTick = node.deadlineTick;
+        m_clock->wakeAt(m_wakeTick * NS_PER_TICK);
+    }
+
+    return (TimerId(node.generation) << 32) | TimerId(uint32_t(index + 1));
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+    const int32_t index = nodeIndex(id);
+    if (index < 0) {
+        return false;
+    }
+
+    unlink(index);
+    release(index);
+    ++m_cancelled;
+    return true;
+}
+
+bool TimerWheel::isArmed(TimerId id) const
+{
+    return nodeIndex(id) >= 0;
+}
+
+void TimerWheel::clear()
+{
+    for (int32_t& head : m_buckets) {
+        while (head != -1) {
+            const int32_t index = head;
+            unlink(index);
+            release(index);
+            ++m_cancelled;
+        }
+    }
+    m_clock->cancelWake();
+    m_wakeTick = -1;
+}
+
+TimerWheelStats TimerWheel::stats() const
+{
+    TimerWheelStats stats;
+    stats.armed = m_armed;
+    stats.armedPeak = m_armedPeak;
+    stats.fired = m_fired;
+    stats.cancelled = m_cancelled;
+    stats.lateAvgUs = m_fired > 0 ? m_lateSumNs / qint64(m_fired) / 1000 : 0;
+    stats.lateMaxUs = m_lateMaxNs / 1000;
+    stats.lateOver5ms = m_lateOver5ms;
+    return stats;
+}
+
+void TimerWheel::resetStats()
+{
+    m_armedPeak = m_armed;
+    m_fired = 0;
+    m_cancelled = 0;
+    m_lateSumNs = 0;
+    m_lateMaxNs = 0;
+    m_lateOver5ms = 0;
+}
+
+int32_t TimerWheel::nodeIndex(TimerId id) const
+{
+    if (id == 0) {
+        return -1;
+    }
+    const int64_t index = int64_t(id & 0xFFFFFFFFu) - 1;
+    if (index < 0 || index >= int64_t(m_nodes.size())) {
+        return -1;
+    }
+    const Node& node = m_nodes[index];
+    if (node.generation != uint32_t(id >> 32) || node.bucket < 0) {
+        return -1;
+    }
+    return static_cast<int32_t>(index);
+}
+
+void TimerWheel::place(int32_t index, int64_t minTick)
+{
+    Node& node = m_nodes[index];
+
+    int64_t tick = qMax(node.deadlineTick, minTick);
+    int64_t delta = tick - m_currentTick;
+    if (delta > MAX_DELAY_TICKS) {
+        // Дальше охвата колеса: сработает раньше и будет переложен (см. fire)
+        delta = MAX_DELAY_TICKS;
+        tick = m_currentTick + delta;
+    }
+    node.deadlineTick = tick;
+
+    int bucket;
+    if (delta < SLOTS) {
+        bucket = int(tick & (SLOTS - 1));
+    } else if (delta < int64_t(SLOTS) * SLOTS) {
+        bucket = SLOTS + int((tick >> LEVEL_BITS) & (SLOTS - 1));
+    } else {
+        bucket = 2 * SLOTS + int((tick >> (2 * LEVEL_BITS)) & (SLOTS - 1));
+    }
+
+    node.bucket = bucket;
+    node.prev = -1;
+    node.next = m_buckets[bucket];
+    if (node.next != -1) {
+        m_nodes[node.next].prev = index;
+    }
+    m_buckets[bucket] = index;
+}
+
+void TimerWheel::unlink(int32_t index)
+{
+    Node& node = m_nodes[index];
+    if (node.prev != -1) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_buckets[node.bucket] = node.next;
+    }
+    if (node.next != -1) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.prev = -1;
+    node.next = -1;
+    node.bucket = -1;
+}
+
+void TimerWheel::release(int32_t index)
+{
+    Node& node = m_nodes[index];
+    node.callback = nullptr;
+    ++node.generation;          // старые id этого узла больше не действительны
+    m_freeNodes.push_back(index);
+    --m_armed;
+}
+
+void TimerWheel::cascade(int level, int slot)
+{
+    int32_t& head = m_buckets[level * SLOTS + slot];
+    int32_t index = head;
+    head = -1;
+
+    while (index != -1) {
+        const int32_t next = m_nodes[index].next;
+        m_nodes[index].bucket = -1;
+        // Дедлайн ровно на текущем тике попадет в слот, который сейчас будет обработан
+        place(index, m_currentTick);
+        index = next;
+    }
+}
+
+void TimerWheel::fire(int32_t index, int64_t now)
+{
+    Node& node = m_nodes[index];
+
+    // Дедлайн был дальше охвата колеса - перекладываем
+    if (node.deadlineNs > now) {
+        node.deadlineTick = ceilTick(node.deadlineNs);
+        place(index, m_currentTick + 1);
+        return;
+    }
+
+    const int64_t lateNs = now - node.deadlineNs;
+    ++m_fired;
+    m_lateSumNs += lateNs;
+    m_lateMaxNs = qMax(m_lateMaxNs, lateNs);
+    if (lateNs > 5 * NS_PER_TICK) {
+        ++m_lateOver5ms;
+    }
+
+    if (node.intervalNs > 0) {
+        // Периодический: следующий дедлайн от предыдущего, пропущенные периоды не догоняем
+        Callback callback = node.callback;   // копия: из callback узлы могут перераспределиться
+        node.deadlineNs += node.intervalNs;
+        if (node.deadlineNs <= now) {
+            node.deadlineNs = now + node.intervalNs;
+        }
+        node.deadlineTick = ceilTick(node.deadlineNs);
+        place(index, m_currentTick + 1);
+        callback();
+    } else {
+        Callback callback = std::move(node.callback);
+        release(index);
+        callback();
+    }
+}
+
+void TimerWheel::advance(int64_t nowTick)
+{
+    while (m_currentTick < nowTick) {
+        ++m_currentTick;
+
+        const int slot0 = int(m_currentTick & (SLOTS - 1));
+        if (slot0 == 0) {
+            const int slot1 = int((m_currentTick >> LEVEL_BITS) & (SLOTS - 1));
+            if (slot1 == 0) {
+                cascade(2, int((m_currentTick >> (2 * LEVEL_BITS)) & (SLOTS - 1)));
+            }
+            cascade(1, slot1);
+        }
+
+        // Callback может взводить и отменять таймеры: каждый раз берем текущую голову слота
+        int32_t& head = m_buckets[slot0];
+        while (head != -1) {
+            const int32_t index = head;
+            unlink(index);
+            fire(index, nowNs());
+        }
+    }
+}
+
+void TimerWheel::schedule()
+{
+    if (m_armed == 0) {
+        m_clock->cancelWake();
+        m_wakeTick = -1;
+        return;
+    }
+
+    // Ближайший непустой слот нулевого уровня, иначе - граница следующего каскада
+    int64_t wakeTick = ((m_currentTick >> LEVEL_BITS) + 1) << LEVEL_BITS;
+    for (int64_t tick = m_currentTick + 1; tick < wakeTick; ++tick) {
+        if (m_buckets[tick & (SLOTS - 1)] != -1) {
+            wakeTick = tick;
+            break;
+        }
+    }
+
+    m_wakeTick = wakeTick;
+    m_clock->wakeAt(wakeTick * NS_PER_TICK);
+}
+
+void TimerWheel::onWake()
+{
+    m_wakeTick = -1;
+    m_advancing = true;
+    advance(nowNs() / NS_PER_TICK);
+    m_advancing = false;
+    schedule();
+}
@@ -0,0 +1,107 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <QObject>
+#include <QMetaType>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "engineclock.h"
+
+// Статистика дедлайнов колеса таймеров
+struct TimerWheelStats {
+    int armed = 0;                // взведено сейчас
+    int armedPeak = 0;            // максимум одновременно взведенных
+    quint64 fired = 0;            // сработало
+    quint64 cancelled = 0;        // отменено до срабатывания
+    qint64 lateAvgUs = 0;         // опоздание срабатывания относительно дедлайна, мкс
+    qint64 lateMaxUs = 0;
+    quint64 lateOver5ms = 0;      // срабатываний с опозданием больше 5 мс
+};
+Q_DECLARE_METATYPE(TimerWheelStats)
+
+// Иерархическое колесо таймеров с шагом 1 мс: 3 уровня по 256 слотов (до ~4.6 часа).
+// Таймауты операций, таймауты между пакетами, автоопрос - все дедлайны движка
+// на одном будильнике часов движка, который взводится на ближайший непустой слот.
+// Часы по умолчанию - SystemClock; VirtualClock прогоняет те же дедлайны в виртуальном времени.
+// Взвод и отмена - O(1), без создания QObject; узлы переиспользуются.
+// Живет в потоке движка, все вызовы - из этого потока.
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+
+public:
+    using TimerId = quint64;            // 0 - нет таймера
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(QObject* parent = nullptr);
+    ~TimerWheel() override;
+
+    // Однократный таймер: callback через delayMs. Из callback можно взводить и отменять таймеры
+    TimerId arm(int delayMs, Callback callback);
+    // Периодический: первый раз через intervalMs, далее с тем же периодом без накопления ошибки
+    TimerId armPeriodic(int intervalMs, Callback callback);
+    // false - таймер уже сработал или отменен (id устарел)
+    bool cancel(TimerId id);
+    bool isArmed(TimerId id) const;
+    void clear();
+
+    // Смена часов - только пока ничего не взведено (дедлайны привязаны к часам). nullptr - системные.
+    // Часы должны жить дольше колеса
+    bool setClock(EngineClock* clock);
+    EngineClock* clock() const { return m_clock; }
+
+    int armedCount() const { return m_armed; }
+    TimerWheelStats stats() const;
+    void resetStats();
+
+    static constexpr int LEVEL_BITS = 8;
+    static constexpr int SLOTS = 1 << LEVEL_BITS;
+    static constexpr int LEVELS = 3;
+    static constexpr int64_t MAX_DELAY_TICKS = (int64_t(1) << (LEVEL_BITS * LEVELS)) - 1;
+
+private:
+    struct Node {
+        Callback callback;
+        int64_t deadlineNs = 0;
+        int64_t deadlineTick = 0;
+        int64_t intervalNs = 0;         // 0 - однократный
+        int32_t prev = -1;
+        int32_t next = -1;
+        int32_t bucket = -1;            // индекс в m_buckets, -1 - не в колесе
+        uint32_t generation = 1;
+    };
+
+    TimerId armNode(int64_t delayNs, int64_t intervalNs, Callback callback);
+    void place(int32_t index, int64_t minTick);   // в слот по дедлайну относительно m_currentTick
+    void unlink(int32_t index);
+    void release(int32_t index);
+    void cascade(int level, int slot);
+    void fire(int32_t index, int64_t now);
+    void advance(int64_t nowTick);
+    void schedule();
+    void onWake();
+    int32_t nodeIndex(TimerId id) const;   // -1 - id устарел
+    int64_t nowNs() const { return m_clock->nowNs(); }
+
+    std::vector<Node> m_nodes;
+    std::vector<int32_t> m_freeNodes;
+    std::array<int32_t, SLOTS * LEVELS> m_buckets;   // голова списка слота, -1 - пусто
+
+    SystemClock* m_systemClock = nullptr;
+    EngineClock* m_clock = nullptr;
+    int64_t m_currentTick = 0;          // все слоты до этого тика обработаны
+    int64_t m_wakeTick = -1;            // на какой тик взведен будильник, -1 - не взведен
+    bool m_advancing = false;
+
+    int m_armed = 0;
+    int m_armedPeak = 0;
+    quint64 m_fired = 0;
+    quint64 m_cancelled = 0;
+    qint64 m_lateSumNs = 0;
+    qint64 m_lateMaxNs = 0;
+    quint64 m_lateOver5ms = 0;
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,140 @@
+#include "trafficrecorder.h"
+#include "pcapng.h"
+#include <QThread>
+#include <cstring>
+
+#include "../logging/logging_unified.h"
+
+TrafficRecorder::TrafficRecorder() = default;
+
+TrafficRecorder::~TrafficRecorder()
+{
+    close();
+}
+
+bool TrafficRecorder::open(const QString& path, uint32_t localIPv4, uint16_t localPort)
+{
+    if (isOpen()) {
+        close();
+    }
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_error = m_file.errorString();
+        LOG_CAT_ERROR("UDP", QString("Не удалось открыть файл захвата %1: %2").arg(path, m_error));
+        return false;
+    }
+
+    m_localIPv4 = localIPv4;
+    m_localPort = localPort;
+    m_ipId = 0;
+
+    if (!writeHeaderBlocks()) {
+        m_error = m_file.errorString();
+        m_file.close();
+        return false;
+    }
+
+    if (!m_ring) {
+        m_ring = std::make_unique<Ring>();
+    }
+    m_captured.store(0);
+    m_stop.store(false);
+
+    m_thread = QThread::create([this]() { writerLoop(); });
+    m_thread->setObjectName("PPB_CAPTURE");
+    m_thread->start(QThread::LowPriority);
+
+    LOG_CAT_INFO("UDP", QString("Захват трафика в %1").arg(path));
+    return true;
+}
+
+void TrafficRecorder::close()
+{
+    if (!m_thread) {
+        return;
+    }
+
+    // Поток записи допишет все, что осталось в кольце, и завершится
+    m_stop.store(true);
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+
+    m_file.flush();
+    m_file.close();
+
+    LOG_CAT_INFO("UDP", QString("Захват трафика остановлен: записано %1, отброшено %2")
+                 .arg(captured()).arg(dropped()));
+}
+
+void TrafficRecorder::capture(Direction direction, int64_t timestampNs,
+                              uint32_t remoteIPv4, uint16_t remotePort,
+                              const uint8_t* data, int size)
+{
+    if (!m_thread || size < 0) {
+        return;
+    }
+
+    Record record;
+    record.timestampNs = timestampNs;
+    record.remoteIPv4 = remoteIPv4;
+    record.remotePort = remotePort;
+    record.originalSize = static_cast<uint16_t>(qMin(size, 0xFFFF - PcapNg::IPV4_UDP_HEADER_SIZE));
+    record.capturedSize = static_cast<uint8_t>(qMin(size, CAPTURE_MAX_PAYLOAD));
+    record.direction = direction;
+    memcpy(record.data, data, record.capturedSize);
+
+    m_ring->tryPush(record);
+}
+
+void TrafficRecorder::writerLoop()
+{
+    constexpr int BATCH = 256;
+    std::unique_ptr<Record[]> batch(new Record[BATCH]);
+
+    for (;;) {
+        // Флаг читаем до опустошения кольца: после stop писатель уже ничего не кладет
+        const bool stopping = m_stop.load();
+
+        const size_t count = m_ring->popBatch(batch.get(), BATCH);
+        for (size_t i = 0; i < count; ++i) {
+            writePacketBlock(batch[i]);
+        }
+        m_captured.fetch_add(count, std::memory_order_relaxed);
+
+        if (count == 0) {
+            if (stopping) {
+                break;
+            }
+            QThread::msleep(5);
+        }
+    }
+}
+
+bool TrafficRecorder::writeHeaderBlocks()
+{
+    QByteArray header = PcapNg::sectionHeaderBlock("PPB_Tester_Software");
+    header += PcapNg::interfaceDescriptionBlock(PcapNg::LINKTYPE_IPV4, PcapNg::IPV4_UDP_HEADER_SIZE + CAPTURE_MAX_PAYLOAD);
+    return m_file.write(header) == header.size();
+}
+
+void TrafficRecorder::writePacketBlock(const Record& record)
+{
+    const bool inbound = record.direction == Direction::Inbound;
+
+    PcapNg::UdpEndpoints endpoints;
+    endpoints.srcIPv4 = inbound ? record.remoteIPv4 : m_localIPv4;
+    endpoints.srcPort = inbound ? record.remotePort : m_localPort;
+    endpoints.dstIPv4 = inbound ? m_localIPv4 : record.remoteIPv4;
+    endpoints.dstPort = inbound ? m_localPort : record.remotePort;
+
+    const QByteArray packet = PcapNg::ipv4UdpPacket(endpoints, m_ipId++,
+                                                    record.data, record.capturedSize, record.originalSize);
+
+    const uint32_t flags = inbound ? PcapNg::EPB_FLAG_INBOUND : PcapNg::EPB_FLAG_OUTBOUND;
+    const QByteArray block = PcapNg::enhancedPacketBlock(record.timestampNs, packet,
+                                                         PcapNg::IPV4_UDP_HEADER_SIZE + record.originalSize,
+                                                         flags);
+    m_file.write(block);
+}
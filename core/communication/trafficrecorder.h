@@ -0,0 +1,76 @@
+#ifndef TRAFFICRECORDER_H
+#define TRAFFICRECORDER_H
+
+#include <QString>
+#include <QFile>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "../utilits/spscring.h"
+
+class QThread;
+
+// ===== ЗАПИСЬ ТРАФИКА В PCAP-NG =====
+// Каждая датаграмма UDPClient (прием и передача) пишется как IPv4/UDP-пакет
+// с меткой времени в наносекундах и флагом направления (epb_flags).
+// Поток сокета только копирует запись в ограниченное SPSC-кольцо; в файл пишет
+// фоновый поток. При переполнении кольца записи отбрасываются и считаются -
+// захват никогда не тормозит прием.
+class TrafficRecorder
+{
+public:
+    enum class Direction : uint8_t {
+        Inbound = 1,
+        Outbound = 2
+    };
+
+    static constexpr int CAPTURE_MAX_PAYLOAD = 64;      // байт полезной нагрузки в записи
+    static constexpr int CAPTURE_RING_CAPACITY = 16384;
+
+    TrafficRecorder();
+    ~TrafficRecorder();
+
+    // Создает файл, пишет заголовки секции и интерфейса, запускает поток записи
+    bool open(const QString& path, uint32_t localIPv4, uint16_t localPort);
+    void close();
+    bool isOpen() const { return m_thread != nullptr; }
+    QString errorString() const { return m_error; }
+
+    // Вызывать только из потока сокета (единственный писатель кольца).
+    // data - байты в том виде, в котором они были на проводе
+    void capture(Direction direction, int64_t timestampNs,
+                 uint32_t remoteIPv4, uint16_t remotePort,
+                 const uint8_t* data, int size);
+
+    uint64_t captured() const { return m_captured.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return m_ring ? m_ring->dropped() : 0; }
+
+private:
+    struct Record {
+        int64_t timestampNs;
+        uint32_t remoteIPv4;
+        uint16_t remotePort;
+        uint16_t originalSize;
+        uint8_t capturedSize;
+        Direction direction;
+        uint8_t data[CAPTURE_MAX_PAYLOAD];
+    };
+    using Ring = SpscRing<Record, CAPTURE_RING_CAPACITY>;
+
+    void writerLoop();
+    bool writeHeaderBlocks();
+    void writePacketBlock(const Record& record);
+
+    QFile m_file;
+    QString m_error;
+    uint32_t m_localIPv4 = 0;
+    uint16_t m_localPort = 0;
+    uint16_t m_ipId = 0;
+
+    std::unique_ptr<Ring> m_ring;
+    QThread* m_thread = nullptr;
+    std::atomic<bool> m_stop{false};
+    std::atomic<uint64_t> m_captured{0};
+};
+
+#endif // TRAFFICRECORDER_H
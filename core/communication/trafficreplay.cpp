@@ -0,0 +1,153 @@
+#include "trafficreplay.h"
+#include "pcapng.h"
+#include <QTimer>
+#include <utility>
+
+#include "../logging/logging_unified.h"
+
+TrafficReplay::TrafficReplay(QObject* parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &TrafficReplay::replayNext);
+}
+
+TrafficReplay::~TrafficReplay() = default;
+
+bool TrafficReplay::load(const QString& path)
+{
+    stop();
+    m_datagrams.clear();
+
+    PcapNg::Reader reader;
+    if (!reader.open(path)) {
+        m_error = reader.errorString();
+        LOG_CAT_ERROR("Engine", QString("Воспроизведение: не удалось открыть %1: %2").arg(path, m_error));
+        return false;
+    }
+
+    PcapNg::PacketRecord record;
+    int64_t firstNs = -1;
+    int skipped = 0;
+
+    while (reader.next(record)) {
+        // Без флагов направления считаем пакет входящим
+        if (record.hasFlags && (record.flags & 0x3) != PcapNg::EPB_FLAG_INBOUND) {
+            continue;
+        }
+
+        PcapNg::UdpEndpoints endpoints;
+        QByteArray payload;
+        if (!PcapNg::parseIpv4Udp(record.packet, endpoints, payload)) {
+            ++skipped;
+            continue;
+        }
+
+        if (firstNs < 0) {
+            firstNs = record.timestampNs;
+        }
+
+        Datagram datagram;
+        datagram.offsetNs = record.timestampNs - firstNs;
+        datagram.data = payload;
+        datagram.sender = QHostAddress(endpoints.srcIPv4);
+        datagram.port = endpoints.srcPort;
+        m_datagrams.append(datagram);
+    }
+
+    if (!reader.errorString().isEmpty()) {
+        LOG_CAT_WARNING("Engine", QString("Воспроизведение: %1, загружено %2 датаграмм")
+                        .arg(reader.errorString()).arg(m_datagrams.size()));
+    }
+
+    LOG_CAT_INFO("Engine", QString("Воспроизведение: загружено %1 входящих датаграмм из %2 (пропущено %3)")
+                 .arg(m_datagrams.size()).arg(path).arg(skipped));
+    return true;
+}
+
+void TrafficReplay::start(double speed)
+{
+    if (m_datagrams.isEmpty()) {
+        LOG_CAT_WARNING("Engine", "Воспроизведение: нет загруженных датаграмм");
+        emit finished(0);
+        return;
+    }
+
+    m_speed = qMax(0.0, speed);
+    m_next = 0;
+    m_running = true;
+    m_clock.start();
+
+    LOG_CAT_INFO("Engine", QString("Воспроизведение %1 датаграмм, скорость %2")
+                 .arg(m_datagrams.size())
+                 .arg(m_speed > 0 ? QString("x%1").arg(m_speed) : QString("максимальная")));
+
+    m_timer->start(0);
+}
+
+void TrafficReplay::stop()
+{
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    m_timer->stop();
+    emit finished(m_next);
+}
+
+void TrafficReplay::replayNext()
+{
+    if (!m_running) {
+        return;
+    }
+
+    const int total = m_datagrams.size();
+
+    if (m_speed <= 0.0) {
+        // Максимальная скорость: пачками, между пачками отдаем управление циклу событий
+        const int end = qMin(total, m_next + FAST_BATCH);
+        while (m_next < end && m_running) {
+            emitDatagram(m_datagrams[m_next++]);
+        }
+    } else {
+        // Как записано: выдаем все, чье время уже наступило
+        const int64_t nowNs = static_cast<int64_t>(m_clock.nsecsElapsed() * m_speed);
+        while (m_next < total && m_running && m_datagrams[m_next].offsetNs <= nowNs) {
+            emitDatagram(m_datagrams[m_next++]);
+        }
+    }
+
+    emit progress(m_next, total);
+
+    if (!m_running) {
+        return;
+    }
+
+    if (m_next >= total) {
+        m_running = false;
+        LOG_CAT_INFO("Engine", QString("Воспроизведение завершено: %1 датаграмм за %2 мс")
+                     .arg(total).arg(m_clock.elapsed()));
+        emit finished(total);
+        return;
+    }
+
+    int waitMs = 0;
+    if (m_speed > 0.0) {
+        const int64_t dueNs = static_cast<int64_t>(m_datagrams[m_next].offsetNs / m_speed);
+        const int64_t waitNs = dueNs - m_clock.nsecsElapsed();
+        waitMs = waitNs > 0 ? static_cast<int>(waitNs / 1000000) : 0;
+    }
+    m_timer->start(waitMs);
+}
+
+void TrafficReplay::emitDatagram(const Datagram& datagram)
+{
+    // Как UDPClient::readPendingDatagrams: ППБ передает байты адреса в обратном порядке
+    QByteArray data = datagram.data;
+    if (data.size() >= 2) {
+        std::swap(data[0], data[1]);
+    }
+    emit datagramReplayed(data, datagram.sender, datagram.port);
+}
@@ -0,0 +1,66 @@
+#ifndef TRAFFICREPLAY_H
+#define TRAFFICREPLAY_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QVector>
+
+class QTimer;
+
+// ===== ВОСПРОИЗВЕДЕНИЕ ЗАПИСАННОГО ТРАФИКА =====
+// Читает pcap-ng, записанный TrafficRecorder (или tcpdump с LINKTYPE_IPV4), и выдает
+// принятые датаграммы сигналом datagramReplayed в том же виде, что UDPClient::dataReceived
+// (байты адреса уже переставлены). Исходящие пакеты пропускаются.
+// Живет в потоке движка; создается и подключается в communicationengine::replayCapture.
+class TrafficReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TrafficReplay(QObject* parent = nullptr);
+    ~TrafficReplay() override;
+
+    // Загружает входящие датаграммы файла в память
+    bool load(const QString& path);
+    QString errorString() const { return m_error; }
+    int datagramCount() const { return m_datagrams.size(); }
+
+    bool isRunning() const { return m_running; }
+
+    static constexpr int FAST_BATCH = 256;   // датаграмм за одну итерацию без пауз
+
+public slots:
+    // speed: 1.0 - как записано, 2.0 - вдвое быстрее, 0 - без пауз (максимально быстро)
+    void start(double speed = 1.0);
+    void stop();
+
+signals:
+    void datagramReplayed(const QByteArray& data, const QHostAddress& sender, quint16 port);
+    void progress(int current, int total);
+    void finished(int replayed);
+
+private slots:
+    void replayNext();
+
+private:
+    struct Datagram {
+        int64_t offsetNs;        // от первой датаграммы записи
+        QByteArray data;         // как на проводе
+        QHostAddress sender;
+        quint16 port;
+    };
+
+    void emitDatagram(const Datagram& datagram);
+
+    QVector<Datagram> m_datagrams;
+    QString m_error;
+
+    QTimer* m_timer;
+    QElapsedTimer m_clock;
+    double m_speed = 1.0;
+    int m_next = 0;
+    bool m_running = false;
+};
+
+#endif // TRAFFICREPLAY_H
@@ -1,9 +1,107 @@
 #include "udpclient.h"
+#include "trafficrecorder.h"
 #include "../logwrapper.h"
 #include <QNetworkDatagram>
 #include <QDebug>
 #include <QThread>
 #include <QVariant>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace {
+
+constexpr int RX_POLL_TIMEOUT_MS = 50;   // как часто поток приема проверяет флаг остановки
+
+// Место под управляющие сообщения одной датаграммы: SCM_TIMESTAMPNS и SO_RXQ_OVFL
+constexpr size_t RX_CONTROL_SIZE = CMSG_SPACE(sizeof(timespec)) + CMSG_SPACE(sizeof(uint32_t));
+using RxControl = char[RX_CONTROL_SIZE];
+
+// Заголовки recvmmsg, указывающие прямо в записи RxDatagram
+void prepareRecvHeaders(mmsghdr* headers, iovec* vectors, sockaddr_in* senders,
+                        RxControl* controls, RxDatagram* records, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        vectors[i].iov_base = records[i].data;
+        vectors[i].iov_len = RX_DATAGRAM_MAX_SIZE;
+
+        msghdr& hdr = headers[i].msg_hdr;
+        hdr.msg_name = &senders[i];
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &vectors[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = controls[i];
+        hdr.msg_controllen = RX_CONTROL_SIZE;
+        hdr.msg_flags = 0;
+        headers[i].msg_len = 0;
+    }
+}
+
+// Разбор управляющих сообщений: метка времени ядра (0, если нет) и
+// накопительный счетчик отброшенных ядром датаграмм SO_RXQ_OVFL (если ядро его приложило)
+void parseRecvControl(const msghdr& header, int64_t& timestampNs, uint32_t* kernelDrops)
+{
+    timestampNs = 0;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(const_cast<msghdr*>(&header)); cmsg;
+         cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&header), cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            timestampNs = int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+        } else if (cmsg->cmsg_type == SO_RXQ_OVFL && kernelDrops) {
+            memcpy(kernelDrops, CMSG_DATA(cmsg), sizeof(uint32_t));
+        }
+    }
+}
+
+// Счетчик SO_RXQ_OVFL из первой ждущей датаграммы, не извлекая ее (MSG_PEEK): для чтения
+// через Qt, которое управляющие сообщения не отдает. Счетчик не меняется, если ядро его не приложило
+bool peekKernelDrops(int fd, uint32_t& kernelDrops)
+{
+    uint8_t byte = 0;
+    iovec vector;
+    vector.iov_base = &byte;
+    vector.iov_len = 1;
+    RxControl control;
+    msghdr header = {};
+    header.msg_iov = &vector;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = RX_CONTROL_SIZE;
+    if (recvmsg(fd, &header, MSG_PEEK | MSG_DONTWAIT) < 0) {
+        return false;
+    }
+    int64_t timestampNs = 0;
+    parseRecvControl(header, timestampNs, &kernelDrops);
+    return true;
+}
+
+void finishRecvRecord(RxDatagram& record, const mmsghdr& header, const sockaddr_in& sender,
+                      uint32_t* kernelDrops)
+{
+    int64_t kernelNs = 0;
+    parseRecvControl(header.msg_hdr, kernelNs, kernelDrops);
+    record.rxTimestampNs = kernelNs ? kernelNs : wallClockNs();
+    record.truncated = (header.msg_hdr.msg_flags & MSG_TRUNC) != 0;
+    record.size = static_cast<uint8_t>(qMin<unsigned>(header.msg_len, RX_DATAGRAM_MAX_SIZE));
+    record.senderIPv4 = ntohl(sender.sin_addr.s_addr);
+    record.senderPort = ntohs(sender.sin_port);
+    if (record.size >= 2) {
+        swapAddressBytes(record.data);
+    }
+}
+
+} // namespace
+#endif
 
 #include "../logging/logging_unified.h"
 UDPClient::UDPClient(QObject* parent)
@@ -11,7 +109,16 @@ UDPClient::UDPClient(QObject* parent)
     , m_socket(nullptr)
     , m_isBound(false)
     , m_boundPort(0)
+#ifdef Q_OS_LINUX
+    , m_batchedReceive(true)    // на Linux по умолчанию принимаем пачками через recvmmsg
+#else
+    , m_batchedReceive(false)
+#endif
+    , m_receiveThreadEnabled(qEnvironmentVariableIntValue("PPB_RX_THREAD") != 0)
 {
+    // Слэб под пакетный прием выделяем один раз
+    m_rxSlab.resize(RX_BATCH_CAPACITY);
+
     // Сокет будет создан позже в initializeInThread()
 }
 
@@ -19,6 +126,12 @@ UDPClient::~UDPClient()
 {
     LOG_CAT_INFO("UDP", "UDPClient деструктор");
 
+    stopCapture();
+
+#ifdef Q_OS_LINUX
+    stopReceiveThread();
+#endif
+
     if (m_socket) {
         m_socket->close();
         delete m_socket;
@@ -60,14 +173,6 @@ void UDPClient::setupSocket()
     m_socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, 65536);
     m_socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, 65536);
 
-    // Пробуем привязаться к порту 101
-    if (!bind(101)) {
-        throw std::runtime_error("Не удалось привязаться к порту 101");
-    }
-
-    // Подключаем сигналы
-    connect(m_socket, &QUdpSocket::readyRead, this, &UDPClient::readPendingDatagrams);
-
     // Сигнал об ошибках сокета
     connect(m_socket, &QUdpSocket::errorOccurred,
             this, [this](QAbstractSocket::SocketError error) {
@@ -78,9 +183,66 @@ void UDPClient::setupSocket()
                 emit errorOccurred(errorMsg);
             });
 
+    // Пробуем привязаться к порту 101 (PPB_BIND_PORT - для работы с симулятором).
+    // Параметры приема и поток приема настраивает bind - так же и при повторной привязке
+    const quint16 port = configuredBindPort();
+    if (!bind(port)) {
+        throw std::runtime_error(QString("Не удалось привязаться к порту %1").arg(port).toStdString());
+    }
+
     LOG_CAT_INFO("UDP", " сокет настроен и привязан к порту " + QString::number(m_boundPort));
 }
 
+// После каждой привязки дескриптор новый: параметры приема ставятся заново,
+// поток приема (если включен) перезапускается на новом дескрипторе
+void UDPClient::setupReceivePath()
+{
+#ifdef Q_OS_LINUX
+    // Метки времени приема от ядра - для измерения задержек ответа ППБ
+    int timestampOn = 1;
+    if (setsockopt(static_cast<int>(m_socket->socketDescriptor()), SOL_SOCKET, SO_TIMESTAMPNS,
+                   &timestampOn, sizeof(timestampOn)) != 0) {
+        LOG_CAT_WARNING("UDP", QString("SO_TIMESTAMPNS недоступен (errno %1), метки времени - при чтении").arg(errno));
+    }
+
+    // Счетчик датаграмм, отброшенных ядром из-за переполнения буфера приема; у нового сокета - с нуля
+    m_kernelDropCounter.store(0, std::memory_order_relaxed);
+    m_reportedDropCounter = 0;
+    int overflowOn = 1;
+    if (setsockopt(static_cast<int>(m_socket->socketDescriptor()), SOL_SOCKET, SO_RXQ_OVFL,
+                   &overflowOn, sizeof(overflowOn)) != 0) {
+        LOG_CAT_WARNING("UDP", QString("SO_RXQ_OVFL недоступен (errno %1), потери на хосте не видны").arg(errno));
+    }
+#endif
+
+    // При работающем потоке приема сокет читает только он:
+    // readyRead не подключаем, нотификатор QUdpSocket без чтения сам отключится
+    bool readByThread = false;
+#ifdef Q_OS_LINUX
+    readByThread = m_receiveThreadEnabled && startReceiveThread();
+#endif
+    if (readByThread) {
+        disconnect(m_socket, &QUdpSocket::readyRead, this, &UDPClient::readPendingDatagrams);
+    } else {
+        connect(m_socket, &QUdpSocket::readyRead, this, &UDPClient::readPendingDatagrams,
+                Qt::UniqueConnection);
+    }
+}
+
+// Адрес интерфейса тестера в сети бриджа; PPB_BIND_ADDRESS=127.0.0.1 - для ppb_simulator
+QHostAddress UDPClient::configuredBindAddress()
+{
+    const QString address = qEnvironmentVariable("PPB_BIND_ADDRESS");
+    return address.isEmpty() ? QHostAddress("192.168.0.246") : QHostAddress(address);
+}
+
+quint16 UDPClient::configuredBindPort()
+{
+    bool ok = false;
+    const int port = qEnvironmentVariableIntValue("PPB_BIND_PORT", &ok);
+    return (ok && port > 0 && port <= 0xFFFF) ? static_cast<quint16>(port) : 101;
+}
+
 bool UDPClient::bind(quint16 port)
 {
     if (!m_socket) {
@@ -96,9 +258,7 @@ bool UDPClient::bind(quint16 port)
     LOG_CAT_INFO("UDP","::bind - попытка привязки к порту " + QString::number(port));
 
     // Пробуем привязаться
-
-
-    if (m_socket->bind(QHostAddress("192.168.0.246"), port)) {//ping  -t QHostAddress::AnyIPv4
+    if (m_socket->bind(configuredBindAddress(), port)) {//ping  -t QHostAddress::AnyIPv4
 
         m_isBound = true;
         m_boundPort = m_socket->localPort();
@@ -107,6 +267,8 @@ bool UDPClient::bind(quint16 port)
         LOG_CAT_INFO("UDP", "успешно привязан к порту " + QString::number(m_boundPort) +
                  " на адресе " + m_boundAddress.toString());
 
+        setupReceivePath();
+
         emit bindingChanged(true);
         return true;
     } else {
@@ -124,6 +286,9 @@ void UDPClient::unbind()
     LOG_CAT_INFO("UDP", "::unbind");
 
     if (m_socket && m_isBound) {
+#ifdef Q_OS_LINUX
+        stopReceiveThread();
+#endif
         m_socket->close();
         m_isBound = false;
         m_boundPort = 0;
@@ -145,6 +310,10 @@ qint64 UDPClient::sendTo(const QByteArray& data, const QString& address, quint16
     LOG_CAT_DEBUG("UDP", QString("::sendTo: адрес=%1, порт=%2, размер=%3 байт")
                   .arg(address).arg(port).arg(data.size()));
 
+    if (m_loopback) {
+        return sendTo(data, QHostAddress(address), port);
+    }
+
     if (!m_socket) {
         LOG_CAT_ERROR("UDP", "::sendTo - сокет не инициализирован");
         emit errorOccurred("Сокет не инициализирован");
@@ -157,36 +326,172 @@ qint64 UDPClient::sendTo(const QByteArray& data, const QString& address, quint16
         return -1;
     }
 
-    QHostAddress hostAddress;
-    if (!hostAddress.setAddress(address)) {
-        LOG_CAT_ERROR("UDP","::sendTo - неверный адрес: " + address);
-        emit errorOccurred("Неверный адрес: " + address);
+    QHostAddress hostAddress = m_resolvedHosts.value(address);
+    if (hostAddress.isNull()) {
+        if (!hostAddress.setAddress(address)) {
+            LOG_CAT_ERROR("UDP","::sendTo - неверный адрес: " + address);
+            emit errorOccurred("Неверный адрес: " + address);
+            return -1;
+        }
+        m_resolvedHosts.insert(address, hostAddress);
+    }
+
+    return sendTo(data, hostAddress, port);
+}
+
+qint64 UDPClient::sendTo(const QByteArray& data, const QHostAddress& address, quint16 port)
+{
+    if (m_loopback) {
+        m_loopback(data.constData(), data.size(), address, port);
+        emit dataSent(data.size());
+        return data.size();
+    }
+
+    if (!m_socket) {
+        LOG_CAT_ERROR("UDP", "::sendTo - сокет не инициализирован");
+        emit errorOccurred("Сокет не инициализирован");
+        return -1;
+    }
+
+    if (!m_isBound) {
+        LOG_CAT_ERROR("UDP", "::sendTo - сокет не привязан");
+        emit errorOccurred("Сокет не привязан к порту");
         return -1;
     }
 
-    qint64 bytesSent = m_socket->writeDatagram(data, hostAddress, port);
+    qint64 bytesSent = m_socket->writeDatagram(data, address, port);
 
     if (bytesSent == -1) {
         QString errorMsg = QString("Ошибка отправки на %1:%2: %3")
-                               .arg(address)
+                               .arg(address.toString())
                                .arg(port)
                                .arg(m_socket->errorString());
         LOG_CAT_ERROR("UDP", errorMsg);
         emit errorOccurred(errorMsg);
     } else {
         LOG_CAT_DEBUG("UDP", QString("отправлено %1 байт на %2:%3")
-                      .arg(bytesSent).arg(address).arg(port));
+                      .arg(bytesSent).arg(address.toString()).arg(port));
+        if (m_recorder) {
+            m_recorder->capture(TrafficRecorder::Direction::Outbound, wallClockNs(),
+                                address.toIPv4Address(), port,
+                                reinterpret_cast<const uint8_t*>(data.constData()), data.size());
+        }
         emit dataSent(bytesSent);
     }
 
     return bytesSent;
 }
 
+int UDPClient::sendDatagrams(const char* records, int recordSize, int count,
+                             const QHostAddress& address, quint16 port)
+{
+    if (m_loopback) {
+        for (int i = 0; i < count; ++i) {
+            m_loopback(records + i * recordSize, recordSize, address, port);
+        }
+        emit dataSent(static_cast<qint64>(count) * recordSize);
+        return count;
+    }
+
+    if (!m_socket) {
+        LOG_CAT_ERROR("UDP", "::sendDatagrams - сокет не инициализирован");
+        emit errorOccurred("Сокет не инициализирован");
+        return -1;
+    }
+
+    if (!m_isBound) {
+        LOG_CAT_ERROR("UDP", "::sendDatagrams - сокет не привязан");
+        emit errorOccurred("Сокет не привязан к порту");
+        return -1;
+    }
+
+    int sent = 0;
+
+#ifdef Q_OS_LINUX
+    if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+        sockaddr_in destination = {};
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons(port);
+        destination.sin_addr.s_addr = htonl(address.toIPv4Address());
+
+        const int fd = static_cast<int>(m_socket->socketDescriptor());
+        mmsghdr headers[TX_BATCH_CAPACITY];
+        iovec vectors[TX_BATCH_CAPACITY];
+
+        while (sent < count) {
+            const int chunk = qMin(count - sent, TX_BATCH_CAPACITY);
+            for (int i = 0; i < chunk; ++i) {
+                vectors[i].iov_base = const_cast<char*>(records + (sent + i) * recordSize);
+                vectors[i].iov_len = recordSize;
+
+                msghdr& hdr = headers[i].msg_hdr;
+                hdr.msg_name = &destination;
+                hdr.msg_namelen = sizeof(destination);
+                hdr.msg_iov = &vectors[i];
+                hdr.msg_iovlen = 1;
+                hdr.msg_control = nullptr;
+                hdr.msg_controllen = 0;
+                hdr.msg_flags = 0;
+            }
+
+            int result = sendmmsg(fd, headers, chunk, 0);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+                    QString errorMsg = QString("Ошибка sendmmsg на %1:%2: errno %3")
+                                           .arg(address.toString()).arg(port).arg(errno);
+                    LOG_CAT_ERROR("UDP", errorMsg);
+                    emit errorOccurred(errorMsg);
+                    if (sent == 0) {
+                        return -1;
+                    }
+                }
+                break;   // буфер сокета заполнен - остаток дошлет вызывающий
+            }
+            sent += result;
+            if (result < chunk) {
+                break;
+            }
+        }
+    } else
+#endif
+    {
+        for (; sent < count; ++sent) {
+            qint64 bytes = m_socket->writeDatagram(records + sent * recordSize, recordSize, address, port);
+            if (bytes != recordSize) {
+                break;
+            }
+        }
+    }
+
+    LOG_CAT_DEBUG("UDP", QString("отправлено %1 из %2 датаграмм по %3 байт на %4:%5")
+                  .arg(sent).arg(count).arg(recordSize).arg(address.toString()).arg(port));
+
+    if (sent > 0) {
+        if (m_recorder) {
+            const int64_t timestampNs = wallClockNs();
+            const uint32_t destination = address.toIPv4Address();
+            for (int i = 0; i < sent; ++i) {
+                m_recorder->capture(TrafficRecorder::Direction::Outbound, timestampNs, destination, port,
+                                    reinterpret_cast<const uint8_t*>(records + i * recordSize), recordSize);
+            }
+        }
+        emit dataSent(static_cast<qint64>(sent) * recordSize);
+    }
+    return sent;
+}
+
 qint64 UDPClient::sendBroadcast(const QByteArray& data, quint16 port)
 {
     LOG_DEBUG(QString("UDPClient::sendBroadcast: порт=%1, размер=%2 байт")
                   .arg(port).arg(data.size()));
 
+    if (m_loopback) {
+        return sendTo(data, QHostAddress(QHostAddress::Broadcast), port);
+    }
+
     if (!m_socket) {
         LOG_CAT_ERROR("UDP","::sendBroadcast - сокет не инициализирован");
         emit errorOccurred("Сокет не инициализирован");
@@ -221,26 +526,86 @@ qint64 UDPClient::sendBroadcast(const QByteArray& data, quint16 port)
     } else {
         LOG_CAT_DEBUG("UDP",QString(" отправлено широковещательно %1 байт на порт %2")
                       .arg(bytesSent).arg(port));
+        if (m_recorder) {
+            m_recorder->capture(TrafficRecorder::Direction::Outbound, wallClockNs(),
+                                QHostAddress(QHostAddress::Broadcast).toIPv4Address(), port,
+                                reinterpret_cast<const uint8_t*>(data.constData()), data.size());
+        }
         emit dataSent(bytesSent);
     }
 
     return bytesSent;
 }
 
+void UDPClient::injectDatagram(const QByteArray& data, const QHostAddress& sender, quint16 port)
+{
+    // Пакетный прием: запись на стеке, как из слэба, - без копии датаграммы
+    bool isIPv4 = false;
+    const quint32 senderIPv4 = sender.toIPv4Address(&isIPv4);
+    if (m_batchedReceive && isIPv4) {
+        RxDatagram record;
+        record.size = static_cast<uint8_t>(qMin<int>(int(data.size()), RX_DATAGRAM_MAX_SIZE));
+        record.truncated = data.size() > RX_DATAGRAM_MAX_SIZE;
+        memcpy(record.data, data.constData(), record.size);
+        if (record.size >= 2) {
+            swapAddressBytes(record.data);
+        }
+        record.senderIPv4 = senderIPv4;
+        record.senderPort = port;
+        record.rxTimestampNs = wallClockNs();
+
+        m_rxStats.batches++;
+        m_rxStats.datagrams++;
+        if (record.truncated) {
+            m_rxStats.truncated++;
+        }
+        emit datagramsReceived(RxBatch{&record, 1});
+        return;
+    }
+
+    QByteArray swapped = data;
+    if (swapped.size() >= 2) {
+        std::swap(swapped[0], swapped[1]);
+    }
+    m_rxStats.datagrams++;
+    emit dataReceived(swapped, sender, port);
+}
+
 void UDPClient::readPendingDatagrams()
 {
     if (!m_socket) {
         return;
     }
 
+    if (m_batchedReceive) {
+        readPendingBatch();
+        return;
+    }
+
+#ifdef Q_OS_LINUX
+    // QNetworkDatagram управляющих сообщений не отдает: счетчик отброшенных ядром - из первой
+    // ждущей датаграммы. Потери после нее будут видны при следующем пробуждении
+    if (m_socket->hasPendingDatagrams()) {
+        uint32_t kernelDrops = m_kernelDropCounter.load(std::memory_order_relaxed);
+        if (peekKernelDrops(static_cast<int>(m_socket->socketDescriptor()), kernelDrops)) {
+            m_kernelDropCounter.store(kernelDrops, std::memory_order_relaxed);
+        }
+    }
+#endif
+
     while (m_socket->hasPendingDatagrams()) {
         QNetworkDatagram datagram = m_socket->receiveDatagram();
 
         if (datagram.isValid()) {
             QByteArray data = datagram.data();
             QHostAddress sender = datagram.senderAddress();
-            std::swap(data[0],data[1]);
             quint16 port = datagram.senderPort();
+            if (m_recorder) {
+                m_recorder->capture(TrafficRecorder::Direction::Inbound, wallClockNs(),
+                                    sender.toIPv4Address(), port,
+                                    reinterpret_cast<const uint8_t*>(data.constData()), data.size());
+            }
+            std::swap(data[0],data[1]);
 
             LOG_CAT_DEBUG("UDP",QString("UDPClient получено %1 байт от %2:%3")
                           .arg(data.size())
@@ -264,4 +629,323 @@ void UDPClient::readPendingDatagrams()
             LOG_CAT_WARNING("UDP","получил невалидную датаграмму");
         }
     }
+
+    checkKernelDrops();
+}
+
+// ===== ПАКЕТНЫЙ ПРИЕМ =====
+
+void UDPClient::readPendingBatch()
+{
+    while (m_socket->hasPendingDatagrams()) {
+        // Первую датаграмму читаем через Qt: это сбрасывает внутренний флаг QUdpSocket
+        // и заново включает нотификатор, иначе после прямого чтения readyRead больше не придет
+        int count = readDatagramIntoSlab(0) ? 1 : 0;
+        if (count == 0) {
+            break;
+        }
+
+#ifdef Q_OS_LINUX
+        count += receiveNativeBatch(count);
+#else
+        while (count < RX_BATCH_CAPACITY && m_socket->hasPendingDatagrams()) {
+            if (!readDatagramIntoSlab(count)) {
+                break;
+            }
+            ++count;
+        }
+#endif
+
+        m_rxStats.batches++;
+        m_rxStats.datagrams += count;
+
+        LOG_CAT_DEBUG("UDP", QString("UDPClient принята пачка из %1 датаграмм").arg(count));
+
+        checkKernelDrops();
+        captureBatch(count);
+
+        emit datagramsReceived(RxBatch{m_rxSlab.data(), count});
+    }
+}
+
+bool UDPClient::readDatagramIntoSlab(int index)
+{
+    RxDatagram& record = m_rxSlab[index];
+    quint16 port = 0;
+
+    qint64 pending = m_socket->pendingDatagramSize();
+    qint64 size = m_socket->readDatagram(reinterpret_cast<char*>(record.data),
+                                         RX_DATAGRAM_MAX_SIZE, &m_rxSender, &port);
+    if (size < 0) {
+        LOG_CAT_WARNING("UDP","получил невалидную датаграмму");
+        return false;
+    }
+
+    record.size = static_cast<uint8_t>(size);
+    record.truncated = pending > RX_DATAGRAM_MAX_SIZE;
+    record.senderIPv4 = m_rxSender.toIPv4Address();
+    record.senderPort = port;
+    record.rxTimestampNs = wallClockNs();   // readDatagram метку ядра не отдает
+    if (record.truncated) {
+        m_rxStats.truncated++;
+    }
+    if (record.size >= 2) {
+        swapAddressBytes(record.data);
+    }
+    return true;
+}
+
+#ifdef Q_OS_LINUX
+// Забираем из сокета все, что накопилось, одним recvmmsg в свободную часть слэба
+int UDPClient::receiveNativeBatch(int offset)
+{
+    const int capacity = RX_BATCH_CAPACITY - offset;
+    if (capacity <= 0) {
+        return 0;
+    }
+
+    mmsghdr headers[RX_BATCH_CAPACITY];
+    iovec vectors[RX_BATCH_CAPACITY];
+    sockaddr_in senders[RX_BATCH_CAPACITY];
+    RxControl controls[RX_BATCH_CAPACITY];
+    prepareRecvHeaders(headers, vectors, senders, controls, &m_rxSlab[offset], capacity);
+
+    const int fd = static_cast<int>(m_socket->socketDescriptor());
+    int received = recvmmsg(fd, headers, capacity, MSG_DONTWAIT, nullptr);
+    if (received < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_CAT_WARNING("UDP", QString("recvmmsg: ошибка %1").arg(errno));
+        }
+        return 0;
+    }
+
+    uint32_t kernelDrops = m_kernelDropCounter.load(std::memory_order_relaxed);
+    for (int i = 0; i < received; ++i) {
+        RxDatagram& record = m_rxSlab[offset + i];
+        finishRecvRecord(record, headers[i], senders[i], &kernelDrops);
+        if (record.truncated) {
+            m_rxStats.truncated++;
+        }
+    }
+
+    m_kernelDropCounter.store(kernelDrops, std::memory_order_relaxed);
+
+    return received;
+}
+
+// ===== ПОТОК ПРИЕМА =====
+
+bool UDPClient::startReceiveThread()
+{
+    if (m_rxThread) {
+        return true;
+    }
+
+    const int fd = static_cast<int>(m_socket->socketDescriptor());
+    if (fd < 0) {
+        LOG_CAT_WARNING("UDP", "поток приема не запущен: нет дескриптора сокета");
+        return false;
+    }
+
+    if (!m_rxRing) {
+        m_rxRing = std::make_unique<RxRing>();
+    }
+    m_rxThreadStop.store(false);
+    m_rxDrainPending.store(false);
+
+    m_rxThread = QThread::create([this, fd]() { receiveThreadLoop(fd); });
+    m_rxThread->setObjectName("PPB_UDP_RX");
+    m_rxThread->start(QThread::TimeCriticalPriority);
+
+    LOG_CAT_INFO("UDP", QString("запущен поток приема, кольцо на %1 записей").arg(RX_RING_CAPACITY));
+    return true;
+}
+
+void UDPClient::stopReceiveThread()
+{
+    if (!m_rxThread) {
+        return;
+    }
+
+    m_rxThreadStop.store(true);
+    m_rxThread->wait();
+    delete m_rxThread;
+    m_rxThread = nullptr;
+
+    // То, что осталось в кольце, отдаем обработчику
+    drainRxRing();
+
+    LOG_CAT_INFO("UDP", QString("поток приема остановлен, отброшено при переполнении: %1")
+                 .arg(m_rxRing ? m_rxRing->dropped() : 0));
+}
+
+// Тело потока приема: только чтение сокета и запись в кольцо.
+// Никаких логов и сигналов на пакет - поток UDPClient будится одним событием на серию
+void UDPClient::receiveThreadLoop(int fd)
+{
+    mmsghdr headers[RX_BATCH_CAPACITY];
+    iovec vectors[RX_BATCH_CAPACITY];
+    sockaddr_in senders[RX_BATCH_CAPACITY];
+    RxControl controls[RX_BATCH_CAPACITY];
+    RxDatagram records[RX_BATCH_CAPACITY];
+
+    while (!m_rxThreadStop.load(std::memory_order_relaxed)) {
+        pollfd descriptor = {};
+        descriptor.fd = fd;
+        descriptor.events = POLLIN;
+
+        const int ready = poll(&descriptor, 1, RX_POLL_TIMEOUT_MS);
+        if (ready <= 0) {
+            continue;   // таймаут (проверка флага остановки) или EINTR
+        }
+        if (descriptor.revents & (POLLERR | POLLNVAL)) {
+            break;
+        }
+
+        prepareRecvHeaders(headers, vectors, senders, controls, records, RX_BATCH_CAPACITY);
+        const int received = recvmmsg(fd, headers, RX_BATCH_CAPACITY, MSG_DONTWAIT, nullptr);
+        if (received <= 0) {
+            continue;
+        }
+
+        uint32_t kernelDrops = m_kernelDropCounter.load(std::memory_order_relaxed);
+        for (int i = 0; i < received; ++i) {
+            finishRecvRecord(records[i], headers[i], senders[i], &kernelDrops);
+            m_rxRing->tryPush(records[i]);
+        }
+        m_kernelDropCounter.store(kernelDrops, std::memory_order_relaxed);
+
+        // Одно пробуждение на серию: пока предыдущее не обработано, новое не ставим
+        if (!m_rxDrainPending.exchange(true)) {
+            QMetaObject::invokeMethod(this, "drainRxRing", Qt::QueuedConnection);
+        }
+    }
+}
+#endif
+
+void UDPClient::drainRxRing()
+{
+    if (!m_rxRing) {
+        return;
+    }
+
+    // Сбрасываем флаг до чтения: все, что поток приема положит после этого, разбудит нас снова
+    m_rxDrainPending.store(false);
+
+    checkKernelDrops();
+
+    for (;;) {
+        const int count = static_cast<int>(m_rxRing->popBatch(m_rxSlab.data(), RX_BATCH_CAPACITY));
+        if (count == 0) {
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (m_rxSlab[i].truncated) {
+                m_rxStats.truncated++;
+            }
+        }
+        m_rxStats.batches++;
+        m_rxStats.datagrams += count;
+        captureBatch(count);
+
+        emit datagramsReceived(RxBatch{m_rxSlab.data(), count});
+    }
+}
+
+// ===== ЗАХВАТ ТРАФИКА =====
+
+bool UDPClient::startCapture(const QString& path)
+{
+    if (!m_recorder) {
+        m_recorder = std::make_unique<TrafficRecorder>();
+    }
+
+    const uint32_t localIPv4 = m_boundAddress.isNull() ? 0 : m_boundAddress.toIPv4Address();
+    if (!m_recorder->open(path, localIPv4, m_boundPort)) {
+        emit errorOccurred(QString("Не удалось начать захват: %1").arg(m_recorder->errorString()));
+        m_recorder.reset();
+        return false;
+    }
+    return true;
+}
+
+void UDPClient::stopCapture()
+{
+    if (m_recorder) {
+        m_recorder->close();
+        m_recorder.reset();
+    }
+}
+
+// Записи слэба уже с переставленными байтами адреса - в файл пишем как на проводе
+void UDPClient::captureBatch(int count)
+{
+    if (!m_recorder) {
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const RxDatagram& record = m_rxSlab[i];
+        uint8_t wire[RX_DATAGRAM_MAX_SIZE];
+        memcpy(wire, record.data, record.size);
+        if (record.size >= 2) {
+            swapAddressBytes(wire);
+        }
+        m_recorder->capture(TrafficRecorder::Direction::Inbound, record.rxTimestampNs,
+                            record.senderIPv4, record.senderPort, wire, record.size);
+    }
+}
+
+// Сравниваем накопительный счетчик ядра с уже сообщенным
+void UDPClient::checkKernelDrops()
+{
+    // Счетчик ядра 32-битный и может переполниться: разность - тоже по модулю 2^32
+    const uint32_t counter = m_kernelDropCounter.load(std::memory_order_relaxed);
+    const quint64 newDrops = uint32_t(counter - m_reportedDropCounter);
+    if (newDrops == 0) {
+        return;
+    }
+
+    m_reportedDropCounter = counter;
+    m_rxStats.kernelDrops += newDrops;
+    const quint64 total = m_rxStats.kernelDrops;
+
+    LOG_CAT_WARNING("UDP", QString("ядро отбросило %1 датаграмм (всего %2): переполнен буфер приема %3 байт")
+                    .arg(newDrops).arg(total).arg(receiveBufferSize()));
+
+    emit receiveOverflow(newDrops, total);
+}
+
+bool UDPClient::setReceiveBufferSize(int bytes)
+{
+    if (!m_socket) {
+        return false;
+    }
+
+    m_socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, bytes);
+    const int actual = receiveBufferSize();
+
+    LOG_CAT_INFO("UDP", QString("буфер приема: запрошено %1, установлено %2 байт").arg(bytes).arg(actual));
+    return actual >= bytes;
+}
+
+int UDPClient::receiveBufferSize() const
+{
+    if (!m_socket) {
+        return 0;
+    }
+    return m_socket->socketOption(QAbstractSocket::ReceiveBufferSizeSocketOption).toInt();
+}
+
+RxStats UDPClient::rxStats() const
+{
+    RxStats stats = m_rxStats;
+    if (m_rxRing) {
+        stats.ringCapacity = RX_RING_CAPACITY;
+        stats.ringOccupancy = m_rxRing->size();
+        stats.ringHighWater = m_rxRing->highWater();
+        stats.ringDropped = m_rxRing->dropped();
+    }
+    return stats;
 }
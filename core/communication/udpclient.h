@@ -5,6 +5,16 @@
 #include <QObject>
 #include <QUdpSocket>
 #include <QHostAddress>
+#include <QHash>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "rxdatagram.h"
+#include "../utilits/spscring.h"
+
+class QThread;
+class TrafficRecorder;
 
 class UDPClient : public QObject
 {
@@ -21,30 +31,117 @@ public:
     void unbind();
     bool isBound() const;
 
+    // Адрес и порт привязки: по умолчанию 192.168.0.246:101, переопределяются
+    // переменными окружения PPB_BIND_ADDRESS / PPB_BIND_PORT
+    static QHostAddress configuredBindAddress();
+    static quint16 configuredBindPort();
+
     qint64 sendTo(const QByteArray& data, const QString& address, quint16 port);
+    qint64 sendTo(const QByteArray& data, const QHostAddress& address, quint16 port);
+
+    // Пакетная отправка count записей по recordSize байт одним вызовом (sendmmsg на Linux).
+    // Возвращает число отправленных датаграмм (меньше count, если буфер сокета заполнен) или -1
+    int sendDatagrams(const char* records, int recordSize, int count,
+                      const QHostAddress& address, quint16 port);
     qint64 sendBroadcast(const QByteArray& data, quint16 port);
 
     quint16 boundPort() const { return m_boundPort; }
     QHostAddress boundAddress() const { return m_boundAddress; }
 
+    // Пакетный прием: вместо dataReceived на каждую датаграмму - один datagramsReceived на пробуждение
+    void setBatchedReceive(bool enabled) { m_batchedReceive = enabled; }
+    bool isBatchedReceive() const { return m_batchedReceive; }
+    RxStats rxStats() const;
+
+    // Отдельный поток приема (только Linux): poll + recvmmsg прямо с дескриптора сокета,
+    // записи передаются в поток UDPClient через SPSC-кольцо и выдаются теми же
+    // datagramsReceived. Включать до initializeInThread(); по умолчанию - из PPB_RX_THREAD=1
+    void setReceiveThreadEnabled(bool enabled) { m_receiveThreadEnabled = enabled; }
+    bool isReceiveThreadEnabled() const { return m_receiveThreadEnabled; }
+    bool isReceiveThreadRunning() const { return m_rxThread != nullptr; }
+
+    // Запись всех датаграмм (прием и передача) в pcap-ng; файл пишет фоновый поток
+    bool startCapture(const QString& path);
+    void stopCapture();
+    bool isCapturing() const { return m_recorder != nullptr; }
+
+    // Петля вместо сокета (прогоны без оборудования, в том числе в виртуальном времени):
+    // исходящие датаграммы уходят в sink как на проводе (data действительна только на время вызова),
+    // ответы подаются injectDatagram в том виде, в каком пришли бы из сети, и выходят
+    // тем же сигналом, что из сокета: datagramsReceived при пакетном приеме, иначе dataReceived.
+    // Привязка сокета не нужна; пустой sink - вернуться к сокету
+    using LoopbackSink = std::function<void(const char* data, int size, const QHostAddress& address, quint16 port)>;
+    void setLoopback(LoopbackSink sink) { m_loopback = std::move(sink); }
+    bool isLoopback() const { return bool(m_loopback); }
+    void injectDatagram(const QByteArray& data, const QHostAddress& sender, quint16 port);
+
+    // Буфер приема сокета. Linux удваивает запрошенное значение и ограничивает его
+    // net.core.rmem_max, поэтому возвращаем, удалось ли получить не меньше запрошенного
+    bool setReceiveBufferSize(int bytes);
+    int receiveBufferSize() const;
+
+    static constexpr int RX_BATCH_CAPACITY = 64;   // датаграмм за одно пробуждение
+    static constexpr int TX_BATCH_CAPACITY = 64;   // датаграмм за один sendmmsg
+    static constexpr int RX_RING_CAPACITY = 4096;  // записей в кольце потока приема
+
 signals:
     void dataReceived(const QByteArray& data, const QHostAddress& sender, quint16 port);
+    void datagramsReceived(const RxBatch& batch);   // только Qt::DirectConnection - слэб переиспользуется
     void bindingChanged(bool bound);
+    // Ядро отбросило датаграммы из-за переполнения буфера приема (SO_RXQ_OVFL, только Linux)
+    void receiveOverflow(quint64 newDrops, quint64 totalDrops);
     void errorOccurred(const QString& error);
     void dataSent(qint64 bytes);
     void initialized();
 
 private slots:
     void readPendingDatagrams();
+    void drainRxRing();     // вызывается из потока приема через очередь событий
 
 private:
     void setupSocket();
+    void setupReceivePath();   // после каждой успешной привязки
+    void readPendingBatch();
+    bool readDatagramIntoSlab(int index);
+#ifdef Q_OS_LINUX
+    int receiveNativeBatch(int offset);
+    bool startReceiveThread();
+    void stopReceiveThread();
+    void receiveThreadLoop(int fd);
+#endif
+    void checkKernelDrops();
+    void captureBatch(int count);
 
 private:
     QUdpSocket* m_socket;
     bool m_isBound;
     quint16 m_boundPort;
     QHostAddress m_boundAddress;
+
+    // Разобранные адреса бриджей, чтобы не парсить строку IP на каждый пакет
+    QHash<QString, QHostAddress> m_resolvedHosts;
+
+    // Пакетный прием
+    bool m_batchedReceive;
+    std::vector<RxDatagram> m_rxSlab;     // преаллоцирован на RX_BATCH_CAPACITY записей
+    QHostAddress m_rxSender;              // переиспользуемый адрес для readDatagram
+    RxStats m_rxStats;
+
+    // Поток приема
+    using RxRing = SpscRing<RxDatagram, RX_RING_CAPACITY>;
+    bool m_receiveThreadEnabled;
+    std::unique_ptr<RxRing> m_rxRing;
+    QThread* m_rxThread = nullptr;
+    std::atomic<bool> m_rxThreadStop{false};
+    std::atomic<bool> m_rxDrainPending{false};   // пробуждение уже поставлено в очередь
+
+    // Последнее значение счетчика SO_RXQ_OVFL (пишет тот, кто читает сокет)
+    std::atomic<uint32_t> m_kernelDropCounter{0};
+    uint32_t m_reportedDropCounter = 0;   // значение счетчика при последнем сообщении
+
+    std::unique_ptr<TrafficRecorder> m_recorder;
+
+    LoopbackSink m_loopback;
 };
 
 #endif // UDPCLIENT_H
@@ -7,6 +7,10 @@
 #include <QStandardPaths>
 
 #include "../logging/logging_unified.h"
+
+// До создания каналов пропускаются все уровни
+std::atomic<int> LogConfig::s_lowestLevel{LOG_DEBUG};
+
 LogConfig& LogConfig::instance()
 {
     static LogConfig instance;
@@ -127,6 +131,20 @@ void LogConfig::createDefaultChannels()
     consoleConfig.showThreadInfo = true;
     consoleConfig.enabled = false; // По умолчанию выключена
     m_channels["debug_console"] = consoleConfig;
+
+    updateLowestLevel();
+}
+
+void LogConfig::updateLowestLevel()
+{
+    // Каналов нет или все выключены - фильтровать нечем, пропускаем все
+    int lowest = LOG_CRITICAL + 1;
+    for (const LogChannelConfig& config : std::as_const(m_channels)) {
+        if (config.enabled) {
+            lowest = qMin(lowest, int(config.minLevel));
+        }
+    }
+    s_lowestLevel.store(lowest > LOG_CRITICAL ? int(LOG_DEBUG) : lowest, std::memory_order_relaxed);
 }
 void LogConfig::initDefaultConfig()
 {
@@ -143,6 +161,7 @@ void LogConfig::addChannel(const QString& id, const LogChannelConfig& config)
     }
 
     m_channels[id] = config;
+    updateLowestLevel();
     emit channelAdded(id);
 
     LOG_CAT_DEBUG("CONFIG", QString("Добавлен канал логирования: %1").arg(config.name));
@@ -153,6 +172,7 @@ void LogConfig::removeChannel(const QString& id)
     QMutexLocker locker(&m_mutex);
 
     if (m_channels.remove(id)) {
+        updateLowestLevel();
         emit channelRemoved(id);
         LOG_CAT_DEBUG("CONFIG", QString("Удалён канал логирования: %1").arg(id));
     }
@@ -165,6 +185,7 @@ void LogConfig::enableChannel(const QString& id, bool enabled)
     auto it = m_channels.find(id);
     if (it != m_channels.end()) {
         it->enabled = enabled;
+        updateLowestLevel();
         emit configChanged(id);
 
         LOG_CAT_DEBUG("CONFIG",
@@ -332,6 +353,7 @@ bool LogConfig::loadFromFile(const QString& filename)
 
         m_channels[id] = config;
     }
+    updateLowestLevel();
 
     LOG_CAT_INFO("CONFIG",
                  QString("Конфигурация логирования загружена из: %1").arg(filename));
@@ -345,6 +367,7 @@ void LogConfig::setMinLevel(const QString& channelId, LogLevel level)
     auto it = m_channels.find(channelId);
     if (it != m_channels.end()) {
         it->minLevel = level;
+        updateLowestLevel();
         emit configChanged(channelId);
 
         LOG_CAT_DEBUG("CONFIG",
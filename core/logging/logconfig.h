@@ -7,6 +7,7 @@
 #include <QMap>
 #include <QFile>
 #include <QMutex>
+#include <atomic>
 
 // Уровни логирования
 enum LogLevel {
@@ -150,6 +151,12 @@ public:
                             LogLevel level,
                             const QString& category) const;
 
+    // Нужен ли уровень хоть одному включенному каналу. Без блокировки - макросы LOG_*
+    // проверяют его до форматирования сообщения, отключенный уровень ничего не стоит
+    static bool isLevelEnabled(LogLevel level) {
+        return level >= s_lowestLevel.load(std::memory_order_relaxed);
+    }
+
     // Сохранение/загрузка конфигурации
     bool saveToFile(const QString& filename);
     bool loadFromFile(const QString& filename);
@@ -174,6 +181,10 @@ private:
     QMap<QString, LogChannelConfig> m_channels;
     mutable QMutex m_mutex;
 
+    // Наименьший уровень среди включенных каналов (пересчитывается под m_mutex при каждом изменении)
+    static std::atomic<int> s_lowestLevel;
+    void updateLowestLevel();
+
     // Стандартные каналы
     void createDefaultChannels();
 
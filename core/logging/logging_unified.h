@@ -3,6 +3,7 @@
 #define LOGGING_UNIFIED_H
 
 #include "../logwrapper.h"
+#include "logconfig.h"
 
 // ==================== УНИВЕРСАЛЬНЫЕ МАКРОСЫ С МАППИНГОМ ====================
 
@@ -56,17 +57,22 @@ static bool isOperationalCategory(const QString& category) {
 
 // ==================== СТАРЫЕ МАКРОСЫ С АВТОМАТИЧЕСКИМ МАППИНГОМ ====================
 
+// Уровень проверяется до вычисления аргументов: сообщение отключенного уровня
+// (QString(...).arg(...)) не форматируется и не выделяет память
+#define LOG_LEVEL_GUARDED(level, call) \
+    do { if (LogConfig::isLevelEnabled(level)) { call; } } while (0)
+
 // Простые макросы без категории
-#define LOG_DEBUG(msg)            LogWrapper::debug(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg)
-#define LOG_INFO(msg)             LogWrapper::info(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg)
-#define LOG_WARNING(msg)          LogWrapper::warning(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg)
-#define LOG_ERROR(msg)            LogWrapper::error(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg)
+#define LOG_DEBUG(msg)            LOG_LEVEL_GUARDED(LOG_DEBUG, LogWrapper::debug(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg))
+#define LOG_INFO(msg)             LOG_LEVEL_GUARDED(LOG_INFO, LogWrapper::info(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg))
+#define LOG_WARNING(msg)          LOG_LEVEL_GUARDED(LOG_WARNING, LogWrapper::warning(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg))
+#define LOG_ERROR(msg)            LOG_LEVEL_GUARDED(LOG_ERROR, LogWrapper::error(LogCategoryMapper::mapLegacyToNew("GENERAL"), msg))
 
 // Макросы с категорией (автоматический маппинг)
-#define LOG_CAT_DEBUG(cat, msg)   LogWrapper::debug(LogCategoryMapper::mapLegacyToNew(cat), msg)
-#define LOG_CAT_INFO(cat, msg)    LogWrapper::info(LogCategoryMapper::mapLegacyToNew(cat), msg)
-#define LOG_CAT_WARNING(cat, msg) LogWrapper::warning(LogCategoryMapper::mapLegacyToNew(cat), msg)
-#define LOG_CAT_ERROR(cat, msg)   LogWrapper::error(LogCategoryMapper::mapLegacyToNew(cat), msg)
+#define LOG_CAT_DEBUG(cat, msg)   LOG_LEVEL_GUARDED(LOG_DEBUG, LogWrapper::debug(LogCategoryMapper::mapLegacyToNew(cat), msg))
+#define LOG_CAT_INFO(cat, msg)    LOG_LEVEL_GUARDED(LOG_INFO, LogWrapper::info(LogCategoryMapper::mapLegacyToNew(cat), msg))
+#define LOG_CAT_WARNING(cat, msg) LOG_LEVEL_GUARDED(LOG_WARNING, LogWrapper::warning(LogCategoryMapper::mapLegacyToNew(cat), msg))
+#define LOG_CAT_ERROR(cat, msg)   LOG_LEVEL_GUARDED(LOG_ERROR, LogWrapper::error(LogCategoryMapper::mapLegacyToNew(cat), msg))
 
 // Макросы с автоматическим определением файла
 #define LOG_DEBUG_AUTO(msg)       LogWrapper::debug(LogCategoryMapper::mapLegacyToNew(QString(__FILE__)), msg)
@@ -0,0 +1,98 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Кольцевой буфер "один писатель - один читатель" без блокировок.
+// Писатель трогает только m_head, читатель - только m_tail; индексы растут
+// неограниченно, позиция в массиве - индекс & (Capacity - 1).
+// Записи фиксированного размера копируются целиком, аллокаций нет.
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Емкость SpscRing должна быть степенью двойки");
+
+public:
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // ===== Сторона писателя =====
+
+    // false - буфер полон, запись отброшена (учитывается в dropped())
+    bool tryPush(const T& item)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        const size_t used = head - tail;
+
+        if (used >= Capacity) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_items[head & MASK] = item;
+        m_head.store(head + 1, std::memory_order_release);
+
+        if (used + 1 > m_highWater.load(std::memory_order_relaxed)) {
+            m_highWater.store(used + 1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // ===== Сторона читателя =====
+
+    bool tryPop(T& item)
+    {
+        return popBatch(&item, 1) == 1;
+    }
+
+    // Забрать до maxCount записей; возвращает число прочитанных
+    size_t popBatch(T* out, size_t maxCount)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t head = m_head.load(std::memory_order_acquire);
+
+        size_t count = head - tail;
+        if (count > maxCount) {
+            count = maxCount;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = m_items[(tail + i) & MASK];
+        }
+
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // ===== Счетчики (можно читать из любого потока, значения приблизительные) =====
+
+    size_t size() const
+    {
+        // Сначала хвост: голова читается позже и не может оказаться меньше него
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return m_head.load(std::memory_order_acquire) - tail;
+    }
+    bool isEmpty() const { return size() == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+    size_t highWater() const { return m_highWater.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t MASK = Capacity - 1;
+    static constexpr size_t CACHE_LINE = 64;
+
+    // Индексы писателя и читателя на разных кэш-линиях
+    alignas(CACHE_LINE) std::atomic<size_t> m_head{0};
+    alignas(CACHE_LINE) std::atomic<size_t> m_tail{0};
+    alignas(CACHE_LINE) std::atomic<size_t> m_highWater{0};
+    std::atomic<uint64_t> m_dropped{0};
+
+    alignas(CACHE_LINE) T m_items[Capacity];
+};
+
+#endif // SPSCRING_H
@@ -44,6 +44,12 @@ void PPBController::connectCommunicationSignals()
     connect(m_communication, &PPBCommunication::busyChange,
             this, &PPBController::onBusyChanged, Qt::QueuedConnection);
 
+    connect(m_communication, &PPBCommunication::overloaded,
+            this, &PPBController::onOverloaded, Qt::QueuedConnection);
+
+    connect(m_communication, &PPBCommunication::streamProgress,
+            this, &PPBController::onStreamProgress, Qt::QueuedConnection);
+
     connect(m_communication, &PPBCommunication::sentPacketsSaved,
             this, &PPBController::onSentPacketsSaved, Qt::QueuedConnection);
 
@@ -74,8 +80,9 @@ PPBController::PPBController(PPBCommunication* communication, QObject *parent)
     : QObject(parent)
     , m_communication(communication)
     , m_communicationThread(nullptr)
-    , m_autoPollTimer(nullptr)
     , m_autoPollEnabled(false)
+    , m_autoPollIntervalMs(5000)
+    , m_autoPollAddress(0)
     , m_currentAddress(0)
     , busy(false)
     , m_packetAnalyzer(nullptr)
@@ -97,11 +104,6 @@ PPBController::PPBController(PPBCommunication* communication, QObject *parent)
                 this, &PPBController::onAnalyzerDetailedResultsReady);
     }
 
-    // Инициализируем таймер автоопроса
-    m_autoPollTimer = new QTimer(this);
-    m_autoPollTimer->setInterval(5000);
-    connect(m_autoPollTimer, &QTimer::timeout, this, &PPBController::onAutoPollTimeout);
-
     // Инициализируем карты состояний
     m_channel1States.clear();
     m_channel2States.clear();
@@ -125,10 +127,6 @@ PPBController::PPBController(PPBCommunication* communication, QObject *parent)
 
 PPBController::~PPBController()
 {
-    if (m_autoPollTimer) {
-        m_autoPollTimer->stop();
-        delete m_autoPollTimer;
-    }
 }
 
 void PPBController::onBusyChanged(bool busy)
@@ -210,7 +208,9 @@ void PPBController::runFullTest(uint16_t address)
 void PPBController::startAutoPoll(int intervalMs)
 {
     m_autoPollEnabled = true;
-    m_autoPollTimer->start(intervalMs);
+    m_autoPollIntervalMs = intervalMs;
+    m_autoPollBackoff = 1;
+    updateAutoPoll();
     emit autoPollToggled(true);
     LOG_CONTROLLER_INFO(QString("Автоопрос включен (интервал %1 мс)").arg(intervalMs));
 }
@@ -218,7 +218,7 @@ void PPBController::startAutoPoll(int intervalMs)
 void PPBController::stopAutoPoll()
 {
     m_autoPollEnabled = false;
-    m_autoPollTimer->stop();
+    updateAutoPoll();
     emit autoPollToggled(false);
     LOG_CONTROLLER_INFO("Автоопрос выключен");
 }
@@ -289,6 +289,16 @@ void PPBController::onCommandCompleted(bool success, const QString& message, Tec
         LOG_CONTROLLER_INFO(logMsg);
         if (command == TechCommand::TS) {
             emit connectionStateChanged(PPBState::Ready);
+
+            // Опросы снова проходят, перегрузок давно не было - возвращаем период
+            if (m_autoPollBackoff > 1 && m_lastOverload.isValid() &&
+                m_lastOverload.elapsed() > 4LL * m_autoPollIntervalMs * m_autoPollBackoff) {
+                m_autoPollBackoff /= 2;
+                m_lastOverload.restart();
+                updateAutoPoll();
+                LOG_CONTROLLER_INFO(QString("Период автоопроса снижен до %1 мс")
+                                        .arg(m_autoPollIntervalMs * m_autoPollBackoff));
+            }
         }
     } else {
         LOG_CONTROLLER_WARNING(logMsg);
@@ -305,12 +315,48 @@ void PPBController::onErrorOccurred(const QString& error)
     LOG_CONTROLLER_ERROR("[ОШИБКА] " + error);
 }
 
-void PPBController::onAutoPollTimeout()
+void PPBController::onOverloaded(const OverloadEvent& event)
+{
+    m_lastOverload.start();
+    emit overloaded(event);
+
+    if (!m_autoPollEnabled || event.address != m_autoPollAddress ||
+        m_autoPollBackoff >= MAX_AUTOPOLL_BACKOFF) {
+        return;
+    }
+
+    m_autoPollBackoff *= 2;
+    updateAutoPoll();
+    LOG_CONTROLLER_WARNING(QString("Перегрузка очереди 0x%1: период автоопроса увеличен до %2 мс")
+                               .arg(event.address, 4, 16, QChar('0'))
+                               .arg(m_autoPollIntervalMs * m_autoPollBackoff));
+}
+
+void PPBController::onStreamProgress(uint16_t address, TechCommand command, const StreamStats& stats)
+{
+    // Ход приема уже показан через operationProgress; здесь - пропуски и BER до конца пачки
+    QString text = QString("%1 0x%2: %3/%4, пропущено %5")
+                       .arg(commandToName(command))
+                       .arg(address, 4, 16, QChar('0'))
+                       .arg(stats.received).arg(stats.expected)
+                       .arg(stats.missing);
+    if (stats.bitsCompared > 0) {
+        text += QString(", BER %1").arg(stats.ber(), 0, 'g', 4);
+    }
+    LOG_UI_STATUS(text);
+}
+
+void PPBController::updateAutoPoll()
 {
-    if (m_autoPollEnabled && m_communication &&
-        m_communication->state() == PPBState::Ready && m_currentAddress != 0) {
-        requestStatus(m_currentAddress);
+    // Опрос ведет движок: TS ставится в очередь классом Poll, не больше одного на адрес
+    const uint16_t address = (m_autoPollEnabled && m_communication) ? m_currentAddress : 0;
+    if (m_communication && m_autoPollAddress != 0 && m_autoPollAddress != address) {
+        m_communication->setAutoPoll(m_autoPollAddress, 0);
+    }
+    if (address != 0) {
+        m_communication->setAutoPoll(address, m_autoPollIntervalMs * m_autoPollBackoff);
     }
+    m_autoPollAddress = address;
 }
 
 // ==================== АНАЛИЗ ПАКЕТОВ ====================
@@ -645,9 +691,8 @@ void PPBController::setCommunication(PPBCommunication* communication)
 
     // Очищаем старое соединение
     if (m_communication) {
-        if (m_autoPollTimer && m_autoPollTimer->isActive()) {
-            m_autoPollTimer->stop();
-        }
+        // Автоопрос старого объекта уйдет вместе с его движком
+        m_autoPollAddress = 0;
 
         QObject::disconnect(m_communication, nullptr, this, nullptr);
         QObject::disconnect(this, nullptr, m_communication, nullptr);
@@ -679,9 +724,7 @@ void PPBController::setCommunication(PPBCommunication* communication)
 
         emit connectionStateChanged(newState);
 
-        if (m_autoPollEnabled && m_autoPollTimer) {
-            m_autoPollTimer->start();
-        }
+        updateAutoPoll();
 
         LOG_CONTROLLER_INFO("PPBController: коммуникационный объект успешно заменен");
     } else {
@@ -696,5 +739,6 @@ void PPBController::setCurrentAddress(uint16_t address)
                                  .arg(m_currentAddress, 4, 16, QChar('0'))
                                  .arg(address, 4, 16, QChar('0')));
         m_currentAddress = address;
+        updateAutoPoll();
     }
 }
@@ -5,6 +5,7 @@
 #include <QTimer>
 #include <QMap>
 #include <QVariant>
+#include <QElapsedTimer>
 #include "../analyzer/packetanalyzer_interface.h"
 #include "../analyzer/analyzer_factory.h"
 #include "../core/communication/ppbcommunication.h"
@@ -74,6 +75,7 @@ signals:
     void errorOccurred(const QString& error);
     void channelStateUpdated(uint8_t ppbIndex, int channel, const UIChannelState& state);
     void autoPollToggled(bool enabled);
+    void overloaded(const OverloadEvent& event);   // движок не успевает - запросы стоит придержать
     void connectToPPBSignal(uint16_t address, const QString& ip, quint16 port);
     void disconnectSignal();
     void sendFUReceiveSignal(uint16_t address, uint8_t period, const uint8_t fuData[3]);
@@ -94,8 +96,9 @@ private slots:
     void onCommandProgress(int current, int total, TechCommand command);
     void onCommandCompleted(bool success, const QString& message, TechCommand command);
     void onErrorOccurred(const QString& error);
-    void onAutoPollTimeout();
     void onBusyChanged(bool busy);
+    void onOverloaded(const OverloadEvent& event);
+    void onStreamProgress(uint16_t address, TechCommand command, const StreamStats& stats);
 
     // Слоты анализа
     void onSentPacketsSaved(const QVector<DataPacket>& packets);
@@ -111,6 +114,7 @@ private slots:
 private:
     void initializeCommunication();
     void initializeTimers();
+    void updateAutoPoll();   // передать движку текущий адрес и период автоопроса
     void processStatusData(uint16_t address, const QVector<QByteArray>& data);
     UIChannelState parseChannelData(const QVector<QByteArray>& channelData);
     QString commandToName(TechCommand command) const;
@@ -121,8 +125,16 @@ private:
     void showPacketsTable(const QString& title, const QVector<DataPacket>& packets);
 
 
-    QTimer* m_autoPollTimer;
+    // Автоопрос ведет таймер движка; здесь - какой адрес ему отдан
     bool m_autoPollEnabled;
+    int m_autoPollIntervalMs;
+    uint16_t m_autoPollAddress;
+
+    // При перегрузке движка период автоопроса удваивается (до MAX_AUTOPOLL_BACKOFF раз)
+    // и возвращается по мере успешных опросов без новых перегрузок
+    static constexpr int MAX_AUTOPOLL_BACKOFF = 8;
+    int m_autoPollBackoff = 1;
+    QElapsedTimer m_lastOverload;
 
     // Хранение состояний каналов
     QMap<uint8_t, UIChannelState> m_channel1States;
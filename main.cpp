@@ -6,7 +6,9 @@
 #include "core/applicationmanager.h"
 #include "core/logwrapper.h"
 #include <QMessageBox>
+#ifdef Q_OS_WIN
 #include <windows.h>
+#endif
 #include <QFile>
 #include <iostream>
 
@@ -0,0 +1,112 @@
+#include "allocationcounter.h"
+#include <cerrno>
+#include <cstddef>
+
+namespace {
+thread_local bool t_active = false;
+thread_local quint64 t_count = 0;
+
+inline void countAllocation()
+{
+    if (t_active) {
+        ++t_count;
+    }
+}
+} // namespace
+
+#if defined(__GLIBC__)
+
+// Настоящие функции glibc; определения ниже подменяют malloc и выровненные выделения
+// для всего процесса (valloc/pvalloc устарели и не считаются)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+// Выровненные выделения: через них идет operator new для типов с alignas больше 16
+void* memalign(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    countAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    countAllocation();
+    void* result = __libc_memalign(alignment, size);
+    if (!result) {
+        return ENOMEM;
+    }
+    *pointer = result;
+    return 0;
+}
+}
+
+bool AllocationCounter::isAvailable()
+{
+    return true;
+}
+
+#else
+
+bool AllocationCounter::isAvailable()
+{
+    return false;
+}
+
+#endif
+
+void AllocationCounter::start()
+{
+    t_count = 0;
+    t_active = true;
+}
+
+void AllocationCounter::stop()
+{
+    t_active = false;
+}
+
+quint64 AllocationCounter::count()
+{
+    return t_count;
+}
+
+AllocationCounter::Pause::Pause()
+    : m_wasActive(t_active)
+{
+    t_active = false;
+}
+
+AllocationCounter::Pause::~Pause()
+{
+    t_active = m_wasActive;
+}
@@ -0,0 +1,35 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+// ===== СЧЕТЧИК ВЫДЕЛЕНИЙ ПАМЯТИ ДЛЯ ПРОГОНОВ И БЕНЧМАРКОВ =====
+// malloc/calloc/realloc и выровненные memalign/aligned_alloc/posix_memalign перехватываются
+// (glibc), поэтому считаются и operator new (в том числе выровненный), и буферы
+// QString/QByteArray из библиотек Qt. Считается только поток,
+// вызвавший start, и только между start и stop. Pause исключает из замера обвязку
+// (имитатор бриджа, события виртуальных часов), вызванную изнутри измеряемого кода.
+// Вне glibc перехвата нет: isAvailable() == false, счет всегда 0
+class AllocationCounter
+{
+public:
+    static bool isAvailable();
+
+    static void start();          // обнулить и начать счет в текущем потоке
+    static void stop();
+    static quint64 count();       // выделений с последнего start
+
+    class Pause
+    {
+    public:
+        Pause();
+        ~Pause();
+        Pause(const Pause&) = delete;
+        Pause& operator=(const Pause&) = delete;
+
+    private:
+        bool m_wasActive;
+    };
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,93 @@
+#include "scriptedbridge.h"
+#include "../../core/communication/engineclock.h"
+#include "../../core/communication/udpclient.h"
+#include "../../core/communication/commandandoperation.h"
+#include "../../core/communication/packetbuilder.h"
+#include <cstring>
+
+ScriptedBridge::ScriptedBridge(VirtualClock& clock, UDPClient& client, const Options& options)
+    : m_clock(clock)
+    , m_client(client)
+    , m_options(options)
+    , m_rng(options.seed)
+{
+    m_options.ppbCount = qBound(1, m_options.ppbCount, 16);
+}
+
+void ScriptedBridge::onOutbound(const char* data, int size, const QHostAddress& address, quint16 port)
+{
+    // Пакеты данных в ППБ (PRBS_M2S, VOLUME) принимаются молча
+    if (size != static_cast<int>(sizeof(BaseRequest))) {
+        return;
+    }
+
+    BaseRequest request;
+    memcpy(&request, data, sizeof(request));
+    m_requests++;
+
+    const int64_t nowNs = m_clock.nowNs();
+
+    // ФУ: отвечает бридж, без CRC
+    if (request.sign == static_cast<uint8_t>(Sign::FU)) {
+        reply(nowNs + responseDelayNs(), PacketBuilder::encodeBridgeResponse(request.address, request.command, 1),
+              address, port);
+        return;
+    }
+
+    // ТУ: отвечает каждый адресованный ППБ (адрес - битовая маска)
+    const TechCommand command = static_cast<TechCommand>(request.command);
+    for (int i = 0; i < m_options.ppbCount; ++i) {
+        const uint16_t mask = static_cast<uint16_t>(1u << i);
+        if (request.address & mask) {
+            handleTechCommand(mask, command, nowNs + responseDelayNs(), address, port);
+        }
+    }
+}
+
+void ScriptedBridge::handleTechCommand(uint16_t mask, TechCommand command, int64_t atNs,
+                                       const QHostAddress& host, quint16 port)
+{
+    reply(atNs, PacketBuilder::encodePPBResponse(mask, 0x00), host, port);
+
+    QVector<DataPacket> packets;
+    if (command == TechCommand::TS) {
+        // Тех. состояние с неизменными правдоподобными значениями
+        packets = PacketBuilder::createStatusPackets(mask, PacketBuilder::StatusChannel(),
+                                                     PacketBuilder::StatusChannel());
+    } else if (command == TechCommand::PRBS_S2M) {
+        packets = PPBConstants::testSequence();
+    } else if (const CommandDescriptor* descriptor = CommandFactory::descriptor(command)) {
+        // Прочие ответы с данными: счетчик в обоих байтах, содержимое здесь неважно
+        for (int counter = 0; counter < descriptor->expectedPackets; ++counter) {
+            packets.append(PacketBuilder::createTestDataPacket(uint8_t(counter), uint8_t(counter), uint8_t(counter)));
+        }
+    }
+
+    const int64_t intervalNs = int64_t(m_options.packetIntervalUs) * 1000;
+    for (const DataPacket& packet : packets) {
+        atNs += intervalNs;
+        reply(atNs, PacketBuilder::encodeDataPacket(packet), host, port);
+    }
+}
+
+void ScriptedBridge::reply(int64_t atNs, const QByteArray& data, const QHostAddress& host, quint16 port)
+{
+    if (m_options.lossPercent > 0.0 && m_rng.generateDouble() * 100.0 < m_options.lossPercent) {
+        m_lost++;
+        return;
+    }
+
+    m_clock.callAt(atNs, [this, data, host, port]() {
+        m_sent++;
+        m_client.injectDatagram(data, host, port);
+    });
+}
+
+int64_t ScriptedBridge::responseDelayNs()
+{
+    int64_t delayUs = m_options.latencyUs;
+    if (m_options.jitterUs > 0) {
+        delayUs += m_rng.bounded(-m_options.jitterUs, m_options.jitterUs + 1);
+    }
+    return qMax<int64_t>(0, delayUs) * 1000;
+}
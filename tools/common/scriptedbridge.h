@@ -0,0 +1,54 @@
+#ifndef SCRIPTEDBRIDGE_H
+#define SCRIPTEDBRIDGE_H
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QRandomGenerator>
+#include <QVector>
+#include "../../core/communication/ppbprotocol.h"
+
+class UDPClient;
+class VirtualClock;
+
+// ===== БРИДЖ С ППБ В ВИРТУАЛЬНОМ ВРЕМЕНИ =====
+// Отвечает на запросы движка по ppbprotocol.h так же, как ppb_simulator, но без сокета:
+// запросы приходят из UDPClient в режиме петли, ответы ставятся событиями VirtualClock
+// и подаются обратно через UDPClient::injectDatagram. Один и тот же seed - тот же прогон.
+class ScriptedBridge
+{
+public:
+    struct Options {
+        int ppbCount = 16;              // ППБ на бридже (1..16), адреса - биты 0..N-1
+        int latencyUs = 2000;           // задержка OK
+        int jitterUs = 0;               // разброс задержки (+-)
+        int packetIntervalUs = 100;     // интервал между пакетами данных
+        double lossPercent = 0.0;       // вероятность потери датаграммы ответа
+        quint32 seed = 1;
+    };
+
+    ScriptedBridge(VirtualClock& clock, UDPClient& client, const Options& options);
+
+    // Исходящая датаграмма движка (LoopbackSink)
+    void onOutbound(const char* data, int size, const QHostAddress& address, quint16 port);
+
+    quint64 requests() const { return m_requests; }
+    quint64 sent() const { return m_sent; }
+    quint64 lost() const { return m_lost; }
+
+private:
+    void handleTechCommand(uint16_t mask, TechCommand command, int64_t atNs,
+                           const QHostAddress& host, quint16 port);
+    void reply(int64_t atNs, const QByteArray& data, const QHostAddress& host, quint16 port);
+    int64_t responseDelayNs();
+
+    VirtualClock& m_clock;
+    UDPClient& m_client;
+    Options m_options;
+    QRandomGenerator m_rng;
+
+    quint64 m_requests = 0;
+    quint64 m_sent = 0;
+    quint64 m_lost = 0;
+};
+
+#endif // SCRIPTEDBRIDGE_H
@@ -0,0 +1,446 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QStringList>
+#include <QEventLoop>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QUdpSocket>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "../common/allocationcounter.h"
+#include "../common/scriptedbridge.h"
+#include "../../core/communication/communicationengine.h"
+#include "../../core/communication/engineclock.h"
+#include "../../core/communication/enginemetrics.h"
+#include "../../core/communication/packetbuilder.h"
+#include "../../core/communication/udpclient.h"
+#include "../../core/logwrapper.h"
+#include "../../core/logging/logconfig.h"
+
+// Микробенчмарки горячих путей движка, по сценарию на прогон:
+//   ppb_bench                     # все сценарии
+//   ppb_bench metrics -n 50000000
+//   ppb_bench rx -n 1000000       # прием через петлевой сокет: по датаграмме и пачками
+//   ppb_bench dispatch -n 50000   # команда -> провод: по событиям и модель опроса очереди раз в 100 мс
+// Время - на операцию, чтобы сравнивать сборки между собой; печатается одной строкой на сценарий
+
+namespace {
+
+struct BenchOptions {
+    qint64 iterations = 0;     // 0 - значение сценария по умолчанию
+};
+
+// Не дает компилятору выбросить результат измеряемого цикла
+volatile quint64 g_sink = 0;
+
+// ===== metrics: запись задержки в EngineMetrics =====
+// Одна запись на стадию, ключ - адрес и TechCommand, без строк и поиска
+int benchMetrics(const BenchOptions& options)
+{
+    const qint64 iterations = options.iterations > 0 ? options.iterations : 20000000;
+
+    // Задержки заранее: генератор не должен попасть в замер
+    std::vector<int64_t> latencies(4096);
+    quint32 lcg = 1;
+    for (int64_t& latency : latencies) {
+        lcg = lcg * 1664525u + 1013904223u;
+        latency = int64_t(200000 + (lcg >> 8) % 5000000);   // 0.2..5.2 мс
+    }
+
+    static const TechCommand commands[] = {TechCommand::TS, TechCommand::VERS, TechCommand::CHECKSUM,
+                                           TechCommand::BER_T, TechCommand::PRBS_S2M};
+    constexpr int COMMAND_COUNT = int(sizeof(commands) / sizeof(commands[0]));
+
+    EngineMetrics metrics;
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 i = 0; i < iterations; ++i) {
+        const uint16_t address = uint16_t(1u << (i & 15));
+        const TechCommand command = commands[(i >> 4) % COMMAND_COUNT];
+        const auto stage = static_cast<EngineMetrics::Stage>(i % EngineMetrics::STAGE_COUNT);
+        metrics.record(address, command, stage, latencies[size_t(i) & 4095]);
+    }
+    const qint64 recordNs = timer.nsecsElapsed();
+
+    timer.restart();
+    const EngineMetrics::Snapshot snapshot = metrics.snapshot();
+    const QString report = snapshot.latencyReport();
+    const qint64 reportNs = timer.nsecsElapsed();
+    g_sink = g_sink + quint64(report.size());
+
+    quint64 recorded = 0;
+    for (const EngineMetrics::Snapshot::Row& row : snapshot.rows) {
+        for (const EngineMetrics::Snapshot::Histogram& histogram : row.latency) {
+            recorded += histogram.count;
+        }
+    }
+
+    qInfo().noquote() << QString("metrics: %1 записей, %2 нс/запись; снимок и отчет (%3 строк) %4 мс")
+                             .arg(iterations)
+                             .arg(double(recordNs) / iterations, 0, 'f', 2)
+                             .arg(snapshot.rows.size())
+                             .arg(reportNs / 1e6, 0, 'f', 2);
+    if (recorded != quint64(iterations)) {
+        qCritical().noquote() << QString("metrics: в снимке %1 записей из %2").arg(recorded).arg(iterations);
+        return 1;
+    }
+    return 0;
+}
+
+// Логи движка в замер не входят: как в ppb_soak, оставляем только предупреждения
+void quietEngineLogs()
+{
+    LogWrapper::instance();
+    for (const QString& channel : LogConfig::instance().getChannelIds()) {
+        LogConfig::instance().setMinLevel(channel, LOG_WARNING);
+    }
+}
+
+// ===== rx: прием ответов ППБ через UDPClient =====
+// Настоящий сокет на 127.0.0.1: отправитель шлет пачки ответов OK, UDPClient принимает их
+// старым путем (QNetworkDatagram и dataReceived на каждую датаграмму) или пакетным
+// (слэб RxDatagram и один datagramsReceived на пробуждение). Выделения памяти считаются
+// в потоке приема; отправка в счет не входит
+struct RxResult {
+    quint64 sent = 0;
+    quint64 received = 0;
+    qint64 elapsedNs = 0;
+    quint64 allocations = 0;
+};
+
+// Свободный порт на петле; между закрытием и привязкой UDPClient его могут занять - для бенчмарка допустимо
+quint16 freeLoopbackPort()
+{
+    QUdpSocket probe;
+    return probe.bind(QHostAddress::LocalHost, 0) ? probe.localPort() : 0;
+}
+
+bool runRxPath(bool batched, qint64 datagrams, RxResult& result)
+{
+    const quint16 port = freeLoopbackPort();
+    if (port == 0) {
+        qCritical().noquote() << "rx: нет свободного порта на 127.0.0.1";
+        return false;
+    }
+    qputenv("PPB_BIND_ADDRESS", "127.0.0.1");
+    qputenv("PPB_BIND_PORT", QByteArray::number(port));
+
+    UDPClient client;
+    client.setBatchedReceive(batched);
+    client.setReceiveThreadEnabled(false);   // сравниваем только способ чтения сокета
+    client.initializeInThread();
+    if (!client.isBound()) {
+        qCritical().noquote() << QString("rx: UDPClient не привязался к 127.0.0.1:%1").arg(port);
+        return false;
+    }
+
+    QUdpSocket sender;
+    if (!sender.bind(QHostAddress::LocalHost, 0)) {
+        qCritical().noquote() << "rx: не удалось открыть сокет отправителя";
+        return false;
+    }
+
+    // Разбор ответа, как в движке: адрес (байты уже переставлены) и статус
+    quint64 received = 0;
+    quint64 checksum = 0;
+    QObject::connect(&client, &UDPClient::dataReceived, &client,
+                     [&](const QByteArray& data, const QHostAddress&, quint16) {
+                         if (data.size() >= 3) {
+                             checksum += uint8_t(data[0]) | (uint8_t(data[1]) << 8) | (uint8_t(data[2]) << 16);
+                         }
+                         received++;
+                     }, Qt::DirectConnection);
+    QObject::connect(&client, &UDPClient::datagramsReceived, &client,
+                     [&](const RxBatch& batch) {
+                         for (const RxDatagram& record : batch) {
+                             if (record.size >= 3) {
+                                 checksum += record.data[0] | (record.data[1] << 8) | (record.data[2] << 16);
+                             }
+                         }
+                         received += quint64(batch.count);
+                     }, Qt::DirectConnection);
+
+    // Будит ожидание, если часть пачки потерялась на переполненном буфере сокета
+    QTimer watchdog;
+    watchdog.start(50);
+
+    const QByteArray response = PacketBuilder::encodePPBResponse(0x0001, 0x00);
+    constexpr int BURST = 32;   // датаграмм подряд, дальше ждем их приема
+
+    QElapsedTimer timer;
+    QElapsedTimer wait;
+    timer.start();
+    AllocationCounter::start();
+    qint64 sent = 0;
+    while (sent < datagrams) {
+        const int burst = int(qMin<qint64>(BURST, datagrams - sent));
+        {
+            AllocationCounter::Pause pause;
+            for (int i = 0; i < burst; ++i) {
+                sender.writeDatagram(response, QHostAddress::LocalHost, port);
+            }
+        }
+        sent += burst;
+
+        wait.start();
+        while (received < quint64(sent) && wait.elapsed() < 200) {
+            QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        }
+    }
+    AllocationCounter::stop();
+
+    result.sent = quint64(sent);
+    result.received = received;
+    result.elapsedNs = timer.nsecsElapsed();
+    result.allocations = AllocationCounter::count();
+    g_sink = g_sink + checksum;
+    return true;
+}
+
+int benchRx(const BenchOptions& options)
+{
+    const qint64 datagrams = options.iterations > 0 ? options.iterations : 200000;
+
+    quietEngineLogs();
+
+    struct RxPath {
+        const char* name;
+        bool batched;
+    };
+    static const RxPath paths[] = {{"по датаграмме", false}, {"пачками", true}};
+
+    int result = 0;
+    for (const RxPath& path : paths) {
+        RxResult rx;
+        if (!runRxPath(path.batched, datagrams, rx)) {
+            result = 1;
+            continue;
+        }
+
+        const double packetsPerSec = rx.elapsedNs > 0 ? double(rx.received) * 1e9 / rx.elapsedNs : 0.0;
+        const QString allocations = AllocationCounter::isAvailable()
+            ? QString::number(rx.received ? double(rx.allocations) / rx.received : 0.0, 'f', 2)
+            : QString("н/д");
+        qInfo().noquote() << QString("rx %1: %2 датаграмм (потеряно %3), %4 пакетов/с, %5 выделений/пакет")
+                                 .arg(path.name)
+                                 .arg(rx.received)
+                                 .arg(rx.sent - qMin(rx.sent, rx.received))
+                                 .arg(packetsPerSec, 0, 'f', 0)
+                                 .arg(allocations);
+        if (rx.received == 0) {
+            qCritical().noquote() << QString("rx %1: ни одной датаграммы не принято").arg(path.name);
+            result = 1;
+        }
+    }
+    return result;
+}
+
+// ===== dispatch: задержка команда -> провод =====
+// Движок в виртуальном времени со ScriptedBridge, один ППБ, команды TS приходят в случайные
+// моменты (в среднем раз в 5 мс, ППБ занят заметную долю времени). Задержка - от вызова
+// executeCommand до выхода запроса в петлю; ждущие в очереди TS сливаются, поэтому запрос
+// на проводе закрывает все команды, отданные движку до него.
+// Модель опроса воспроизводит прежнюю схему перед тем же движком: задачи PPBCommunication
+// передаются движку по своему таймеру 100 мс, а очередь движка отдает команду по своему
+// таймеру 100 мс и только если ППБ свободен. Фазы таймеров независимы - сдвинуты на полпериода
+struct DispatchResult {
+    std::vector<int64_t> latenciesNs;
+    quint64 requests = 0;   // запросов TS на проводе
+};
+
+constexpr uint16_t DISPATCH_ADDRESS = 0x0001;
+constexpr int64_t DISPATCH_MEAN_INTERVAL_NS = 5000000;
+constexpr int64_t LEGACY_POLL_PERIOD_NS = 100000000;
+
+bool runDispatchModel(bool legacyPolling, qint64 commands, DispatchResult& result)
+{
+    VirtualClock clock;
+    UDPClient client;
+    ScriptedBridge::Options bridgeOptions;
+    bridgeOptions.ppbCount = 1;
+    ScriptedBridge bridge(clock, client, bridgeOptions);
+
+    std::vector<int64_t> inEngineNs;   // отданы движку, запрос еще не ушел
+    client.setBatchedReceive(true);
+    client.setLoopback([&](const char* data, int size, const QHostAddress& address, quint16 port) {
+        BaseRequest request;
+        if (size == static_cast<int>(sizeof(request))) {
+            memcpy(&request, data, sizeof(request));
+            if (request.sign == static_cast<uint8_t>(Sign::TU) &&
+                request.command == static_cast<uint8_t>(TechCommand::TS)) {
+                for (int64_t atNs : inEngineNs) {
+                    result.latenciesNs.push_back(clock.nowNs() - atNs);
+                }
+                inEngineNs.clear();
+                result.requests++;
+            }
+        }
+        bridge.onOutbound(data, size, address, port);
+    });
+
+    communicationengine engine(&client);
+    if (!engine.setClock(&clock)) {
+        qCritical().noquote() << "dispatch: не удалось перевести движок на виртуальное время";
+        return false;
+    }
+
+    PPBState state = PPBState::Ready;
+    QObject::connect(&engine, &communicationengine::stateChanged, &engine,
+                     [&state](uint16_t address, PPBState newState) {
+                         if (address == DISPATCH_ADDRESS) {
+                             state = newState;
+                         }
+                     }, Qt::DirectConnection);
+    engine.connectToPPB(DISPATCH_ADDRESS, "127.0.0.1", 1080);
+
+    std::vector<int64_t> taskQueueNs;     // модель опроса: задачи PPBCommunication
+    std::vector<int64_t> engineQueueNs;   // модель опроса: очередь движка до тика
+    auto passToEngine = [&](int64_t submittedNs) {
+        inEngineNs.push_back(submittedNs);
+        engine.executeCommand(TechCommand::TS, DISPATCH_ADDRESS);
+    };
+
+    std::function<void()> taskTick = [&]() {
+        engineQueueNs.insert(engineQueueNs.end(), taskQueueNs.begin(), taskQueueNs.end());
+        taskQueueNs.clear();
+        clock.callAfter(LEGACY_POLL_PERIOD_NS, taskTick);
+    };
+    std::function<void()> queueTick = [&]() {
+        if (state == PPBState::Ready || state == PPBState::Idle) {
+            for (int64_t submittedNs : engineQueueNs) {
+                passToEngine(submittedNs);
+            }
+            engineQueueNs.clear();
+        }
+        clock.callAfter(LEGACY_POLL_PERIOD_NS, queueTick);
+    };
+    if (legacyPolling) {
+        clock.callAt(LEGACY_POLL_PERIOD_NS / 2, taskTick);
+        clock.callAt(LEGACY_POLL_PERIOD_NS, queueTick);
+    }
+
+    QRandomGenerator rng(1);
+    qint64 submitted = 0;
+    std::function<void()> submit = [&]() {
+        if (legacyPolling) {
+            taskQueueNs.push_back(clock.nowNs());
+        } else {
+            passToEngine(clock.nowNs());
+        }
+        if (++submitted < commands) {
+            clock.callAfter(int64_t(rng.bounded(int(2 * DISPATCH_MEAN_INTERVAL_NS / 1000))) * 1000, submit);
+        }
+    };
+    clock.callAt(0, submit);
+
+    // Тики модели опроса не кончаются - идем шагами до последней команды на проводе
+    const int64_t deadlineNs = commands * DISPATCH_MEAN_INTERVAL_NS * 4 + int64_t(10) * 1000000000;
+    result.latenciesNs.reserve(size_t(commands));
+    while (qint64(result.latenciesNs.size()) < commands && clock.nowNs() < deadlineNs) {
+        clock.runFor(LEGACY_POLL_PERIOD_NS);
+    }
+    return true;
+}
+
+int benchDispatch(const BenchOptions& options)
+{
+    const qint64 commands = options.iterations > 0 ? options.iterations : 20000;
+    quietEngineLogs();
+
+    struct DispatchModel {
+        const char* name;
+        bool legacyPolling;
+    };
+    static const DispatchModel models[] = {{"опрос очереди 100 мс", true}, {"по событиям", false}};
+
+    int result = 0;
+    for (const DispatchModel& model : models) {
+        DispatchResult dispatch;
+        if (!runDispatchModel(model.legacyPolling, commands, dispatch)) {
+            result = 1;
+            continue;
+        }
+
+        std::vector<int64_t>& latencies = dispatch.latenciesNs;
+        if (qint64(latencies.size()) < commands) {
+            qCritical().noquote() << QString("dispatch %1: на провод вышло %2 команд из %3")
+                                         .arg(model.name).arg(latencies.size()).arg(commands);
+            result = 1;
+            if (latencies.empty()) {
+                continue;
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        auto percentileMs = [&latencies](double p) {
+            const size_t index = qMin(latencies.size() - 1, size_t(p * double(latencies.size())));
+            return latencies[index] / 1e6;
+        };
+        qInfo().noquote() << QString("dispatch %1: %2 команд, %3 запросов, команда->провод p50=%4 p99=%5 max=%6 мс")
+                                 .arg(model.name)
+                                 .arg(latencies.size())
+                                 .arg(dispatch.requests)
+                                 .arg(percentileMs(0.50), 0, 'f', 3)
+                                 .arg(percentileMs(0.99), 0, 'f', 3)
+                                 .arg(latencies.back() / 1e6, 0, 'f', 3);
+    }
+    return result;
+}
+
+struct BenchCase {
+    const char* name;
+    const char* description;
+    int (*run)(const BenchOptions&);
+};
+
+const BenchCase BENCH_CASES[] = {
+    {"metrics", "запись задержки в EngineMetrics", &benchMetrics},
+    {"rx", "прием через петлевой сокет: по датаграмме и пачками", &benchRx},
+    {"dispatch", "задержка команда->провод: по событиям и опрос очереди 100 мс", &benchDispatch},
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ppb_bench");
+
+    QStringList caseNames;
+    for (const BenchCase& bench : BENCH_CASES) {
+        caseNames << QString("%1 - %2").arg(bench.name, bench.description);
+    }
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Микробенчмарки движка обмена с ППБ. Сценарии:\n  " + caseNames.join("\n  "));
+    parser.addHelpOption();
+    parser.addPositionalArgument("cases", "Сценарии (по умолчанию - все)", "[case...]");
+
+    QCommandLineOption iterationsOption(QStringList() << "n" << "iterations",
+                                        "Число операций (0 - по умолчанию сценария)", "count", "0");
+    parser.addOption(iterationsOption);
+    parser.process(app);
+
+    BenchOptions options;
+    options.iterations = parser.value(iterationsOption).toLongLong();
+
+    const QStringList requested = parser.positionalArguments();
+    int result = 0;
+    int ran = 0;
+    for (const BenchCase& bench : BENCH_CASES) {
+        if (!requested.isEmpty() && !requested.contains(bench.name)) {
+            continue;
+        }
+        result |= bench.run(options);
+        ++ran;
+    }
+
+    if (ran == 0) {
+        qCritical().noquote() << "Нет таких сценариев: " + requested.join(", ");
+        return 1;
+    }
+    return result;
+}
@@ -0,0 +1,64 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include "ppbsimulator.h"
+
+// Симулятор бриджа с ППБ для нагрузочной проверки тестера без оборудования.
+// Запуск тестера против симулятора:
+//   ppb_simulator --bind 127.0.0.1 --port 1080 --loss 1 --jitter 2
+//   PPB_BIND_ADDRESS=127.0.0.1 PPB_BIND_PORT=1101 PPB_Tester_Software   (в GUI адрес 127.0.0.1, порт 1080)
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ppb_simulator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Симулятор бриджа и ППБ (UDP)");
+    parser.addHelpOption();
+
+    QCommandLineOption bindOption("bind", "Адрес привязки", "address", "127.0.0.1");
+    QCommandLineOption portOption("port", "UDP порт бриджа", "port", "1080");
+    QCommandLineOption ppbsOption("ppbs", "Количество ППБ (1..16)", "count", "16");
+    QCommandLineOption latencyOption("latency", "Задержка ответа, мс", "ms", "2");
+    QCommandLineOption jitterOption("jitter", "Разброс задержки, +-мс", "ms", "0");
+    QCommandLineOption intervalOption("interval", "Интервал между пакетами данных, мкс", "us", "100");
+    QCommandLineOption lossOption("loss", "Потеря датаграмм, %", "percent", "0");
+    QCommandLineOption reorderOption("reorder", "Перестановка датаграмм, %", "percent", "0");
+    QCommandLineOption bitFlipOption("bitflip", "Инверсия бита в датаграмме, %", "percent", "0");
+    QCommandLineOption seedOption("seed", "Начальное значение генератора", "seed", "1");
+    QCommandLineOption statsOption("stats", "Период печати статистики, с (0 - выкл)", "sec", "10");
+    QCommandLineOption portPerPpbOption("port-per-ppb", "ППБ i на порту port+i (параллельные диалоги)");
+    QCommandLineOption verboseOption({"v", "verbose"}, "Печатать каждый запрос");
+
+    parser.addOptions({bindOption, portOption, ppbsOption, latencyOption, jitterOption,
+                       intervalOption, lossOption, reorderOption, bitFlipOption, seedOption,
+                       statsOption, portPerPpbOption, verboseOption});
+    parser.process(app);
+
+    SimulatorOptions options;
+    options.bindAddress = QHostAddress(parser.value(bindOption));
+    options.port = static_cast<quint16>(parser.value(portOption).toUInt());
+    options.ppbCount = parser.value(ppbsOption).toInt();
+    options.latencyMs = qMax(0, parser.value(latencyOption).toInt());
+    options.jitterMs = qMax(0, parser.value(jitterOption).toInt());
+    options.packetIntervalUs = qMax(0, parser.value(intervalOption).toInt());
+    options.lossPercent = parser.value(lossOption).toDouble();
+    options.reorderPercent = parser.value(reorderOption).toDouble();
+    options.bitFlipPercent = parser.value(bitFlipOption).toDouble();
+    options.seed = parser.value(seedOption).toUInt();
+    options.statsIntervalSec = qMax(0, parser.value(statsOption).toInt());
+    options.portPerPpb = parser.isSet(portPerPpbOption);
+    options.verbose = parser.isSet(verboseOption);
+
+    if (options.bindAddress.isNull()) {
+        qCritical().noquote() << "Некорректный адрес привязки:" << parser.value(bindOption);
+        return 1;
+    }
+
+    PpbSimulator simulator(options);
+    if (!simulator.start()) {
+        return 1;
+    }
+
+    return app.exec();
+}
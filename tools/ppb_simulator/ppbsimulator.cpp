@@ -0,0 +1,349 @@
+#include "ppbsimulator.h"
+#include "../../core/communication/packetbuilder.h"
+#include <QDebug>
+#include <QtAlgorithms>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+constexpr int TEST_PACKET_COUNT = 256;     // PRBS_S2M
+constexpr int REORDER_MAX_US = 5000;       // насколько может опоздать переставленная датаграмма
+
+} // namespace
+
+PpbSimulator::PpbSimulator(const SimulatorOptions& options, QObject* parent)
+    : QObject(parent)
+    , m_options(options)
+    , m_rng(options.seed)
+{
+    m_options.ppbCount = qBound(1, m_options.ppbCount, 16);
+
+    for (int i = 0; i < m_options.ppbCount; ++i) {
+        Ppb ppb;
+        ppb.mask = static_cast<uint16_t>(1u << i);
+        ppb.version = 0x00010000u + i;                 // 1.0.i
+        ppb.checksum = 0xC0DE0000u | ppb.mask;
+        ppb.berT = static_cast<uint32_t>(i);
+        ppb.berF = static_cast<uint32_t>(i * 2);
+        m_ppbs.push_back(ppb);
+    }
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_flushTimer, &QTimer::timeout, this, &PpbSimulator::flushDue);
+    connect(&m_statsTimer, &QTimer::timeout, this, &PpbSimulator::printStats);
+
+    const int socketCount = m_options.portPerPpb ? m_options.ppbCount : 1;
+    for (int i = 0; i < socketCount; ++i) {
+        m_sockets.push_back(std::make_unique<QUdpSocket>());
+        connect(m_sockets.back().get(), &QUdpSocket::readyRead, this, &PpbSimulator::onReadyRead);
+    }
+}
+
+bool PpbSimulator::start()
+{
+    for (size_t i = 0; i < m_sockets.size(); ++i) {
+        QUdpSocket* socket = m_sockets[i].get();
+        const quint16 port = static_cast<quint16>(m_options.port + i);
+        if (!socket->bind(m_options.bindAddress, port)) {
+            qCritical().noquote() << QString("Не удалось привязаться к %1:%2: %3")
+                                         .arg(m_options.bindAddress.toString())
+                                         .arg(port)
+                                         .arg(socket->errorString());
+            return false;
+        }
+        socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, 1 << 20);
+    }
+    m_clock.start();
+
+    if (m_options.statsIntervalSec > 0) {
+        m_statsTimer.start(m_options.statsIntervalSec * 1000);
+    }
+
+    qInfo().noquote() << QString("Симулятор бриджа на %1:%2, ППБ: %3, задержка %4+-%5 мс, "
+                                 "потери %6%, перестановка %7%, инверсия бит %8%")
+                             .arg(m_options.bindAddress.toString())
+                             .arg(m_options.portPerPpb
+                                      ? QString("%1-%2").arg(m_options.port).arg(m_options.port + m_options.ppbCount - 1)
+                                      : QString::number(m_options.port))
+                             .arg(m_options.ppbCount)
+                             .arg(m_options.latencyMs)
+                             .arg(m_options.jitterMs)
+                             .arg(m_options.lossPercent)
+                             .arg(m_options.reorderPercent)
+                             .arg(m_options.bitFlipPercent);
+    return true;
+}
+
+// ===== ПРИЕМ =====
+
+void PpbSimulator::onReadyRead()
+{
+    QUdpSocket* socket = qobject_cast<QUdpSocket*>(sender());
+    if (!socket) {
+        return;
+    }
+    m_replySocket = socket;
+
+    while (socket->hasPendingDatagrams()) {
+        QByteArray datagram(static_cast<int>(socket->pendingDatagramSize()), '\0');
+        QHostAddress host;
+        quint16 port = 0;
+        if (socket->readDatagram(datagram.data(), datagram.size(), &host, &port) < 0) {
+            continue;
+        }
+
+        if (datagram.size() == static_cast<int>(sizeof(BaseRequest))) {
+            BaseRequest request;
+            memcpy(&request, datagram.constData(), sizeof(request));
+            handleRequest(request, host, port);
+        } else if (datagram.size() == static_cast<int>(sizeof(DataPacket))) {
+            handleDataPacket(datagram);
+        } else if (m_options.verbose) {
+            qWarning().noquote() << QString("Датаграмма неизвестного размера: %1 байт").arg(datagram.size());
+        }
+    }
+}
+
+void PpbSimulator::handleRequest(const BaseRequest& request, const QHostAddress& host, quint16 port)
+{
+    m_requests++;
+
+    if (m_options.verbose) {
+        qInfo().noquote() << QString("Запрос: адрес=0x%1 команда=0x%2 признак=%3 от %4:%5")
+                                 .arg(request.address, 4, 16, QChar('0'))
+                                 .arg(request.command, 2, 16, QChar('0'))
+                                 .arg(request.sign)
+                                 .arg(host.toString())
+                                 .arg(port);
+    }
+
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+
+    // ФУ: отвечает бридж, без CRC
+    if (request.sign == static_cast<uint8_t>(Sign::FU)) {
+        enqueue(nowUs + responseDelayUs(),
+                PacketBuilder::encodeBridgeResponse(request.address, request.command, 1), host, port);
+        scheduleFlush();
+        return;
+    }
+
+    // ТУ: отвечает каждый адресованный ППБ (адрес - битовая маска, 0xFFFF - все)
+    const TechCommand command = static_cast<TechCommand>(request.command);
+    for (Ppb& ppb : m_ppbs) {
+        if ((request.address & ppb.mask) && servesPpb(ppb)) {
+            handleTechCommand(ppb, command, nowUs + responseDelayUs(), host, port);
+        }
+    }
+    scheduleFlush();
+}
+
+void PpbSimulator::handleTechCommand(Ppb& ppb, TechCommand command, qint64 dueUs,
+                                     const QHostAddress& host, quint16 port)
+{
+    ppb.receiving = false;
+    enqueue(dueUs, PacketBuilder::encodePPBResponse(ppb.mask, 0x00), host, port);
+    dueUs += m_options.packetIntervalUs;
+
+    switch (command) {
+    case TechCommand::TS:
+        enqueueStream(dueUs, statusPackets(ppb), host, port);
+        break;
+    case TechCommand::VERS:
+        enqueueValue(dueUs, ppb.version, host, port);
+        break;
+    case TechCommand::CHECKSUM:
+        enqueueValue(dueUs, ppb.checksum, host, port);
+        break;
+    case TechCommand::BER_T:
+        enqueueValue(dueUs, ppb.berT, host, port);
+        break;
+    case TechCommand::BER_F:
+        enqueueValue(dueUs, ppb.berF, host, port);
+        break;
+    case TechCommand::DROP:
+        enqueueValue(dueUs, ppb.dropped, host, port);
+        break;
+    case TechCommand::PRBS_M2S:
+    case TechCommand::VOLUME:
+        ppb.receiving = true;
+        ppb.received.clear();
+        break;
+    case TechCommand::PRBS_S2M:
+        // Эхо принятой последовательности, а если ее не было - та же, что генерирует тестер
+        enqueueStream(dueUs, ppb.received.isEmpty() ? defaultTestSequence() : ppb.received, host, port);
+        break;
+    case TechCommand::TC:
+    case TechCommand::PROGRAMM:
+    case TechCommand::CLEAN:
+    default:
+        break;
+    }
+}
+
+void PpbSimulator::handleDataPacket(const QByteArray& datagram)
+{
+    m_dataIn++;
+
+    // Пакеты данных тестер шлет без перестановки байт - сохраняем как есть
+    DataPacket packet;
+    memcpy(&packet, datagram.constData(), sizeof(packet));
+
+    for (Ppb& ppb : m_ppbs) {
+        if (!ppb.receiving || !servesPpb(ppb)) {
+            continue;
+        }
+        uint8_t crcData[3] = {packet.data[0], packet.data[1], packet.counter};
+        if (calculateCRC8(crcData, 3) != packet.crc) {
+            ppb.dropped++;
+            continue;
+        }
+        ppb.received.append(packet);
+        if (ppb.received.size() >= TEST_PACKET_COUNT) {
+            ppb.receiving = false;
+        }
+    }
+}
+
+bool PpbSimulator::servesPpb(const Ppb& ppb) const
+{
+    if (!m_options.portPerPpb) {
+        return true;
+    }
+    const size_t index = static_cast<size_t>(qCountTrailingZeroBits(ppb.mask));
+    return index < m_sockets.size() && m_sockets[index].get() == m_replySocket;
+}
+
+// ===== ОТПРАВКА =====
+
+qint64 PpbSimulator::responseDelayUs()
+{
+    qint64 delayUs = qint64(m_options.latencyMs) * 1000;
+    if (m_options.jitterMs > 0) {
+        delayUs += m_rng.bounded(-m_options.jitterMs * 1000, m_options.jitterMs * 1000 + 1);
+    }
+    return qMax<qint64>(0, delayUs);
+}
+
+bool PpbSimulator::chance(double percent)
+{
+    return percent > 0.0 && m_rng.generateDouble() * 100.0 < percent;
+}
+
+void PpbSimulator::enqueue(qint64 dueUs, QByteArray data, const QHostAddress& host, quint16 port)
+{
+    if (chance(m_options.lossPercent)) {
+        m_lost++;
+        return;
+    }
+
+    if (chance(m_options.bitFlipPercent) && !data.isEmpty()) {
+        const int bit = m_rng.bounded(data.size() * 8);
+        data[bit / 8] = static_cast<char>(data[bit / 8] ^ (1 << (bit % 8)));
+        m_flipped++;
+    }
+
+    if (chance(m_options.reorderPercent)) {
+        dueUs += m_options.packetIntervalUs + m_rng.bounded(REORDER_MAX_US);
+        m_reordered++;
+    }
+
+    m_outgoing.emplace(dueUs, Outgoing{m_replySocket, data, host, port});
+}
+
+qint64 PpbSimulator::enqueueStream(qint64 dueUs, const QVector<DataPacket>& packets,
+                                   const QHostAddress& host, quint16 port)
+{
+    for (const DataPacket& packet : packets) {
+        enqueue(dueUs, PacketBuilder::encodeDataPacket(packet), host, port);
+        dueUs += m_options.packetIntervalUs;
+    }
+    return dueUs;
+}
+
+// 32-битное значение - два пакета по 2 байта данных, младшие байты первыми
+qint64 PpbSimulator::enqueueValue(qint64 dueUs, uint32_t value, const QHostAddress& host, quint16 port)
+{
+    QVector<DataPacket> packets;
+    packets.append(PacketBuilder::createTestDataPacket(value & 0xFF, (value >> 8) & 0xFF, 0));
+    packets.append(PacketBuilder::createTestDataPacket((value >> 16) & 0xFF, (value >> 24) & 0xFF, 1));
+    return enqueueStream(dueUs, packets, host, port);
+}
+
+void PpbSimulator::scheduleFlush()
+{
+    if (m_outgoing.empty()) {
+        return;
+    }
+
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    const qint64 waitUs = m_outgoing.begin()->first - nowUs;
+    const int waitMs = waitUs > 0 ? static_cast<int>(waitUs / 1000) : 0;
+
+    if (!m_flushTimer.isActive() || m_flushTimer.remainingTime() > waitMs) {
+        m_flushTimer.start(waitMs);
+    }
+}
+
+void PpbSimulator::flushDue()
+{
+    const qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+
+    while (!m_outgoing.empty() && m_outgoing.begin()->first <= nowUs) {
+        const Outgoing& out = m_outgoing.begin()->second;
+        if (out.socket->writeDatagram(out.data, out.host, out.port) == out.data.size()) {
+            m_sent++;
+        } else {
+            // Буфер сокета заполнен - повторим на следующем проходе
+            break;
+        }
+        m_outgoing.erase(m_outgoing.begin());
+    }
+
+    if (!m_outgoing.empty()) {
+        const qint64 waitUs = m_outgoing.begin()->first - nowUs;
+        m_flushTimer.start(waitUs > 0 ? static_cast<int>(waitUs / 1000) : 0);
+    }
+}
+
+void PpbSimulator::printStats()
+{
+    qInfo().noquote() << QString("Запросов: %1, пакетов данных принято: %2, отправлено: %3, "
+                                 "потеряно: %4, переставлено: %5, искажено: %6, в очереди: %7")
+                             .arg(m_requests)
+                             .arg(m_dataIn)
+                             .arg(m_sent)
+                             .arg(m_lost)
+                             .arg(m_reordered)
+                             .arg(m_flipped)
+                             .arg(m_outgoing.size());
+}
+
+// ===== КОДИРОВАНИЕ =====
+
+// Та же последовательность, что PRBS_M2SCommand::onOkReceived
+QVector<DataPacket> PpbSimulator::defaultTestSequence()
+{
+    QVector<DataPacket> packets;
+    packets.reserve(TEST_PACKET_COUNT);
+
+    uint8_t lfsr = 0x01;
+    for (int i = 0; i < TEST_PACKET_COUNT; ++i) {
+        packets.append(PacketBuilder::createTestDataPacket(lfsr, lfsr ^ 0x55, static_cast<uint8_t>(i)));
+        lfsr = (lfsr >> 1) | ((lfsr ^ (lfsr >> 1)) << 7);
+    }
+    return packets;
+}
+
+// Тех. состояние: правдоподобные значения каналов с небольшим шумом
+QVector<DataPacket> PpbSimulator::statusPackets(const Ppb& ppb)
+{
+    PacketBuilder::StatusChannel channels[2];
+    for (PacketBuilder::StatusChannel& channel : channels) {
+        channel.powerW = static_cast<uint16_t>(500 + m_rng.bounded(20));
+        channel.temperature = static_cast<uint8_t>(35 + m_rng.bounded(5));
+        channel.vswr10 = static_cast<uint8_t>(12 + m_rng.bounded(3));
+    }
+    return PacketBuilder::createStatusPackets(ppb.mask, channels[0], channels[1], ppb.dropped ? 0x01 : 0x00);
+}
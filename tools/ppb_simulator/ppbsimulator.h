@@ -0,0 +1,109 @@
+#ifndef PPBSIMULATOR_H
+#define PPBSIMULATOR_H
+
+#include <QObject>
+#include <QUdpSocket>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTimer>
+#include <QVector>
+#include <map>
+#include <memory>
+#include <vector>
+#include "../../core/communication/ppbprotocol.h"
+
+// ===== ПАРАМЕТРЫ СИМУЛЯТОРА =====
+struct SimulatorOptions {
+    QHostAddress bindAddress = QHostAddress::LocalHost;
+    quint16 port = 1080;
+    int ppbCount = 16;                 // ППБ на бридже (1..16), адреса - биты 0..N-1
+    int latencyMs = 2;                 // задержка ответа
+    int jitterMs = 0;                  // разброс задержки (+-)
+    int packetIntervalUs = 100;        // интервал между пакетами потока данных
+    double lossPercent = 0.0;          // вероятность потери датаграммы
+    double reorderPercent = 0.0;       // вероятность доставки датаграммы позже следующих
+    double bitFlipPercent = 0.0;       // вероятность инверсии одного бита в датаграмме
+    quint32 seed = 1;
+    int statsIntervalSec = 10;         // 0 - не печатать статистику
+    bool portPerPpb = false;           // ППБ i слушает port + i (свои конечные точки вместо общего бриджа)
+    bool verbose = false;
+};
+
+// ===== ЭМУЛЯТОР БРИДЖА С ППБ =====
+// Говорит на протоколе ppbprotocol.h: на ТУ-запрос каждый адресованный ППБ отвечает OK
+// (PPBResponse с CRC8), затем, в зависимости от команды, шлет пакеты данных или принимает их.
+// Байты 0/1 каждой отправляемой датаграммы переставлены так же, как это делает ППБ.
+class PpbSimulator : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PpbSimulator(const SimulatorOptions& options, QObject* parent = nullptr);
+
+    bool start();
+
+private slots:
+    void onReadyRead();
+    void flushDue();
+    void printStats();
+
+private:
+    struct Ppb {
+        uint16_t mask = 0;
+        bool receiving = false;              // после PRBS_M2S/VOLUME принимает пакеты данных
+        QVector<DataPacket> received;        // последняя принятая последовательность
+        uint32_t version = 0;
+        uint32_t checksum = 0;
+        uint32_t berT = 0;
+        uint32_t berF = 0;
+        uint32_t dropped = 0;
+    };
+
+    struct Outgoing {
+        QUdpSocket* socket;
+        QByteArray data;
+        QHostAddress host;
+        quint16 port;
+    };
+
+    void handleRequest(const BaseRequest& request, const QHostAddress& host, quint16 port);
+    void handleDataPacket(const QByteArray& datagram);
+    bool servesPpb(const Ppb& ppb) const;   // ППБ отвечает на сокете m_replySocket
+    void handleTechCommand(Ppb& ppb, TechCommand command, qint64 dueUs,
+                           const QHostAddress& host, quint16 port);
+
+    // Постановка датаграмм в очередь отправки с задержкой и искажениями
+    qint64 responseDelayUs();
+    void enqueue(qint64 dueUs, QByteArray data, const QHostAddress& host, quint16 port);
+    qint64 enqueueStream(qint64 dueUs, const QVector<DataPacket>& packets,
+                         const QHostAddress& host, quint16 port);
+    qint64 enqueueValue(qint64 dueUs, uint32_t value, const QHostAddress& host, quint16 port);
+    void scheduleFlush();
+
+    static QVector<DataPacket> defaultTestSequence();
+    QVector<DataPacket> statusPackets(const Ppb& ppb);
+
+    bool chance(double percent);
+
+    SimulatorOptions m_options;
+    std::vector<std::unique_ptr<QUdpSocket>> m_sockets;   // один (бридж) или по сокету на ППБ
+    QUdpSocket* m_replySocket = nullptr;                  // сокет, принявший обрабатываемую датаграмму
+    QTimer m_flushTimer;
+    QTimer m_statsTimer;
+    QElapsedTimer m_clock;
+    QRandomGenerator m_rng;
+
+    std::vector<Ppb> m_ppbs;
+    std::multimap<qint64, Outgoing> m_outgoing;   // время отправки (мкс) -> датаграмма
+
+    // Статистика
+    quint64 m_requests = 0;
+    quint64 m_dataIn = 0;
+    quint64 m_sent = 0;
+    quint64 m_lost = 0;
+    quint64 m_reordered = 0;
+    quint64 m_flipped = 0;
+};
+
+#endif // PPBSIMULATOR_H
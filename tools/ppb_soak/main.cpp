@@ -0,0 +1,188 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "../common/scriptedbridge.h"
+#include "../common/allocationcounter.h"
+#include "../../core/communication/communicationengine.h"
+#include "../../core/communication/engineclock.h"
+#include "../../core/communication/udpclient.h"
+#include "../../core/logwrapper.h"
+#include "../../core/logging/logconfig.h"
+
+// Регрессионный прогон движка в виртуальном времени: автоопрос (TS) N ППБ одного бриджа
+// в течение заданного числа часов. Таймауты, автоопрос и ответы бриджа идут по VirtualClock,
+// поэтому сутки опроса 16 ППБ проходят за секунды и с одинаковым результатом при том же seed.
+// После минуты разогрева считаются выделения памяти движком на цикл опроса (прием - пакетный,
+// как на Linux); имитатор бриджа и события часов в счет не входят.
+//   ppb_soak                              # 24 ч, 16 ППБ, опрос раз в секунду
+//   ppb_soak --hours 1 --loss 0.5 --seed 7
+//   ppb_soak --max-wall-sec 120           # ошибка, если прогон медленнее (регрессия скорости)
+//   ppb_soak --max-allocs 0               # ошибка, если цикл опроса выделяет память
+// Код возврата 1 - были отказы без заданных потерь, опросов заметно меньше ожидаемого,
+// превышено время прогона или число выделений на опрос
+
+namespace {
+
+// Будильник колеса таймеров ставит события в карту VirtualClock - это обвязка, не движок
+class SoakClock : public VirtualClock
+{
+public:
+    void wakeAt(int64_t deadlineNs) override
+    {
+        AllocationCounter::Pause pause;
+        VirtualClock::wakeAt(deadlineNs);
+    }
+
+    void cancelWake() override
+    {
+        AllocationCounter::Pause pause;
+        VirtualClock::cancelWake();
+    }
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ppb_soak");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Прогон движка в виртуальном времени (автоопрос ППБ)");
+    parser.addHelpOption();
+
+    QCommandLineOption hoursOption("hours", "Длительность прогона, ч виртуального времени", "hours", "24");
+    QCommandLineOption ppbsOption("ppbs", "Количество ППБ (1..16)", "count", "16");
+    QCommandLineOption pollOption("poll", "Период автоопроса каждого ППБ, мс", "ms", "1000");
+    QCommandLineOption latencyOption("latency", "Задержка ответа, мкс", "us", "2000");
+    QCommandLineOption jitterOption("jitter", "Разброс задержки, +-мкс", "us", "0");
+    QCommandLineOption intervalOption("interval", "Интервал между пакетами данных, мкс", "us", "100");
+    QCommandLineOption lossOption("loss", "Потеря датаграмм ответа, %", "percent", "0");
+    QCommandLineOption seedOption("seed", "Начальное значение генератора", "seed", "1");
+    QCommandLineOption maxWallOption("max-wall-sec", "Предел времени прогона, с (0 - без предела)", "sec", "0");
+    QCommandLineOption maxAllocsOption("max-allocs", "Предел выделений памяти на опрос (-1 - без предела)",
+                                       "count", "-1");
+
+    parser.addOptions({hoursOption, ppbsOption, pollOption, latencyOption, jitterOption,
+                       intervalOption, lossOption, seedOption, maxWallOption, maxAllocsOption});
+    parser.process(app);
+
+    const int hours = qMax(1, parser.value(hoursOption).toInt());
+    const int pollMs = qMax(1, parser.value(pollOption).toInt());
+    const double maxWallSec = parser.value(maxWallOption).toDouble();
+    const double maxAllocs = parser.value(maxAllocsOption).toDouble();
+
+    ScriptedBridge::Options options;
+    options.ppbCount = qBound(1, parser.value(ppbsOption).toInt(), 16);
+    options.latencyUs = qMax(0, parser.value(latencyOption).toInt());
+    options.jitterUs = qMax(0, parser.value(jitterOption).toInt());
+    options.packetIntervalUs = qMax(0, parser.value(intervalOption).toInt());
+    options.lossPercent = parser.value(lossOption).toDouble();
+    options.seed = parser.value(seedOption).toUInt();
+
+    // Журнал движка на каждый опрос занял бы весь прогон - только предупреждения и ошибки
+    LogWrapper::instance();
+    for (const QString& channel : LogConfig::instance().getChannelIds()) {
+        LogConfig::instance().setMinLevel(channel, LOG_WARNING);
+    }
+
+    // Порядок объявления важен: движок разрушается раньше часов и петли
+    SoakClock clock;
+    UDPClient client;
+    ScriptedBridge bridge(clock, client, options);
+    client.setBatchedReceive(true);
+    client.setLoopback([&bridge](const char* data, int size, const QHostAddress& address, quint16 port) {
+        AllocationCounter::Pause pause;
+        bridge.onOutbound(data, size, address, port);
+    });
+
+    communicationengine engine(&client);
+    if (!engine.setClock(&clock)) {
+        qCritical().noquote() << "Не удалось перевести движок на виртуальное время";
+        return 1;
+    }
+
+    quint64 succeeded = 0;
+    quint64 failed = 0;
+    QObject::connect(&engine, &communicationengine::commandCompleted,
+                     [&succeeded, &failed](bool success, const QString&, TechCommand) {
+                         success ? ++succeeded : ++failed;
+                     });
+
+    for (int i = 0; i < options.ppbCount; ++i) {
+        const uint16_t address = static_cast<uint16_t>(1u << i);
+        engine.connectToPPB(address, "127.0.0.1", 1080);
+        engine.setAutoPoll(address, pollMs);
+    }
+
+    qInfo().noquote() << QString("Прогон: %1 ч, ППБ: %2, опрос %3 мс, задержка %4+-%5 мкс, потери %6%, seed %7")
+                             .arg(hours).arg(options.ppbCount).arg(pollMs)
+                             .arg(options.latencyUs).arg(options.jitterUs)
+                             .arg(options.lossPercent).arg(options.seed);
+
+    constexpr int64_t NS_PER_HOUR = int64_t(3600) * 1000000000;
+    QElapsedTimer wall;
+    wall.start();
+
+    // Разогрев: таблицы адресов, узлы таймеров и оценки задержек заполняются на первых опросах
+    constexpr int64_t WARMUP_NS = int64_t(60) * 1000000000;
+    clock.runUntil(WARMUP_NS);
+    const quint64 warmupPolls = succeeded + failed;
+    AllocationCounter::start();
+
+    for (int hour = 1; hour <= hours; ++hour) {
+        clock.runUntil(hour * NS_PER_HOUR);
+        AllocationCounter::Pause pause;
+        qInfo().noquote() << QString("  %1 ч: выполнено %2, отказов %3, событий %4, прошло %5 с")
+                                 .arg(hour, 2).arg(succeeded).arg(failed)
+                                 .arg(clock.eventsRun())
+                                 .arg(wall.elapsed() / 1000.0, 0, 'f', 1);
+    }
+
+    AllocationCounter::stop();
+    const quint64 allocations = AllocationCounter::count();
+    const quint64 measuredPolls = succeeded + failed - warmupPolls;
+    const double allocsPerPoll = measuredPolls ? double(allocations) / double(measuredPolls) : 0.0;
+
+    const double wallSec = wall.elapsed() / 1000.0;
+    const quint64 expected = quint64(options.ppbCount) * quint64(hours) * 3600000 / quint64(pollMs);
+    const TimerWheelStats timers = engine.timerStats();
+
+    qInfo().noquote() << QString("Итог: выполнено %1 из ~%2 опросов, отказов %3; запросов бриджу %4, "
+                                 "датаграмм ответа %5, потеряно %6")
+                             .arg(succeeded).arg(expected).arg(failed)
+                             .arg(bridge.requests()).arg(bridge.sent()).arg(bridge.lost());
+    qInfo().noquote() << QString("Таймеры: сработало %1, отменено %2, пик взведенных %3")
+                             .arg(timers.fired).arg(timers.cancelled).arg(timers.armedPeak);
+    if (AllocationCounter::isAvailable()) {
+        qInfo().noquote() << QString("Память: %1 выделений на %2 опросов после разогрева, %3 на опрос")
+                                 .arg(allocations).arg(measuredPolls).arg(allocsPerPoll, 0, 'f', 3);
+    } else {
+        qInfo().noquote() << "Память: счетчик выделений недоступен (не glibc)";
+    }
+    qInfo().noquote() << QString("Время прогона %1 с, ускорение x%2")
+                             .arg(wallSec, 0, 'f', 2)
+                             .arg(wallSec > 0 ? hours * 3600.0 / wallSec : 0.0, 0, 'f', 0);
+    qInfo().noquote() << engine.metrics().snapshot().toText();
+
+    bool ok = true;
+    if (options.lossPercent <= 0.0 && failed > 0) {
+        qCritical().noquote() << QString("Отказы без потерь: %1").arg(failed);
+        ok = false;
+    }
+    if (succeeded + failed < expected * 99 / 100) {
+        qCritical().noquote() << QString("Опросов меньше ожидаемого: %1 из ~%2").arg(succeeded + failed).arg(expected);
+        ok = false;
+    }
+    if (maxWallSec > 0 && wallSec > maxWallSec) {
+        qCritical().noquote() << QString("Прогон дольше предела: %1 с > %2 с").arg(wallSec, 0, 'f', 2).arg(maxWallSec);
+        ok = false;
+    }
+    if (maxAllocs >= 0 && AllocationCounter::isAvailable() && allocsPerPoll > maxAllocs) {
+        qCritical().noquote() << QString("Выделений на опрос больше предела: %1 > %2")
+                                     .arg(allocsPerPoll, 0, 'f', 3).arg(maxAllocs);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}